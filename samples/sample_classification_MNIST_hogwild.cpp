@@ -0,0 +1,96 @@
+// MNIST classification with a dense layer, sequential training vs asynchronous Hogwild! training on all cpu cores
+// the MNIST images are mostly black: the gradient of the first layer is sparse and the threads rarely write the same weights
+// show the throughput (samples/s) and the validation accuracy of both trainings, epoch by epoch
+
+#include <iostream>
+#include <chrono>
+
+#include "Net.h"
+#include "NetTrain.h"
+#include "MNISTReader.h"
+#include "ThreadPool.h"
+
+#include "LayerActivation.h"
+#include "LayerDense.h"
+#include "LayerSoftmax.h"
+
+using namespace std;
+using namespace beednn;
+
+NetTrain netTrain;
+int iEpoch;
+Index iNbSamples;
+chrono::steady_clock::time_point start;
+
+//////////////////////////////////////////////////////////////////////////////
+void epoch_callback()
+{
+	//compute epoch time, the validation time is included
+	chrono::steady_clock::time_point next = chrono::steady_clock::now();
+	auto delta = chrono::duration_cast<std::chrono::milliseconds>(next - start).count();
+	start = next;
+
+	iEpoch++;
+	cout << "Epoch: " << iEpoch << " duration: " << delta << " ms, " << (int)(iNbSamples * 1000. / max((long long)delta, 1LL)) << " samples/s";
+	cout << " TrainLoss: " << netTrain.get_current_train_loss() << " ValidationAccuracy: " << netTrain.get_current_validation_accuracy() << " %" << endl;
+}
+//////////////////////////////////////////////////////////////////////////////
+float train(const MNISTReader& mr, bool bHogwild)
+{
+	Net model;
+	model.add(new LayerDense(784, 256));
+	model.add(new LayerActivation("Relu"));
+	model.add(new LayerDense(256, 10));
+	model.add(new LayerSoftmax());
+
+	netTrain.set_epochs(5);
+	netTrain.set_batchsize(32);
+	netTrain.set_optimizer("SGD");
+	netTrain.set_learningrate(0.1f);
+	netTrain.set_loss("SparseCategoricalCrossEntropy");
+	netTrain.set_hogwild(bHogwild);
+	netTrain.set_epoch_callback(epoch_callback);
+	netTrain.set_train_data(mr.train_data(), mr.train_truth());
+	netTrain.set_validation_data(mr.validation_data(), mr.validation_truth());
+
+	iEpoch = 0;
+	iNbSamples = mr.train_data().rows();
+	start = chrono::steady_clock::now();
+	netTrain.fit(model);
+
+	return netTrain.get_current_validation_accuracy();
+}
+//////////////////////////////////////////////////////////////////////////////
+int main()
+{
+	cout << "MNIST classification, sequential vs Hogwild! training" << endl;
+
+	//load and normalize MNIST data
+	cout << "Loading MNIST database..." << endl;
+	MNISTReader mr;
+	if (!mr.load("."))
+	{
+		cout << "MNIST samples not found, please check the *.ubyte files are in the executable folder" << endl;
+		return -1;
+	}
+
+	cout << endl << "Sequential training:" << endl;
+	set_nb_threads(1);
+	float fSequentialAccuracy = train(mr, false);
+
+	set_nb_threads(0); // all cores
+	cout << endl << "Hogwild! training with " << get_nb_threads() << " threads:" << endl;
+	float fHogwildAccuracy = train(mr, true);
+
+	cout << endl << "Validation accuracy, sequential: " << fSequentialAccuracy << " %, Hogwild!: " << fHogwildAccuracy << " %" << endl;
+
+	//testu function
+	if (fHogwildAccuracy < fSequentialAccuracy - 1.f)
+	{
+		cout << "Test failed! Hogwild! accuracy=" << fHogwildAccuracy << endl;
+		return -1;
+	}
+
+	cout << "Test succeded." << endl;
+	return 0;
+}
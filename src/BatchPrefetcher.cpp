@@ -0,0 +1,161 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#include "BatchPrefetcher.h"
+
+#include <cassert>
+#include <chrono>
+
+using namespace std;
+namespace beednn {
+
+///////////////////////////////////////////////////////////////////////////
+BatchPrefetcher::BatchPrefetcher()
+{
+	_pSamples = nullptr;
+	_pTruth = nullptr;
+	_pShuffle = nullptr;
+	_iBatchSize = 0;
+	_iNbBatches = 0;
+	_iNbProduced = 0;
+	_iNbTaken = 0;
+	_bStop = false;
+
+	reset_statistics();
+}
+///////////////////////////////////////////////////////////////////////////
+BatchPrefetcher::~BatchPrefetcher()
+{
+	stop();
+}
+///////////////////////////////////////////////////////////////////////////
+void BatchPrefetcher::start(const MatrixFloat& mSamples, const MatrixFloat& mTruth, const vector<Index>& vShuffle, Index iBatchSize, int iQueueSize)
+{
+	assert(iBatchSize > 0);
+	assert(mSamples.rows() == mTruth.rows());
+	stop();
+
+	_pSamples = &mSamples;
+	_pTruth = &mTruth;
+	_pShuffle = &vShuffle;
+	_iBatchSize = iBatchSize;
+	_iNbBatches = (mSamples.rows() + iBatchSize - 1) / iBatchSize;
+	_iNbProduced = 0;
+	_iNbTaken = 0;
+	_bStop = false;
+
+	if (iQueueSize < 1)
+		iQueueSize = 1;
+	_batchSamples.resize((size_t)iQueueSize + 1);
+	_batchTruth.resize((size_t)iQueueSize + 1);
+
+	_producer = thread(&BatchPrefetcher::producer_loop, this);
+}
+///////////////////////////////////////////////////////////////////////////
+void BatchPrefetcher::producer_loop()
+{
+	Index iNbBuffers = (Index)_batchSamples.size();
+
+	for (Index iBatch = 0; iBatch < _iNbBatches; iBatch++)
+	{
+		{
+			// the buffer of the batch iBatch - iNbBuffers must be released: the batch after it is taken
+			unique_lock<mutex> lock(_mutex);
+			_cvFree.wait(lock, [&] { return _bStop || (iBatch < _iNbTaken + iNbBuffers - 1); });
+			if (_bStop)
+				return;
+		}
+
+		Index iStart = iBatch * _iBatchSize;
+		Index iEnd = min(iStart + _iBatchSize, _pSamples->rows());
+		MatrixFloat& mSamples = _batchSamples[iBatch % iNbBuffers];
+		MatrixFloat& mTruth = _batchTruth[iBatch % iNbBuffers];
+
+		if (_pShuffle->empty())
+		{
+			mSamples = viewRow(*_pSamples, iStart, iEnd);
+			mTruth = viewRow(*_pTruth, iStart, iEnd);
+		}
+		else
+		{
+			gatherRows(*_pShuffle, iStart, iEnd, *_pSamples, mSamples);
+			gatherRows(*_pShuffle, iStart, iEnd, *_pTruth, mTruth);
+		}
+
+		{
+			lock_guard<mutex> lock(_mutex);
+			_iNbProduced++;
+		}
+		_cvReady.notify_one();
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+bool BatchPrefetcher::next(const MatrixFloat*& pSamples, const MatrixFloat*& pTruth)
+{
+	unique_lock<mutex> lock(_mutex);
+
+	if (_iNbTaken >= _iNbBatches)
+		return false;
+
+	_dQueueDepthSum += (double)(_iNbProduced - _iNbTaken);
+	_iNbNext++;
+
+	if (_iNbProduced <= _iNbTaken)
+	{
+		auto start = chrono::steady_clock::now();
+		_cvReady.wait(lock, [&] { return _iNbProduced > _iNbTaken; });
+		_dStallTime += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+
+	size_t iBuffer = (size_t)(_iNbTaken % (Index)_batchSamples.size());
+	pSamples = &_batchSamples[iBuffer];
+	pTruth = &_batchTruth[iBuffer];
+	_iNbTaken++;
+
+	lock.unlock();
+	_cvFree.notify_one(); // the previous batch is released
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+void BatchPrefetcher::stop()
+{
+	if (!_producer.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		_bStop = true;
+	}
+	_cvFree.notify_one();
+	_producer.join();
+}
+///////////////////////////////////////////////////////////////////////////
+void BatchPrefetcher::reset_statistics()
+{
+	lock_guard<mutex> lock(_mutex);
+	_dStallTime = 0.;
+	_dQueueDepthSum = 0.;
+	_iNbNext = 0;
+}
+///////////////////////////////////////////////////////////////////////////
+double BatchPrefetcher::stall_time() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _dStallTime;
+}
+///////////////////////////////////////////////////////////////////////////
+double BatchPrefetcher::mean_queue_depth() const
+{
+	lock_guard<mutex> lock(_mutex);
+	if (_iNbNext == 0)
+		return 0.;
+
+	return _dQueueDepthSum / _iNbNext;
+}
+///////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,66 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include "Matrix.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace beednn {
+
+// prepare the batches of an epoch in a dedicated thread, while the previous batches train
+// the batches are gathered from the shuffled samples in a bounded queue of buffers, reused from batch to batch
+class BatchPrefetcher
+{
+public:
+	BatchPrefetcher();
+	~BatchPrefetcher();
+
+	// start the thread for an epoch, vShuffle empty keeps the data order
+	// the data and vShuffle must be kept until stop()
+	void start(const MatrixFloat& mSamples, const MatrixFloat& mTruth, const std::vector<Index>& vShuffle, Index iBatchSize, int iQueueSize);
+
+	// wait for the next batch, false at the end of the epoch, the batch is kept until the next call
+	bool next(const MatrixFloat*& pSamples, const MatrixFloat*& pTruth);
+
+	void stop(); // wait for the end of the thread
+
+	// statistics since the creation or reset_statistics()
+	void reset_statistics();
+	double stall_time() const; // seconds waited in next() for a batch not ready
+	double mean_queue_depth() const; // mean number of ready batches when next() is called
+
+private:
+	void producer_loop();
+
+	std::thread _producer;
+	mutable std::mutex _mutex;
+	std::condition_variable _cvReady; // a batch is ready
+	std::condition_variable _cvFree; // a buffer is free
+
+	const MatrixFloat* _pSamples;
+	const MatrixFloat* _pTruth;
+	const std::vector<Index>* _pShuffle;
+	Index _iBatchSize;
+	Index _iNbBatches;
+
+	std::vector<MatrixFloat> _batchSamples, _batchTruth; // queue size + 1 buffers: the ready batches and the batch in use
+	Index _iNbProduced;
+	Index _iNbTaken;
+	bool _bStop;
+
+	double _dStallTime;
+	double _dQueueDepthSum;
+	Index _iNbNext;
+};
+
+}
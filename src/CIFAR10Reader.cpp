@@ -7,6 +7,7 @@
 */
 
 #include "CIFAR10Reader.h"
+#include "DataStream.h"
 
 #include <fstream>
 using namespace std;
@@ -76,6 +77,47 @@ bool CIFAR10Reader::read_from_folder(const string& sFolder,MatrixFloat& mRefImag
 	return true;
 }
 ////////////////////////////////////////////////////////////////////////////////////
+bool CIFAR10Reader::load_mapped(const string& sFolder, Index iShardSize)
+{
+	//a record is the class byte then the rgb pixels
+	const Index iImageSize = 32 * 32 * 3;
+	const Index iRecordSize = iImageSize + 1;
+
+	// the streams read in the files mapped before, unmapped by open(): no stream is kept if the load fails
+	delete _pTrainStream;
+	delete _pValidationStream;
+	_pTrainStream = nullptr;
+	_pValidationStream = nullptr;
+
+	// same normalization as load()
+	ByteDataStream* pTrainStream = new ByteDataStream(iImageSize, 255.f, iShardSize);
+	ByteDataStream* pValidationStream = new ByteDataStream(iImageSize, 255.f, iShardSize);
+
+	bool bOk = true;
+	for (int i = 0; i < 5; i++)
+	{
+		MappedFile& file = _trainFiles[i];
+		bOk = bOk && file.open(sFolder + "/data_batch_" + to_string(i + 1) + ".bin") && ((Index)file.size() >= iRecordSize);
+		if (bOk)
+			pTrainStream->add_block(file.data() + 1, iRecordSize, file.data(), iRecordSize, (Index)file.size() / iRecordSize);
+	}
+
+	bOk = bOk && _validationFile.open(sFolder + "/test_batch.bin") && ((Index)_validationFile.size() >= iRecordSize);
+	if (bOk)
+		pValidationStream->add_block(_validationFile.data() + 1, iRecordSize, _validationFile.data(), iRecordSize, (Index)_validationFile.size() / iRecordSize);
+
+	if (!bOk)
+	{
+		delete pTrainStream;
+		delete pValidationStream;
+		return false;
+	}
+
+	_pTrainStream = pTrainStream;
+	_pValidationStream = pValidationStream;
+	return true;
+}
+////////////////////////////////////////////////////////////////////////////////////
 bool CIFAR10Reader::read_batch(string sName,MatrixFloat& mData,MatrixFloat& mTruth)
 {
 	//raw data, 10000 lines, 1st byte is class, next are rgb pixels plane/plane (plane size is 32*32)
@@ -13,14 +13,21 @@
 #include <string>
 
 #include "DataSource.h"
+#include "MappedFile.h"
 namespace beednn {
 class CIFAR10Reader : public DataSource
 {
 public:
     virtual bool load(const std::string& sFolder) override;
 
+    // map the files, the images stay as bytes in the file cache and are converted shard by shard in train_stream() and validation_stream()
+    // immediate and a quarter of the memory of load(), the matrices stay empty
+    bool load_mapped(const std::string& sFolder, Index iShardSize = 1000);
+
 private:
     bool read_from_folder(const std::string& sFolder,MatrixFloat& mRefImages,MatrixFloat& mRefLabels,MatrixFloat& mTestImages,MatrixFloat& mTestLabels);
     bool read_batch(std::string sName,MatrixFloat& mData,MatrixFloat& mTruth);
+
+    MappedFile _trainFiles[5], _validationFile;
 };
 }
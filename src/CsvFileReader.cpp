@@ -20,6 +20,18 @@ void CsvFileReader::replace_last(string& s, const string& sOld, const string& sN
 		s.replace(found, sOld.length(), sNew);
 }
 ////////////////////////////////////////////////////////////////////////////////////
+// a missing file is empty, true
+bool CsvFileReader::load_file(const string& sFile, MatrixFloat& m)
+{
+	if(!ifstream(sFile))
+	{
+		m.resize(0,0);
+		return true;
+	}
+
+	return fromFile(sFile,m);
+}
+////////////////////////////////////////////////////////////////////////////////////
 bool CsvFileReader::load(const string& sFile)
 {
 	//create 4 file names (may not exist)
@@ -44,14 +56,14 @@ bool CsvFileReader::load(const string& sFile)
 	replace_last(sTestTruth,"train","test");
 	replace_last(sTestTruth,"data","truth");
 
-	//try to load every file
-	_mTrainData=fromFile(sTrainData);
-	_mTrainTruth=fromFile(sTrainTruth);
+	//try to load every file, a file not valid is an error
+	if(!load_file(sTrainData,_mTrainData) || !load_file(sTrainTruth,_mTrainTruth))
+		return false;
 
 	if((sTrainData!=sTestData) && (sTrainTruth!=sTestTruth))
 	{
-		_mValData=fromFile(sTestData);
-		_mValTruth=fromFile(sTestTruth);
+		if(!load_file(sTestData,_mValData) || !load_file(sTestTruth,_mValTruth))
+			return false;
 	}
 	else
 	{
@@ -62,6 +74,12 @@ bool CsvFileReader::load(const string& sFile)
 	_bHasTrainData=(_mTrainData.size()!=0) && (_mTrainTruth.size()!=0) ;
 	_bHasValidationData=(_mValData.size()!=0) && (_mValTruth.size()!=0) ;
 
+	if(_bHasTrainData && (_mTrainData.rows()!=_mTrainTruth.rows()))
+		return false;
+
+	if(_bHasValidationData && (_mValData.rows()!=_mValTruth.rows()))
+		return false;
+
 	return has_data();
 }	
 }
\ No newline at end of file
@@ -17,6 +17,7 @@ class CsvFileReader : public DataSource
 public:
     virtual bool load(const std::string& sFile) override;
 private:
+	bool load_file(const std::string& sFile, MatrixFloat& m);
 	void replace_last(std::string& s, const std::string& sOld, const std::string& sNew);
 };
 }
@@ -1,4 +1,5 @@
 #include "DataSource.h"
+#include "DataStream.h"
 namespace beednn {
 
 ////////////////////////////////////////////////////////////////////////
@@ -6,10 +7,15 @@ DataSource::DataSource()
 {
 	_bHasTrainData=false;
 	_bHasValidationData=false;
+	_pTrainStream=nullptr;
+	_pValidationStream=nullptr;
 }
 ////////////////////////////////////////////////////////////////////////
 DataSource::~DataSource()
-{ }
+{
+	delete _pTrainStream;
+	delete _pValidationStream;
+}
 ////////////////////////////////////////////////////////////////////////
 const MatrixFloat& DataSource::train_data() const
 {
@@ -56,4 +62,14 @@ int DataSource::annotation_cols() const
 	return (int)_mTrainTruth.cols();
 }
 ////////////////////////////////////////////////////////////////////////
+DataStream* DataSource::train_stream() const
+{
+	return _pTrainStream;
+}
+////////////////////////////////////////////////////////////////////////
+DataStream* DataSource::validation_stream() const
+{
+	return _pValidationStream;
+}
+////////////////////////////////////////////////////////////////////////
 }
\ No newline at end of file
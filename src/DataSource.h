@@ -4,6 +4,7 @@
 
 #include "Matrix.h"
 namespace beednn {
+class DataStream;
 class DataSource
 {
 public:
@@ -25,6 +26,10 @@ public:
     int data_size() const;
     int annotation_cols() const;
 
+    // data read as a stream, by the readers loading in mapped mode, nullptr if not loaded as a stream
+    DataStream* train_stream() const;
+    DataStream* validation_stream() const;
+
 protected:
     MatrixFloat _mTrainData;
     MatrixFloat _mTrainTruth;
@@ -33,5 +38,8 @@ protected:
 
     bool _bHasTrainData;
 	bool _bHasValidationData;
+
+    DataStream* _pTrainStream; // owned
+    DataStream* _pValidationStream; // owned
 };
 }
@@ -0,0 +1,134 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#include "DataStream.h"
+
+#include <cassert>
+
+using namespace std;
+namespace beednn {
+
+////////////////////////////////////////////////////////////////////////
+DataStream::DataStream()
+{ }
+////////////////////////////////////////////////////////////////////////
+DataStream::~DataStream()
+{ }
+////////////////////////////////////////////////////////////////////////
+MatrixDataStream::MatrixDataStream(const MatrixFloat& mSamples, const MatrixFloat& mTruth, Index iShardSize):
+	_mSamples(mSamples),
+	_mTruth(mTruth)
+{
+	assert(mSamples.rows() == mTruth.rows());
+	_iShardSize = iShardSize > 0 ? iShardSize : mSamples.rows();
+}
+////////////////////////////////////////////////////////////////////////
+Index MatrixDataStream::nb_shards() const
+{
+	if (_iShardSize == 0)
+		return 0;
+
+	return (_mSamples.rows() + _iShardSize - 1) / _iShardSize;
+}
+////////////////////////////////////////////////////////////////////////
+Index MatrixDataStream::nb_samples() const
+{
+	return _mSamples.rows();
+}
+////////////////////////////////////////////////////////////////////////
+bool MatrixDataStream::read_shard(Index iShard, MatrixFloat& mSamples, MatrixFloat& mTruth)
+{
+	if ((iShard < 0) || (iShard >= nb_shards()))
+		return false;
+
+	Index iStart = iShard * _iShardSize;
+	Index iEnd = min(iStart + _iShardSize, _mSamples.rows());
+	mSamples = viewRow(_mSamples, iStart, iEnd);
+	mTruth = viewRow(_mTruth, iStart, iEnd);
+	return true;
+}
+////////////////////////////////////////////////////////////////////////
+ByteDataStream::ByteDataStream(Index iSampleSize, float fDivisor, Index iShardSize)
+{
+	_iSampleSize = iSampleSize;
+	_iShardSize = iShardSize > 0 ? iShardSize : 1024;
+	_iNbSamples = 0;
+
+	for (int i = 0; i < 256; i++)
+		_fTable[i] = (float)i / fDivisor;
+}
+////////////////////////////////////////////////////////////////////////
+void ByteDataStream::add_block(const unsigned char* pSamples, Index iSampleStride, const unsigned char* pLabels, Index iLabelStride, Index iNbSamples)
+{
+	Block block;
+	block.pSamples = pSamples;
+	block.iSampleStride = iSampleStride;
+	block.pLabels = pLabels;
+	block.iLabelStride = iLabelStride;
+	block.iNbSamples = iNbSamples;
+	_blocks.push_back(block);
+
+	_iNbSamples += iNbSamples;
+}
+////////////////////////////////////////////////////////////////////////
+void ByteDataStream::clear()
+{
+	_blocks.clear();
+	_iNbSamples = 0;
+}
+////////////////////////////////////////////////////////////////////////
+Index ByteDataStream::sample_size() const
+{
+	return _iSampleSize;
+}
+////////////////////////////////////////////////////////////////////////
+Index ByteDataStream::nb_shards() const
+{
+	return (_iNbSamples + _iShardSize - 1) / _iShardSize;
+}
+////////////////////////////////////////////////////////////////////////
+Index ByteDataStream::nb_samples() const
+{
+	return _iNbSamples;
+}
+////////////////////////////////////////////////////////////////////////
+bool ByteDataStream::read_shard(Index iShard, MatrixFloat& mSamples, MatrixFloat& mTruth)
+{
+	if ((iShard < 0) || (iShard >= nb_shards()))
+		return false;
+
+	Index iStart = iShard * _iShardSize;
+	Index iEnd = min(iStart + _iShardSize, _iNbSamples);
+	mSamples.resize(iEnd - iStart, _iSampleSize);
+	mTruth.resize(iEnd - iStart, 1);
+
+	// first block of the shard
+	size_t iBlock = 0;
+	Index iBlockStart = 0;
+	while (iStart >= iBlockStart + _blocks[iBlock].iNbSamples)
+		iBlockStart += _blocks[iBlock++].iNbSamples;
+
+	for (Index iSample = iStart; iSample < iEnd; iSample++)
+	{
+		while (iSample >= iBlockStart + _blocks[iBlock].iNbSamples)
+			iBlockStart += _blocks[iBlock++].iNbSamples;
+
+		const Block& block = _blocks[iBlock];
+		Index iInBlock = iSample - iBlockStart;
+		const unsigned char* pIn = block.pSamples + iInBlock * block.iSampleStride;
+		float* pOut = rowPtr(mSamples, iSample - iStart);
+		for (Index i = 0; i < _iSampleSize; i++)
+			pOut[i] = _fTable[pIn[i]];
+
+		mTruth(iSample - iStart) = (float)block.pLabels[iInBlock * block.iLabelStride];
+	}
+
+	return true;
+}
+////////////////////////////////////////////////////////////////////////
+}
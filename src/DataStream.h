@@ -0,0 +1,83 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include "Matrix.h"
+
+#include <vector>
+
+namespace beednn {
+
+// training data read shard by shard, for the datasets bigger than the memory
+// NetTrain::fit() keeps one shard in memory (two with the prefetch), reads the shards in a random order and shuffles the samples inside each shard
+class DataStream
+{
+public:
+    DataStream();
+    virtual ~DataStream();
+
+    virtual Index nb_shards() const = 0;
+    virtual Index nb_samples() const = 0; // in all shards
+
+    // read all the samples of a shard, false if it cannot be read
+    // called from the prefetch thread of NetTrain, never at the same time
+    virtual bool read_shard(Index iShard, MatrixFloat& mSamples, MatrixFloat& mTruth) = 0;
+};
+
+// samples and truth in memory, cut in shards of iShardSize rows, the matrices must be kept during the training
+class MatrixDataStream : public DataStream
+{
+public:
+    MatrixDataStream(const MatrixFloat& mSamples, const MatrixFloat& mTruth, Index iShardSize);
+
+    Index nb_shards() const override;
+    Index nb_samples() const override;
+    bool read_shard(Index iShard, MatrixFloat& mSamples, MatrixFloat& mTruth) override;
+
+private:
+    const MatrixFloat& _mSamples;
+    const MatrixFloat& _mTruth;
+    Index _iShardSize;
+};
+
+// byte samples and labels, as the MNIST or CIFAR10 files mapped in memory, converted to normalized float shard by shard
+// a quarter of the memory of the float samples, the bytes must be kept during the training
+class ByteDataStream : public DataStream
+{
+public:
+    ByteDataStream(Index iSampleSize, float fDivisor, Index iShardSize); // the samples are divided by fDivisor
+
+    // iNbSamples samples of iSampleSize bytes every iSampleStride bytes, and their label byte every iLabelStride bytes
+    // each file is a block, the shards can overlap two blocks
+    void add_block(const unsigned char* pSamples, Index iSampleStride, const unsigned char* pLabels, Index iLabelStride, Index iNbSamples);
+    void clear();
+
+    Index sample_size() const;
+    Index nb_shards() const override;
+    Index nb_samples() const override;
+    bool read_shard(Index iShard, MatrixFloat& mSamples, MatrixFloat& mTruth) override;
+
+private:
+    struct Block
+    {
+        const unsigned char* pSamples;
+        Index iSampleStride;
+        const unsigned char* pLabels;
+        Index iLabelStride;
+        Index iNbSamples;
+    };
+    std::vector<Block> _blocks;
+
+    Index _iSampleSize;
+    Index _iShardSize;
+    Index _iNbSamples;
+    float _fTable[256]; // normalized value of each byte, the same as the float division
+};
+
+}
@@ -8,18 +8,27 @@
 
 #include "Layer.h"
 
+#include <atomic>
+
 using namespace std;
 namespace beednn {
 
+static atomic<unsigned long long> g_iWeightsGeneration(0); // shared by all layers: two layers never have the same generation
+
 ////////////////////////////////////////////////////////////////
 Layer::Layer(const string& sType):
 _sType(sType)
 { 
 	_bTrainMode = false;
 	_bFirstLayer = false;
+	_bInPlace = false;
+	_bGradientWeightSum = false;
+	_bGradientBiasSum = false;
 
 	_sWeightInitializer = "";
 	_sBiasInitializer = "";
+
+	weights_changed();
 }
 ////////////////////////////////////////////////////////////////
 Layer::~Layer()
@@ -27,6 +36,12 @@ Layer::~Layer()
 ////////////////////////////////////////////////////////////////
 void Layer::init()
 { }
+////////////////////////////////////////////////////////////////
+void Layer::predict(const MatrixFloat& mIn, MatrixFloat& mOut, vector<MatrixFloat>& vScratch) const
+{
+	(void)vScratch;
+	const_cast<Layer*>(this)->forward(mIn, mOut);
+}
 ///////////////////////////////////////////////////////////////
 string Layer::type() const
 {
@@ -38,6 +53,11 @@ void Layer::set_first_layer(bool bFirstLayer)
 	_bFirstLayer = bFirstLayer;
 }
 ///////////////////////////////////////////////////////////////
+bool Layer::is_inplace() const
+{
+	return _bInPlace;
+}
+///////////////////////////////////////////////////////////////
 void Layer::set_train_mode(bool bTrainMode)
 {
 	_bTrainMode = bTrainMode;
@@ -50,6 +70,8 @@ bool Layer::has_weights() const
 ///////////////////////////////////////////////////////////////
 vector<MatrixFloat*> Layer::weights()
 {
+	weights_changed();
+
 	vector<MatrixFloat*> v;
 	v.push_back(&_weight);
 	return v;
@@ -62,6 +84,16 @@ vector<MatrixFloat*> Layer::gradient_weights()
 	return v;
 }
 ///////////////////////////////////////////////////////////////
+unsigned long long Layer::weights_generation() const
+{
+	return _iWeightsGeneration;
+}
+///////////////////////////////////////////////////////////////
+void Layer::weights_changed()
+{
+	_iWeightsGeneration = ++g_iWeightsGeneration;
+}
+///////////////////////////////////////////////////////////////
 bool Layer::has_biases() const
 {
 	return _bias.size() != 0.;
@@ -81,6 +113,16 @@ vector<MatrixFloat*> Layer::gradient_biases()
 	return v;
 }
 ///////////////////////////////////////////////////////////////
+bool Layer::is_gradient_weight_sum() const
+{
+	return _bGradientWeightSum;
+}
+///////////////////////////////////////////////////////////////
+bool Layer::is_gradient_bias_sum() const
+{
+	return _bGradientBiasSum;
+}
+///////////////////////////////////////////////////////////////
 void Layer::set_weight_initializer(const string& sWeightInitializer)
 {
 	_sWeightInitializer = sWeightInitializer;
@@ -25,6 +25,12 @@ public:
 	void set_first_layer(bool bFirstLayer);
 
     virtual void forward(const MatrixFloat& mIn,MatrixFloat& mOut) =0;
+
+    // inference on a const layer, thread safe if not in train mode: the temporaries and states are in vScratch, kept by an InferenceContext
+    // by default call forward(), right for the layers that write no member out of the train mode
+    // the layers creating their weights in the first forward() (Affine, PELU, PRelu, TERELU) override it, as the layers with buffers or states
+    virtual void predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const;
+    bool is_inplace() const; // forward() accepts the same matrix as input and output
 	
     virtual void init();
     virtual void backpropagation(const MatrixFloat &mIn,const MatrixFloat &mGradientOut, MatrixFloat &mGradientIn)=0;
@@ -34,22 +40,35 @@ public:
     void set_weight_initializer(const std::string& _sWeightInitializer);
     std::string weight_initializer() const;
     bool has_weights() const;
-    std::vector<MatrixFloat*> weights();
+    std::vector<MatrixFloat*> weights(); // the weights can be modified: changes the generation
     std::vector<MatrixFloat*> gradient_weights();
 
+	// unique number of the current weights, to keep the computations made from them (Winograd transformed weights ...)
+	// changed by weights() and by the training after each optimization, call weights_changed() after any other modification
+	unsigned long long weights_generation() const;
+	void weights_changed();
+
     void set_bias_initializer(const std::string& _sBiasInitializer);
     std::string bias_initializer() const;
 	bool has_biases() const;
     std::vector<MatrixFloat*> biases();
     std::vector<MatrixFloat*> gradient_biases();
 
+	// false by default: the gradient is the mean of the samples gradients, true if it is the sum (Convolution2D ...)
+	// used to merge the gradients of the parts of a batch in the data parallel training
+	bool is_gradient_weight_sum() const;
+	bool is_gradient_bias_sum() const;
+
 protected:
     MatrixFloat _weight,_gradientWeight;
 	MatrixFloat _bias, _gradientBias;
 	bool _bTrainMode;
 	bool _bFirstLayer;
+	bool _bInPlace; // false by default, set by the element-wise layers
+	bool _bGradientWeightSum, _bGradientBiasSum; // false by default
 
 private:
+	unsigned long long _iWeightsGeneration;
     std::string _sType;
     std::string _sWeightInitializer, _sBiasInitializer;
 };
@@ -17,6 +17,7 @@ LayerActivation::LayerActivation(const string& sActivation):
     Layer(sActivation)
 {
     _pActivation=get_activation(sActivation);
+	_bInPlace = true;
 
 	assert(_pActivation);
 }
@@ -13,6 +13,8 @@ namespace beednn {
 LayerAffine::LayerAffine() :
     Layer("Affine")
 {
+	_bInPlace = true;
+	_bGradientWeightSum = true; // mean on the features, not on the samples
     LayerAffine::init();
 }
 ///////////////////////////////////////////////////////////////////////////////
@@ -44,12 +46,32 @@ void LayerAffine::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 		_weight.setOnes(1,mIn.cols());
 	}
 
+	forward_weight(mIn, _weight, _bias, mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+// the weights are created by the first forward(), the default ones are used before, without writing the layer
+void LayerAffine::predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const
+{
+	if (_bias.size() != 0)
+	{
+		forward_weight(mIn, _weight, _bias, mOut);
+		return;
+	}
+
+	vScratch.resize(2);
+	vScratch[0].setOnes(1, mIn.cols());
+	vScratch[1].setZero(1, mIn.cols());
+	forward_weight(mIn, vScratch[0], vScratch[1], mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerAffine::forward_weight(const MatrixFloat& mIn, const MatrixFloat& mWeight, const MatrixFloat& mBias, MatrixFloat& mOut) const
+{
     mOut.resizeLike(mIn);
 
 	for (int i = 0; i < mOut.rows(); i++)
 		for (int j = 0; j < mOut.cols(); j++)
 		{
-			mOut(i,j) =mIn(i,j)* _weight(j) +_bias(j);
+			mOut(i,j) =mIn(i,j)* mWeight(j) +mBias(j);
 		}
 }
 ///////////////////////////////////////////////////////////////////////////////
@@ -17,6 +17,7 @@ LayerBias::LayerBias(const string& sBiasInitializer) :
     Layer("Bias")
 {
     set_bias_initializer(sBiasInitializer);
+	_bInPlace = true;
     LayerBias::init();
 }
 ///////////////////////////////////////////////////////////////////////////////
@@ -42,7 +43,9 @@ void LayerBias::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 	if(_bias.size()==0)
         Initializers::compute(bias_initializer(), _bias, 1, mIn.cols());
 
-    mOut = rowWiseAdd( mIn , _bias);
+    mOut = mIn;
+	for (Index l = 0; l < mOut.rows(); l++)
+		mOut.row(l) += _bias;
 }
 ///////////////////////////////////////////////////////////////////////////////
 void LayerBias::backpropagation(const MatrixFloat &mIn,const MatrixFloat &mGradientOut, MatrixFloat &mGradientIn)
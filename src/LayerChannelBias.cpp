@@ -21,6 +21,7 @@ LayerChannelBias::LayerChannelBias(Index iNbRows,Index iNbCols,Index iNbChannels
 	_iNbChannels=iNbChannels;
 
 	set_bias_initializer(sBiasInitializer);
+	_bInPlace = true;
     LayerChannelBias::init();
 }
 ///////////////////////////////////////////////////////////////////////////////
@@ -6,37 +6,53 @@
     in the LICENSE.txt file.
 */
 
-//for now: no bias (add LayerBias just after this one gives same results), mode ='valid'
+//for now: no bias (add LayerBias just after this one gives same results), mode ='valid' or padded with zeros
 
 #include "LayerConvolution2D.h"
 
+#include "ThreadPool.h"
+
+#include <algorithm>
 #include <cmath> // for sqrt
+#include <cstring>
+
+#define CONV_DIRECT_TILE_OUT 4 // output channels of a direct convolution tile
+#define CONV_DIRECT_TILE_COLS 8 // output columns of a direct convolution tile, the tiles on the border are smaller
+#define CONV_DIRECT_MAX_KERNEL_SIZE 144 // biggest KernelRows*KernelCols*InChannels computed without im2col in Auto mode
 
 using namespace std;
 namespace beednn {
 
 ///////////////////////////////////////////////////////////////////////////////
-LayerConvolution2D::LayerConvolution2D(Index iInRows, Index iInCols, Index iInChannels, Index iKernelRows, Index iKernelCols, Index iOutChannels, Index iRowStride, Index iColStride) :
+LayerConvolution2D::LayerConvolution2D(Index iInRows, Index iInCols, Index iInChannels, Index iKernelRows, Index iKernelCols, Index iOutChannels, Index iRowStride, Index iColStride,
+	Index iRowPadding, Index iColPadding, Index iRowDilation, Index iColDilation) :
     Layer("Convolution2D")
 {
 	_iInRows = iInRows;
 	_iInCols = iInCols;
 	_iInChannels = iInChannels;
-	_iSamples = 0;// set in predict()
+	_iSamples = 0;// set in forward()
+	_bGradientWeightSum = true; // not divided by the number of samples
 
 	_iKernelRows = iKernelRows;
 	_iKernelCols = iKernelCols;
 	_iRowStride = iRowStride;
 	_iColStride = iColStride; 
+	_iRowPadding = iRowPadding;
+	_iColPadding = iColPadding;
+	_iRowDilation = iRowDilation;
+	_iColDilation = iColDilation;
+	assert((_iRowDilation >= 1) && (_iColDilation >= 1));
 
 	_iOutChannels = iOutChannels;
 	
-	_iBorderRows=iKernelRows>>1;
-	_iBorderCols=iKernelCols>>1;
+	// border of the dilated kernel
+	_iBorderRows=(_iRowDilation*(iKernelRows-1)+1)>>1;
+	_iBorderCols=(_iColDilation*(iKernelCols-1)+1)>>1;
 
-	// out without strides
-	_iOutRows=_iInRows-2* _iBorderRows;
-	_iOutCols=_iInCols-2* _iBorderCols;
+	// out without strides, in the padded image
+	_iOutRows=_iInRows+2*_iRowPadding-2* _iBorderRows;
+	_iOutCols=_iInCols+2*_iColPadding-2* _iBorderCols;
 
 	//manage strides
 	if(_iRowStride>1)
@@ -48,6 +64,7 @@ LayerConvolution2D::LayerConvolution2D(Index iInRows, Index iInCols, Index iInCh
 	LayerConvolution2D::init();
 
 	fastLUT = true; 
+	_sAlgorithm = "Auto";
 }
 ///////////////////////////////////////////////////////////////////////////////
 LayerConvolution2D::~LayerConvolution2D()
@@ -78,43 +95,188 @@ void LayerConvolution2D::get_params(Index& iInRows, Index& iInCols, Index& iInCh
 	iOutChannels = _iOutChannels;
 }
 ///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::get_padding(Index& iRowPadding, Index& iColPadding) const
+{
+	iRowPadding = _iRowPadding;
+	iColPadding = _iColPadding;
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::get_dilation(Index& iRowDilation, Index& iColDilation) const
+{
+	iRowDilation = _iRowDilation;
+	iColDilation = _iColDilation;
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::get_output_size(Index& iOutRows, Index& iOutCols) const
+{
+	iOutRows = _iOutRows;
+	iOutCols = _iOutCols;
+}
+///////////////////////////////////////////////////////////////////////////////
 Layer* LayerConvolution2D::clone() const
 {
-	LayerConvolution2D* pLayer = new LayerConvolution2D(_iInRows, _iInCols, _iInChannels,_iKernelRows,_iKernelCols,_iOutChannels,_iRowStride,_iColStride);
+	LayerConvolution2D* pLayer = new LayerConvolution2D(_iInRows, _iInCols, _iInChannels,_iKernelRows,_iKernelCols,_iOutChannels,_iRowStride,_iColStride,
+		_iRowPadding, _iColPadding, _iRowDilation, _iColDilation);
 	pLayer->_weight = _weight;
 	pLayer->_gradientWeight = _gradientWeight;
+	pLayer->_sAlgorithm = _sAlgorithm;
 	return pLayer;
 }
 ///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::set_algorithm(const string& sAlgorithm)
+{
+	assert((sAlgorithm == "Auto") || (sAlgorithm == "Im2Col") || (sAlgorithm == "Direct") || (sAlgorithm == "Winograd2x2") || (sAlgorithm == "Winograd4x4"));
+	_sAlgorithm = sAlgorithm;
+}
+///////////////////////////////////////////////////////////////////////////////
+string LayerConvolution2D::algorithm() const
+{
+	bool bWinograd = (_iKernelRows == 3) && (_iKernelCols == 3) && (_iRowStride == 1) && (_iColStride == 1) && (_iRowDilation == 1) && (_iColDilation == 1);
+
+	if (_sAlgorithm != "Auto")
+	{
+		if ((_sAlgorithm.compare(0, 8, "Winograd") == 0) && !bWinograd)
+			return "Im2Col"; // only the 3x3 kernels with stride 1 and without dilation
+
+		return _sAlgorithm;
+	}
+
+	if (!fastLUT)
+		return "Im2Col"; // reference im2col
+
+	// im2col copies the input KernelRows*KernelCols times, for a GEMM with a shared dimension of KernelRows*KernelCols*InChannels only:
+	// with few input channels the copy costs more than the GEMM saves, the limit is checked in test_layer_convolution direct_time()
+	if (_iKernelRows * _iKernelCols * _iInChannels <= CONV_DIRECT_MAX_KERNEL_SIZE)
+		return "Direct";
+
+	// Winograd does 2.25 or 4 times less multiplications than the GEMM, but its transforms make it slower than im2col on most layers:
+	// only on demand, measured in test_layer_convolution
+	return "Im2Col";
+}
+///////////////////////////////////////////////////////////////////////////////
 void LayerConvolution2D::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 {
+	_iSamples = mIn.rows();
+	_sForwardAlgorithm = algorithm();
+
+	// in training, the backpropagation needs the im2col: Auto uses the direct convolution in predict() only
+	if ((_sAlgorithm == "Auto") && (_sForwardAlgorithm == "Direct"))
+		_sForwardAlgorithm = "Im2Col";
+
+	// the im2col of a direct convolution on demand is done in the backpropagation
+	if (_sForwardAlgorithm == "Direct")
+	{
+		direct_convolution(mIn, mOut, _im2colT);
+		return;
+	}
+
+	// the weights are transformed once per forward, so once per weight update, and kept for the backpropagation
+	if (_sForwardAlgorithm.compare(0, 8, "Winograd") == 0)
+	{
+		Index iTile = _sForwardAlgorithm == "Winograd2x2" ? 2 : 4;
+		winograd_weight(iTile, _winogradWeight);
+		winograd_forward(iTile, mIn, mOut, _winogradWeight, _im2colT, _winogradProduct);
+		return;
+	}
+
 	if(fastLUT)
 		im2col_LUT(mIn, _im2colT); //optimized
 	else
 		im2col(mIn, _im2colT); //slow
 
-	mOut = _weight * (_im2colT.transpose());// optimized GEMM product with transposed
-	reshape_to_out(mOut);
+	gemm_to_out(_im2colT, mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::predict(const MatrixFloat& mIn, MatrixFloat& mOut, vector<MatrixFloat>& vScratch) const
+{
+	// same as forward(), with the im2col or the packed weights in the context
+	vScratch.resize(1);
+	string sAlgorithm = algorithm();
+
+	if (sAlgorithm == "Direct")
+	{
+		direct_convolution(mIn, mOut, vScratch[0]);
+		return;
+	}
+
+	// the transformed weights are kept in the context with the generation of the weights they come from, and computed again if the weights change
+	if (sAlgorithm.compare(0, 8, "Winograd") == 0)
+	{
+		Index iTile = sAlgorithm == "Winograd2x2" ? 2 : 4;
+		vScratch.resize(4);
+		MatrixFloat& mGeneration = vScratch[2]; // the bytes of the generation, in two floats
+		MatrixFloat& mTransformedWeight = vScratch[3];
+
+		unsigned long long iGeneration = weights_generation();
+		static_assert(sizeof(iGeneration) == 2 * sizeof(float), "the generation is kept in two floats");
+		if ((mGeneration.size() != 2) || (memcmp(mGeneration.data(), &iGeneration, sizeof(iGeneration)) != 0)
+			|| (mTransformedWeight.rows() != (iTile + 2) * (iTile + 2))) // the other tile size
+		{
+			winograd_weight(iTile, mTransformedWeight);
+			mGeneration.resize(1, 2);
+			memcpy(mGeneration.data(), &iGeneration, sizeof(iGeneration));
+		}
+
+		winograd_forward(iTile, mIn, mOut, mTransformedWeight, vScratch[0], vScratch[1]);
+		return;
+	}
+
+	MatrixFloat& mIm2Col = vScratch[0];
+
+	if (fastLUT)
+		im2col_LUT(mIn, mIm2Col);
+	else
+		im2col(mIn, mIm2Col);
+
+	gemm_to_out(mIm2Col, mOut);
 }
 ///////////////////////////////////////////////////////////////////////////////
 void LayerConvolution2D::backpropagation(const MatrixFloat &mIn,const MatrixFloat &mGradientOut, MatrixFloat &mGradientIn)
 {
-	(void)mIn;
 	assert(mGradientOut.rows() == _iSamples);
 	assert(mGradientOut.cols() == _iOutRows * _iOutCols*_iOutChannels);
-	
-	MatrixFloat mGradientUnflat = mGradientOut;
-	reshape_from_out(mGradientUnflat);
 
-	_gradientWeight = mGradientUnflat *_im2colT;
+	if (_sForwardAlgorithm.compare(0, 8, "Winograd") == 0)
+	{
+		winograd_backpropagation(_sForwardAlgorithm == "Winograd2x2" ? 2 : 4, mGradientOut, mGradientIn);
+		return;
+	}
+
+	if (_sForwardAlgorithm == "Direct")
+	{
+		im2col_LUT(mIn, _im2colT);
+		_sForwardAlgorithm = "Im2Col";
+	}
+	
+	// the gradient of a sample is a OutChannels x (OutRows*OutCols) row major matrix, as the output
+	Index iOutSize = _iOutRows * _iOutCols;
+	Index iKernelSize = _weight.cols();
+	const float* pfGradientOut = mGradientOut.data();
+	const float* pfCol = _im2colT.data();
 
-	assert(_gradientWeight.rows() == _weight.rows());
-	assert(_gradientWeight.cols() == _weight.cols());
+	// sum of the samples gradients, in the samples order
+	_gradientWeight.resize(_iOutChannels, iKernelSize);
+	for (Index iSample = 0; iSample < _iSamples; iSample++)
+		gemm_packed(_iOutChannels, iKernelSize, iOutSize, 1.f,
+			pfGradientOut + iSample * _iOutChannels * iOutSize, iOutSize, 1,
+			pfCol + iSample * iOutSize * iKernelSize, iKernelSize, 1,
+			iSample == 0 ? 0.f : 1.f, _gradientWeight.data(), iKernelSize);
 
 	if (_bFirstLayer)
 		return;
 
-	MatrixFloat mGradientCol= _weight.transpose()*mGradientUnflat;
+	// gradient in the im2col format: (OutRows*OutCols) x KernelSize for each sample
+	MatrixFloat mGradientCol;
+	mGradientCol.resize(_iSamples * iOutSize, iKernelSize);
+	float* pfGradientCol = mGradientCol.data();
+	const float* pfWeight = _weight.data();
+	parallel_for(_iSamples, [&](Index iSample)
+	{
+		gemm_packed(iOutSize, iKernelSize, _iOutChannels, 1.f,
+			pfGradientOut + iSample * _iOutChannels * iOutSize, 1, iOutSize,
+			pfWeight, iKernelSize, 1,
+			0.f, pfGradientCol + iSample * iOutSize * iKernelSize, iKernelSize);
+	});
 
 	if(fastLUT)
 		col2im_LUT(mGradientCol, mGradientIn); //faster
@@ -125,15 +287,542 @@ void LayerConvolution2D::backpropagation(const MatrixFloat &mIn,const MatrixFloa
 	assert(mGradientIn.cols() == mIn.cols());
 }
 ///////////////////////////////////////////////////////////////////////////////
-void LayerConvolution2D::im2col(const MatrixFloat & mIn, MatrixFloat & mCol)
+void LayerConvolution2D::gemm_to_out(const MatrixFloat& mCol, MatrixFloat& mOut) const
+{
+	// one GEMM by sample: weight * im2col(sample)^T is the OutChannels x (OutRows*OutCols) output of the sample
+	// written in place in the sample row, no reshape nor copy of the output
+	Index iOutSize = _iOutRows * _iOutCols;
+	Index iKernelSize = _weight.cols();
+	assert(mCol.cols() == iKernelSize);
+	Index iSamples = mCol.rows() / iOutSize;
+
+	mOut.resize(iSamples, _iOutChannels * iOutSize);
+	float* pfOut = mOut.data();
+	const float* pfCol = mCol.data();
+	const float* pfWeight = _weight.data();
+
+	parallel_for(iSamples, [&](Index iSample)
+	{
+		gemm_packed(_iOutChannels, iOutSize, iKernelSize, 1.f,
+			pfWeight, iKernelSize, 1,
+			pfCol + iSample * iOutSize * iKernelSize, 1, iKernelSize,
+			0.f, pfOut + iSample * _iOutChannels * iOutSize, iOutSize);
+	});
+}
+///////////////////////////////////////////////////////////////////////////////
+// output tile of NbOut output channels x NbCols output columns, as the GEMM micro kernel with an implicit im2col:
+// the input values of a kernel position are read in the image at pOffsets[k] and used for all the output channels of the tile
+// the weights are packed: the NbOut weights of a kernel position are contiguous
+// fixed size loops, the compiler keeps the tile in registers and vectorizes the inner loop
+template <int NbOut, int NbCols, int ColStride>
+static void direct_tile(const float* pfIn, Index iColStride, const Index* pOffsets, Index iKernelSize,
+	const float* pfPackedWeight, float* pfOut, Index iOutPlaneSize, Index iNbOut)
+{
+	if (ColStride != 0)
+		iColStride = ColStride; // known at compile time: contiguous loads
+
+	float fAcc[NbOut * NbCols] = { 0.f };
+
+	for (Index k = 0; k < iKernelSize; k++)
+	{
+		const float* pfInK = pfIn + pOffsets[k];
+		for (int o = 0; o < NbOut; o++)
+		{
+			float fWeight = pfPackedWeight[o];
+			for (int c = 0; c < NbCols; c++)
+				fAcc[o * NbCols + c] += fWeight * pfInK[c * iColStride];
+		}
+		pfPackedWeight += NbOut;
+	}
+
+	for (Index o = 0; o < iNbOut; o++)
+		for (int c = 0; c < NbCols; c++)
+			pfOut[o * iOutPlaneSize + c] = fAcc[o * NbCols + c];
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::direct_convolution(const MatrixFloat& mIn, MatrixFloat& mOut, MatrixFloat& mPackedWeight) const
+{
+	assert(mIn.cols() == _iInRows * _iInCols*_iInChannels);
+	Index iSamples = mIn.rows();
+	Index iOutPlaneSize = _iOutRows * _iOutCols;
+	Index iInPlaneSize = _iInRows * _iInCols;
+	Index iKernelSize = _weight.cols();
+
+	// weights packed by tiles of output channels, the weights of a tile for a kernel position are contiguous, zero padded
+	Index iNbTilesOut = (_iOutChannels + CONV_DIRECT_TILE_OUT - 1) / CONV_DIRECT_TILE_OUT;
+	mPackedWeight.resize(iNbTilesOut, iKernelSize * CONV_DIRECT_TILE_OUT);
+	for (Index iTile = 0; iTile < iNbTilesOut; iTile++)
+		for (Index k = 0; k < iKernelSize; k++)
+			for (Index o = 0; o < CONV_DIRECT_TILE_OUT; o++)
+			{
+				Index iOut = iTile * CONV_DIRECT_TILE_OUT + o;
+				mPackedWeight(iTile, k * CONV_DIRECT_TILE_OUT + o) = iOut < _iOutChannels ? _weight(iOut, k) : 0.f;
+			}
+
+	mOut.resize(iSamples, _iOutChannels * iOutPlaneSize);
+	const float* pfInData = mIn.data();
+	const float* pfPackedWeight = mPackedWeight.data();
+	const Index* pOffsets = _directLUT.data();
+	float* pfOutData = mOut.data();
+
+	// one task by sample and output row, without im2col
+	parallel_for(iSamples * _iOutRows, [&](Index iTask)
+	{
+		Index iSample = iTask / _iOutRows;
+		Index iOutRow = iTask % _iOutRows;
+
+		const float* pfInSample = pfInData + iSample * _iInChannels * iInPlaneSize;
+		float* pfOutSample = pfOutData + iSample * _iOutChannels * iOutPlaneSize;
+
+		// the outputs with taps in the padding, on the borders
+		bool bInteriorRow = (iOutRow >= _iOutRowBegin) && (iOutRow < _iOutRowEnd);
+		Index iColBegin = bInteriorRow ? _iOutColBegin : _iOutCols;
+		Index iColEnd = bInteriorRow ? _iOutColEnd : _iOutCols;
+		for (Index iCol = 0; iCol < iColBegin; iCol++)
+			direct_pixel(pfInSample, iOutRow, iCol, pfOutSample);
+		for (Index iCol = iColEnd; iCol < _iOutCols; iCol++)
+			direct_pixel(pfInSample, iOutRow, iCol, pfOutSample);
+
+		if (!bInteriorRow)
+			return;
+
+		// the offsets of the taps are from the first tap of the output, in the image for the interior columns
+		const float* pfIn = pfInSample + (iOutRow * _iRowStride - _iRowPadding) * _iInCols;
+		float* pfOut = pfOutSample + iOutRow * _iOutCols;
+
+		for (Index iTile = 0; iTile < iNbTilesOut; iTile++)
+		{
+			Index iOut = iTile * CONV_DIRECT_TILE_OUT;
+			Index iNbOut = min<Index>(CONV_DIRECT_TILE_OUT, _iOutChannels - iOut);
+			const float* pfWeightTile = pfPackedWeight + iTile * iKernelSize * CONV_DIRECT_TILE_OUT;
+			float* pfOutTile = pfOut + iOut * iOutPlaneSize;
+
+			// tiles of CONV_DIRECT_TILE_COLS columns, then smaller tiles on the border
+			Index iCol = iColBegin;
+			if (_iColStride == 1)
+			{
+				for (; iCol + CONV_DIRECT_TILE_COLS <= iColEnd; iCol += CONV_DIRECT_TILE_COLS)
+					direct_tile<CONV_DIRECT_TILE_OUT, CONV_DIRECT_TILE_COLS, 1>(pfIn + (iCol - _iColPadding), 1, pOffsets, iKernelSize, pfWeightTile, pfOutTile + iCol, iOutPlaneSize, iNbOut);
+			}
+			else
+			{
+				for (; iCol + CONV_DIRECT_TILE_COLS <= iColEnd; iCol += CONV_DIRECT_TILE_COLS)
+					direct_tile<CONV_DIRECT_TILE_OUT, CONV_DIRECT_TILE_COLS, 0>(pfIn + (iCol * _iColStride - _iColPadding), _iColStride, pOffsets, iKernelSize, pfWeightTile, pfOutTile + iCol, iOutPlaneSize, iNbOut);
+			}
+
+			for (; iCol + 4 <= iColEnd; iCol += 4)
+				direct_tile<CONV_DIRECT_TILE_OUT, 4, 0>(pfIn + (iCol * _iColStride - _iColPadding), _iColStride, pOffsets, iKernelSize, pfWeightTile, pfOutTile + iCol, iOutPlaneSize, iNbOut);
+
+			for (; iCol < iColEnd; iCol++)
+				direct_tile<CONV_DIRECT_TILE_OUT, 1, 0>(pfIn + (iCol * _iColStride - _iColPadding), _iColStride, pOffsets, iKernelSize, pfWeightTile, pfOutTile + iCol, iOutPlaneSize, iNbOut);
+		}
+	});
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::direct_pixel(const float* pfInSample, Index iOutRow, Index iOutCol, float* pfOutSample) const
+{
+	Index iInPlaneSize = _iInRows * _iInCols;
+	Index iOutPlaneSize = _iOutRows * _iOutCols;
+	Index iInRow0 = iOutRow * _iRowStride - _iRowPadding;
+	Index iInCol0 = iOutCol * _iColStride - _iColPadding;
+
+	for (Index iOut = 0; iOut < _iOutChannels; iOut++)
+	{
+		const float* pfWeight = _weight.data() + iOut * _weight.cols();
+		float fSum = 0.f;
+
+		for (Index iInChannel = 0; iInChannel < _iInChannels; iInChannel++)
+			for (Index iKRow = 0; iKRow < _iKernelRows; iKRow++)
+			{
+				Index iInRow = iInRow0 + iKRow * _iRowDilation;
+				if ((iInRow < 0) || (iInRow >= _iInRows))
+					continue;
+
+				for (Index iKCol = 0; iKCol < _iKernelCols; iKCol++)
+				{
+					Index iInCol = iInCol0 + iKCol * _iColDilation;
+					if ((iInCol >= 0) && (iInCol < _iInCols))
+						fSum += pfWeight[(iInChannel * _iKernelRows + iKRow) * _iKernelCols + iKCol] * pfInSample[iInChannel * iInPlaneSize + iInRow * _iInCols + iInCol];
+				}
+			}
+
+		pfOutSample[iOut * iOutPlaneSize + iOutRow * _iOutCols + iOutCol] = fSum;
+	}
+}
+///////////////////////////////////////////////////////////////////////////////
+// Winograd F(mxm,3x3) transforms, from Lavin and Gray, "Fast Algorithms for Convolutional Neural Networks"
+// a tile of (m+2)x(m+2) inputs d gives the mxm outputs Y = At [(G g Gt) . (Bt d B)] A, g is the 3x3 kernel
+struct WinogradMatrices
+{
+	Index iM; // output tile size
+	Index iA; // input tile size, m+2
+	const float* pBt; // a x a
+	const float* pG; // a x 3
+	const float* pAt; // m x a
+};
+
+static const float g_winograd2Bt[16] = {
+	1.f, 0.f, -1.f, 0.f,
+	0.f, 1.f, 1.f, 0.f,
+	0.f, -1.f, 1.f, 0.f,
+	0.f, 1.f, 0.f, -1.f };
+static const float g_winograd2G[12] = {
+	1.f, 0.f, 0.f,
+	0.5f, 0.5f, 0.5f,
+	0.5f, -0.5f, 0.5f,
+	0.f, 0.f, 1.f };
+static const float g_winograd2At[8] = {
+	1.f, 1.f, 1.f, 0.f,
+	0.f, 1.f, -1.f, -1.f };
+
+static const float g_winograd4Bt[36] = {
+	4.f, 0.f, -5.f, 0.f, 1.f, 0.f,
+	0.f, -4.f, -4.f, 1.f, 1.f, 0.f,
+	0.f, 4.f, -4.f, -1.f, 1.f, 0.f,
+	0.f, -2.f, -1.f, 2.f, 1.f, 0.f,
+	0.f, 2.f, -1.f, -2.f, 1.f, 0.f,
+	0.f, 4.f, 0.f, -5.f, 0.f, 1.f };
+static const float g_winograd4G[18] = {
+	1.f / 4.f, 0.f, 0.f,
+	-1.f / 6.f, -1.f / 6.f, -1.f / 6.f,
+	-1.f / 6.f, 1.f / 6.f, -1.f / 6.f,
+	1.f / 24.f, 1.f / 12.f, 1.f / 6.f,
+	1.f / 24.f, -1.f / 12.f, 1.f / 6.f,
+	0.f, 0.f, 1.f };
+static const float g_winograd4At[24] = {
+	1.f, 1.f, 1.f, 1.f, 1.f, 0.f,
+	0.f, 1.f, -1.f, 2.f, -2.f, 0.f,
+	0.f, 1.f, 1.f, 4.f, 4.f, 0.f,
+	0.f, 1.f, -1.f, 8.f, -8.f, 1.f };
+
+static const WinogradMatrices g_winograd2 = { 2, 4, g_winograd2Bt, g_winograd2G, g_winograd2At };
+static const WinogradMatrices g_winograd4 = { 4, 6, g_winograd4Bt, g_winograd4G, g_winograd4At };
+
+#define WINOGRAD_MAX_TILE 6 // biggest input tile
+#define WINOGRAD_LANES 8 // tiles transformed at once, the inner loops on the tiles are vectorized
+///////////////////////////////////////////////////////////////////////////////
+static const WinogradMatrices& winograd_matrices(Index iTile)
+{
+	return iTile == 2 ? g_winograd2 : g_winograd4;
+}
+///////////////////////////////////////////////////////////////////////////////
+// pOut = L pIn Lt, L is iRows x iCols (or the transposed of the iCols x iRows pL if bTransposeL), pIn is iCols x iCols, pOut is iRows x iRows
+// for WINOGRAD_LANES tiles at once: the element (r,c) of the tile n is at [(r*size+c)*WINOGRAD_LANES+n]
+// the transforms matrices are mostly 0, 1 or -1: the zeros are skipped
+static void winograd_transform(const float* pL, bool bTransposeL, Index iRows, Index iCols, const float* pIn, float* pOut)
+{
+	float fTemp[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES]; // L pIn, iRows x iCols
+
+	for (Index r = 0; r < iRows; r++)
+		for (Index c = 0; c < iCols; c++)
+		{
+			float* pfTemp = fTemp + (r * iCols + c) * WINOGRAD_LANES;
+			for (int n = 0; n < WINOGRAD_LANES; n++)
+				pfTemp[n] = 0.f;
+
+			for (Index k = 0; k < iCols; k++)
+			{
+				float fL = bTransposeL ? pL[k * iRows + r] : pL[r * iCols + k];
+				if (fL == 0.f)
+					continue;
+
+				const float* pfIn = pIn + (k * iCols + c) * WINOGRAD_LANES;
+				for (int n = 0; n < WINOGRAD_LANES; n++)
+					pfTemp[n] += fL * pfIn[n];
+			}
+		}
+
+	for (Index r = 0; r < iRows; r++)
+		for (Index c = 0; c < iRows; c++)
+		{
+			float* pfOut = pOut + (r * iRows + c) * WINOGRAD_LANES;
+			for (int n = 0; n < WINOGRAD_LANES; n++)
+				pfOut[n] = 0.f;
+
+			for (Index k = 0; k < iCols; k++)
+			{
+				float fL = bTransposeL ? pL[k * iRows + c] : pL[c * iCols + k];
+				if (fL == 0.f)
+					continue;
+
+				const float* pfTemp = fTemp + (r * iCols + k) * WINOGRAD_LANES;
+				for (int n = 0; n < WINOGRAD_LANES; n++)
+					pfOut[n] += fL * pfTemp[n];
+			}
+		}
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::winograd_weight(Index iTile, MatrixFloat& mTransformedWeight) const
+{
+	// U = G g Gt, stored as (m+2)^2 rows of OutChannels x InChannels matrices, the input channels are transformed by lanes
+	const WinogradMatrices& w = winograd_matrices(iTile);
+	Index iA2 = w.iA * w.iA;
+	mTransformedWeight.resize(iA2, _iOutChannels * _iInChannels);
+	float* pfU = mTransformedWeight.data();
+
+	for (Index iOut = 0; iOut < _iOutChannels; iOut++)
+		for (Index iIn0 = 0; iIn0 < _iInChannels; iIn0 += WINOGRAD_LANES)
+		{
+			Index iNbLanes = min<Index>(WINOGRAD_LANES, _iInChannels - iIn0);
+			float fG[9 * WINOGRAD_LANES] = { 0.f }, fU[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES];
+			for (Index k = 0; k < 9; k++)
+				for (Index n = 0; n < iNbLanes; n++)
+					fG[k * WINOGRAD_LANES + n] = _weight(iOut, (iIn0 + n) * 9 + k);
+
+			winograd_transform(w.pG, false, w.iA, 3, fG, fU);
+
+			for (Index p = 0; p < iA2; p++)
+				for (Index n = 0; n < iNbLanes; n++)
+					pfU[p * _iOutChannels * _iInChannels + iOut * _iInChannels + iIn0 + n] = fU[p * WINOGRAD_LANES + n];
+		}
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::winograd_forward(Index iTile, const MatrixFloat& mIn, MatrixFloat& mOut, const MatrixFloat& mTransformedWeight, MatrixFloat& mTransformedIn, MatrixFloat& mProduct) const
+{
+	assert(mIn.cols() == _iInRows * _iInCols*_iInChannels);
+	const WinogradMatrices& w = winograd_matrices(iTile);
+	Index iA2 = w.iA * w.iA;
+	Index iSamples = mIn.rows();
+	Index iTileRows = (_iOutRows + iTile - 1) / iTile;
+	Index iTileCols = (_iOutCols + iTile - 1) / iTile;
+	Index iNbTiles = iSamples * iTileRows * iTileCols;
+	Index iInPlaneSize = _iInRows * _iInCols;
+	Index iOutPlaneSize = _iOutRows * _iOutCols;
+
+	// V = Bt d B, stored as (m+2)^2 rows of InChannels x Tiles matrices
+	mTransformedIn.resize(iA2, _iInChannels * iNbTiles);
+	const float* pfInData = mIn.data();
+	float* pfV = mTransformedIn.data();
+
+	parallel_for(iSamples * iTileRows, [&](Index iTask)
+	{
+		Index iSample = iTask / iTileRows;
+		Index iTileRow = iTask % iTileRows;
+
+		for (Index iTileCol0 = 0; iTileCol0 < iTileCols; iTileCol0 += WINOGRAD_LANES)
+		{
+			Index iNbLanes = min<Index>(WINOGRAD_LANES, iTileCols - iTileCol0);
+			Index iTileIndex = iTask * iTileCols + iTileCol0;
+			Index iRow0 = iTileRow * iTile - _iRowPadding;
+
+			for (Index iIn = 0; iIn < _iInChannels; iIn++)
+			{
+				// the input tiles, the pixels out of the image are the zeros of the padding
+				const float* pfPlane = pfInData + iSample * _iInChannels * iInPlaneSize + iIn * iInPlaneSize;
+				float fD[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES], fV[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES];
+				for (Index r = 0; r < w.iA; r++)
+					for (Index c = 0; c < w.iA; c++)
+						for (Index n = 0; n < WINOGRAD_LANES; n++)
+						{
+							Index iRow = iRow0 + r, iCol = (iTileCol0 + n) * iTile + c - _iColPadding;
+							bool bInImage = (iRow >= 0) && (iRow < _iInRows) && (iCol >= 0) && (iCol < _iInCols);
+							fD[(r * w.iA + c) * WINOGRAD_LANES + n] = ((n < iNbLanes) && bInImage) ? pfPlane[iRow * _iInCols + iCol] : 0.f;
+						}
+
+				winograd_transform(w.pBt, false, w.iA, w.iA, fD, fV);
+
+				for (Index p = 0; p < iA2; p++)
+					for (Index n = 0; n < iNbLanes; n++)
+						pfV[p * _iInChannels * iNbTiles + iIn * iNbTiles + iTileIndex + n] = fV[p * WINOGRAD_LANES + n];
+			}
+		}
+	});
+
+	// M = U . V, one GEMM for each of the (m+2)^2 positions: the elementwise products summed on the input channels
+	mProduct.resize(iA2, _iOutChannels * iNbTiles);
+	const float* pfU = mTransformedWeight.data();
+	float* pfM = mProduct.data();
+	parallel_for(iA2, [&](Index p)
+	{
+		gemm_packed(_iOutChannels, iNbTiles, _iInChannels, 1.f,
+			pfU + p * _iOutChannels * _iInChannels, _iInChannels, 1,
+			pfV + p * _iInChannels * iNbTiles, iNbTiles, 1,
+			0.f, pfM + p * _iOutChannels * iNbTiles, iNbTiles);
+	});
+
+	// Y = At M A, the outputs out of the image are not written
+	mOut.resize(iSamples, _iOutChannels * iOutPlaneSize);
+	float* pfOutData = mOut.data();
+	parallel_for(iSamples * iTileRows, [&](Index iTask)
+	{
+		Index iSample = iTask / iTileRows;
+		Index iTileRow = iTask % iTileRows;
+
+		for (Index iTileCol0 = 0; iTileCol0 < iTileCols; iTileCol0 += WINOGRAD_LANES)
+		{
+			Index iNbLanes = min<Index>(WINOGRAD_LANES, iTileCols - iTileCol0);
+			Index iTileIndex = iTask * iTileCols + iTileCol0;
+			Index iRow0 = iTileRow * iTile;
+
+			for (Index iOut = 0; iOut < _iOutChannels; iOut++)
+			{
+				float fM[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES] = { 0.f }, fY[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES];
+				for (Index p = 0; p < iA2; p++)
+					for (Index n = 0; n < iNbLanes; n++)
+						fM[p * WINOGRAD_LANES + n] = pfM[p * _iOutChannels * iNbTiles + iOut * iNbTiles + iTileIndex + n];
+
+				winograd_transform(w.pAt, false, iTile, w.iA, fM, fY);
+
+				float* pfPlane = pfOutData + iSample * _iOutChannels * iOutPlaneSize + iOut * iOutPlaneSize;
+				for (Index r = 0; (r < iTile) && (iRow0 + r < _iOutRows); r++)
+					for (Index n = 0; n < iNbLanes; n++)
+						for (Index c = 0; (c < iTile) && ((iTileCol0 + n) * iTile + c < _iOutCols); c++)
+							pfPlane[(iRow0 + r) * _iOutCols + (iTileCol0 + n) * iTile + c] = fY[(r * iTile + c) * WINOGRAD_LANES + n];
+			}
+		}
+	});
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::winograd_backpropagation(Index iTile, const MatrixFloat& mGradientOut, MatrixFloat& mGradientIn)
+{
+	// the transposed operations of winograd_forward(), with the transformed weights and inputs of the forward
+	const WinogradMatrices& w = winograd_matrices(iTile);
+	Index iA2 = w.iA * w.iA;
+	Index iTileRows = (_iOutRows + iTile - 1) / iTile;
+	Index iTileCols = (_iOutCols + iTile - 1) / iTile;
+	Index iNbTiles = _iSamples * iTileRows * iTileCols;
+	Index iInPlaneSize = _iInRows * _iInCols;
+	Index iOutPlaneSize = _iOutRows * _iOutCols;
+
+	// dM = A dY At, the gradients out of the image are zeros
+	MatrixFloat& mGradientProduct = _winogradProduct;
+	mGradientProduct.resize(iA2, _iOutChannels * iNbTiles);
+	const float* pfGradientOut = mGradientOut.data();
+	float* pfDM = mGradientProduct.data();
+
+	parallel_for(_iSamples * iTileRows, [&](Index iTask)
+	{
+		Index iSample = iTask / iTileRows;
+		Index iTileRow = iTask % iTileRows;
+
+		for (Index iTileCol0 = 0; iTileCol0 < iTileCols; iTileCol0 += WINOGRAD_LANES)
+		{
+			Index iNbLanes = min<Index>(WINOGRAD_LANES, iTileCols - iTileCol0);
+			Index iTileIndex = iTask * iTileCols + iTileCol0;
+			Index iRow0 = iTileRow * iTile;
+
+			for (Index iOut = 0; iOut < _iOutChannels; iOut++)
+			{
+				const float* pfPlane = pfGradientOut + iSample * _iOutChannels * iOutPlaneSize + iOut * iOutPlaneSize;
+				float fDY[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES], fDM[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES];
+				for (Index r = 0; r < iTile; r++)
+					for (Index c = 0; c < iTile; c++)
+						for (Index n = 0; n < WINOGRAD_LANES; n++)
+						{
+							Index iCol = (iTileCol0 + n) * iTile + c;
+							fDY[(r * iTile + c) * WINOGRAD_LANES + n] = ((n < iNbLanes) && (iRow0 + r < _iOutRows) && (iCol < _iOutCols)) ? pfPlane[(iRow0 + r) * _iOutCols + iCol] : 0.f;
+						}
+
+				winograd_transform(w.pAt, true, w.iA, iTile, fDY, fDM);
+
+				for (Index p = 0; p < iA2; p++)
+					for (Index n = 0; n < iNbLanes; n++)
+						pfDM[p * _iOutChannels * iNbTiles + iOut * iNbTiles + iTileIndex + n] = fDM[p * WINOGRAD_LANES + n];
+			}
+		}
+	});
+
+	// dU = dM Vt, summed on all the tiles of all the samples
+	const float* pfV = _im2colT.data();
+	MatrixFloat mGradientTransformedWeight;
+	mGradientTransformedWeight.resize(iA2, _iOutChannels * _iInChannels);
+	float* pfDU = mGradientTransformedWeight.data();
+	parallel_for(iA2, [&](Index p)
+	{
+		gemm_packed(_iOutChannels, _iInChannels, iNbTiles, 1.f,
+			pfDM + p * _iOutChannels * iNbTiles, iNbTiles, 1,
+			pfV + p * _iInChannels * iNbTiles, 1, iNbTiles,
+			0.f, pfDU + p * _iOutChannels * _iInChannels, _iInChannels);
+	});
+
+	// dg = Gt dU G
+	_gradientWeight.resize(_iOutChannels, _iInChannels * 9);
+	for (Index iOut = 0; iOut < _iOutChannels; iOut++)
+		for (Index iIn0 = 0; iIn0 < _iInChannels; iIn0 += WINOGRAD_LANES)
+		{
+			Index iNbLanes = min<Index>(WINOGRAD_LANES, _iInChannels - iIn0);
+			float fDU[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES] = { 0.f }, fDG[9 * WINOGRAD_LANES];
+			for (Index p = 0; p < iA2; p++)
+				for (Index n = 0; n < iNbLanes; n++)
+					fDU[p * WINOGRAD_LANES + n] = pfDU[p * _iOutChannels * _iInChannels + iOut * _iInChannels + iIn0 + n];
+
+			winograd_transform(w.pG, true, 3, w.iA, fDU, fDG);
+
+			for (Index k = 0; k < 9; k++)
+				for (Index n = 0; n < iNbLanes; n++)
+					_gradientWeight(iOut, (iIn0 + n) * 9 + k) = fDG[k * WINOGRAD_LANES + n];
+		}
+
+	if (_bFirstLayer)
+		return;
+
+	// dV = Ut dM
+	MatrixFloat mGradientTransformedIn;
+	mGradientTransformedIn.resize(iA2, _iInChannels * iNbTiles);
+	const float* pfU = _winogradWeight.data();
+	float* pfDV = mGradientTransformedIn.data();
+	parallel_for(iA2, [&](Index p)
+	{
+		gemm_packed(_iInChannels, iNbTiles, _iOutChannels, 1.f,
+			pfU + p * _iOutChannels * _iInChannels, 1, _iInChannels,
+			pfDM + p * _iOutChannels * iNbTiles, iNbTiles, 1,
+			0.f, pfDV + p * _iInChannels * iNbTiles, iNbTiles);
+	});
+
+	// dd = B dV Bt, the overlapping tiles are summed in the image
+	// one task by sample and input channel: the tasks write distinct image planes, in the same order whatever the number of threads
+	float fScale = 1.f / (_iKernelRows * _iKernelCols * _iOutChannels); // mean instead of sum, as col2im()
+	mGradientIn.resize(_iSamples, _iInChannels * iInPlaneSize);
+	float* pfGradientIn = mGradientIn.data();
+
+	parallel_for(_iSamples * _iInChannels, [&](Index iTask)
+	{
+		Index iSample = iTask / _iInChannels;
+		Index iIn = iTask % _iInChannels;
+
+		float* pfPlane = pfGradientIn + iTask * iInPlaneSize;
+		for (Index i = 0; i < iInPlaneSize; i++)
+			pfPlane[i] = 0.f;
+
+		for (Index iTileRow = 0; iTileRow < iTileRows; iTileRow++)
+			for (Index iTileCol0 = 0; iTileCol0 < iTileCols; iTileCol0 += WINOGRAD_LANES)
+			{
+				Index iNbLanes = min<Index>(WINOGRAD_LANES, iTileCols - iTileCol0);
+				Index iTileIndex = (iSample * iTileRows + iTileRow) * iTileCols + iTileCol0;
+				Index iRow0 = iTileRow * iTile - _iRowPadding;
+
+				float fDV[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES] = { 0.f }, fDD[WINOGRAD_MAX_TILE * WINOGRAD_MAX_TILE * WINOGRAD_LANES];
+				for (Index p = 0; p < iA2; p++)
+					for (Index n = 0; n < iNbLanes; n++)
+						fDV[p * WINOGRAD_LANES + n] = pfDV[p * _iInChannels * iNbTiles + iIn * iNbTiles + iTileIndex + n];
+
+				winograd_transform(w.pBt, true, w.iA, w.iA, fDV, fDD);
+
+				// the tiles in the order of the columns, the gradients of the padding are dropped
+				for (Index n = 0; n < iNbLanes; n++)
+					for (Index r = 0; r < w.iA; r++)
+						for (Index c = 0; c < w.iA; c++)
+						{
+							Index iRow = iRow0 + r, iCol = (iTileCol0 + n) * iTile + c - _iColPadding;
+							if ((iRow >= 0) && (iRow < _iInRows) && (iCol >= 0) && (iCol < _iInCols))
+								pfPlane[iRow * _iInCols + iCol] += fDD[(r * w.iA + c) * WINOGRAD_LANES + n];
+						}
+			}
+
+		for (Index i = 0; i < iInPlaneSize; i++)
+			pfPlane[i] *= fScale;
+	});
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::im2col(const MatrixFloat & mIn, MatrixFloat & mCol) const
 {
 	//slow reference version	
 	assert(mIn.cols() == _iInRows * _iInCols*_iInChannels);
-	_iSamples = (int)mIn.rows();
+	Index iSamples = mIn.rows();
 
-	mCol.resize(_iOutRows * _iOutCols* _iSamples,_iKernelRows * _iKernelCols*_iInChannels );
+	mCol.resize(_iOutRows * _iOutCols* iSamples,_iKernelRows * _iKernelCols*_iInChannels );
 	
-	for (Index iSample = 0; iSample < _iSamples; iSample++)
+	for (Index iSample = 0; iSample < iSamples; iSample++)
 	{
 		for (Index iInChannel = 0; iInChannel < _iInChannels; iInChannel++)
 		{
@@ -145,15 +834,14 @@ void LayerConvolution2D::im2col(const MatrixFloat & mIn, MatrixFloat & mCol)
 					{
 						for (Index iOutCol = 0; iOutCol < _iOutCols; iOutCol++)
 						{
-							Index iRowInPlane = iOutRow*_iRowStride+iKRow;
-							Index iColInPlane = iOutCol*_iColStride+iKCol;
+							Index iRowInPlane = iOutRow*_iRowStride+iKRow*_iRowDilation-_iRowPadding;
+							Index iColInPlane = iOutCol*_iColStride+iKCol*_iColDilation-_iColPadding;
 							
-							assert(iRowInPlane >=0);
-							assert(iColInPlane >=0);
-							assert(iRowInPlane < _iInRows);
-							assert(iColInPlane < _iInCols);
-							
-							float f = mIn(iSample, iInChannel*_iInRows*_iInCols + iRowInPlane*_iInCols+ iColInPlane);
+							// zero in the padding
+							float f = 0.f;
+							if ((iRowInPlane >= 0) && (iColInPlane >= 0) && (iRowInPlane < _iInRows) && (iColInPlane < _iInCols))
+								f = mIn(iSample, iInChannel*_iInRows*_iInCols + iRowInPlane*_iInCols+ iColInPlane);
+
 							mCol(
 								iSample*_iOutCols*_iOutRows + iOutRow * _iOutCols + iOutCol
 								,
@@ -169,8 +857,8 @@ void LayerConvolution2D::im2col(const MatrixFloat & mIn, MatrixFloat & mCol)
 ///////////////////////////////////////////////////////////////////////////////
 void LayerConvolution2D::col2im(const MatrixFloat & mCol, MatrixFloat & mIm)
 {
-	assert(mCol.rows() == _iKernelRows * _iKernelCols*_iInChannels);
-	assert(mCol.cols() == _iOutRows * _iOutCols* _iSamples);
+	assert(mCol.rows() == _iOutRows * _iOutCols* _iSamples);
+	assert(mCol.cols() == _iKernelRows * _iKernelCols*_iInChannels);
 
 	//slow reference version
 	mIm.setZero(_iSamples, _iInChannels* _iInRows * _iInCols);
@@ -186,17 +874,16 @@ void LayerConvolution2D::col2im(const MatrixFloat & mCol, MatrixFloat & mIm)
 					{
 						for (Index iKCol = 0; iKCol < _iKernelCols; iKCol++)
 						{
-							Index iRowInPlane = iOutRow * _iRowStride + iKRow;
-							Index iColInPlane = iOutCol * _iColStride + iKCol;
+							Index iRowInPlane = iOutRow * _iRowStride + iKRow * _iRowDilation - _iRowPadding;
+							Index iColInPlane = iOutCol * _iColStride + iKCol * _iColDilation - _iColPadding;
 
-							assert(iRowInPlane >= 0);
-							assert(iColInPlane >= 0);
-							assert(iRowInPlane < _iInRows);
-							assert(iColInPlane < _iInCols);
+							// the gradient of the padding is dropped
+							if ((iRowInPlane < 0) || (iColInPlane < 0) || (iRowInPlane >= _iInRows) || (iColInPlane >= _iInCols))
+								continue;
 
 							float f = mCol(
-								iInChannel*_iKernelRows * _iKernelCols + iKRow * _iKernelCols + iKCol,
-								iSample*_iOutCols*_iOutRows + iOutRow * _iOutCols + iOutCol
+								iSample*_iOutCols*_iOutRows + iOutRow * _iOutCols + iOutCol,
+								iInChannel*_iKernelRows * _iKernelCols + iKRow * _iKernelCols + iKCol
 								);
 							mIm(
 								iSample,
@@ -215,147 +902,188 @@ void LayerConvolution2D::col2im(const MatrixFloat & mCol, MatrixFloat & mIm)
 ///////////////////////////////////////////////////////////////////////////////
 void LayerConvolution2D::col2im_LUT(const MatrixFloat & mCol, MatrixFloat & mIm)
 {
-	assert(mCol.rows() == _iKernelRows * _iKernelCols*_iInChannels);
-	assert(mCol.cols() == _iOutRows * _iOutCols* _iSamples);
+	assert(mCol.rows() == _iOutRows * _iOutCols* _iSamples);
+	assert(mCol.cols() == _iKernelRows * _iKernelCols*_iInChannels);
 
-	//slow reference version
-	mIm.setZero(_iSamples, _iInChannels* _iInRows * _iInCols);
-	for (Index iSample = 0; iSample < _iSamples; iSample++)
+	Index iPlaneSize = _iInRows * _iInCols;
+	Index iKernelSize = mCol.cols();
+	float fScale = 1.f / (_iKernelRows * _iKernelCols * _iOutChannels); // mean instead of sum
+
+	mIm.resize(_iSamples, _iInChannels * iPlaneSize);
+	float* pfImData = mIm.data();
+	const float* pfColData = mCol.data();
+
+	// one task by sample and input channel: the tasks write distinct image planes
+	// the gradients of an image pixel are summed in the same order whatever the number of threads
+	parallel_for(_iSamples * _iInChannels, [&](Index iTask)
 	{
-		for (Index iOutRow = 0; iOutRow < _iOutRows; iOutRow++)
-		{
+		Index iSample = iTask / _iInChannels;
+		Index iInChannel = iTask % _iInChannels;
 
+		float* pfPlane = pfImData + iSample * _iInChannels * iPlaneSize + iInChannel * iPlaneSize;
+		for (Index i = 0; i < iPlaneSize; i++)
+			pfPlane[i] = 0.f;
 
-				/*
-				Index iDecal = iSample * _iInRows*_iInCols*_iInChannels + iOutRow * _iInCols *_iRowStride + iOutCol * _iColStride;
-				const float *pIn = mIn.data() + iDecal;
-				Index iRowDest = iOutCol + iOutRow * _iOutCols;
-				float * pOut = mCol.data() + iRowDest * mCol.cols() + iSample * _iOutCols*_iOutRows*iLUTRows;
-				for (Index iLUT = 0; iLUT < iLUTRows; iLUT++)
-					*(pOut + iLUT) = *(pIn + _im2ColLUT[iLUT]);
-				*/
+		float* pfImSample = pfImData + iSample * _iInChannels * iPlaneSize;
+		const Index* pLUT = _im2ColLUT.data() + iInChannel * _iKernelRows;
 
-				Index iFromCol=iSample*_iOutCols*_iOutRows + iOutRow * _iOutCols ;
-				Index iDecal = iSample * _iInRows*_iInCols*_iInChannels+ + iOutRow * _iRowStride*_iInCols;
-				float *pfIm = mIm.data() + iDecal;
+		for (Index iOutRow = 0; iOutRow < _iOutRows; iOutRow++)
+		{
+			Index iInRow0 = iOutRow * _iRowStride - _iRowPadding;
+			bool bInteriorRow = (iOutRow >= _iOutRowBegin) && (iOutRow < _iOutRowEnd) && (_iColDilation == 1);
 
-				for (Index iInChannel = 0; iInChannel < _iInChannels; iInChannel++)
+			for (Index iOutCol = 0; iOutCol < _iOutCols; iOutCol++)
+			{
+				Index iInCol0 = iOutCol * _iColStride - _iColPadding;
+				Index iOffset = iInRow0 * _iInCols + iInCol0;
+				const float* pfCol = pfColData + (iSample * _iOutRows * _iOutCols + iOutRow * _iOutCols + iOutCol) * iKernelSize + iInChannel * _iKernelRows * _iKernelCols;
+
+				// a kernel row is contiguous in the image and in the im2col row
+				if (bInteriorRow && (iOutCol >= _iOutColBegin) && (iOutCol < _iOutColEnd))
 				{
+					float* pfIm = pfImSample + iOffset;
 					for (Index iKRow = 0; iKRow < _iKernelRows; iKRow++)
 					{
-						Index iRowInPlane = iKRow*_iInCols+ iInChannel * _iInRows*_iInCols;
-
+						float* pfImRow = pfIm + pLUT[iKRow];
 						for (Index iKCol = 0; iKCol < _iKernelCols; iKCol++)
-						{
-
-							for (Index iOutCol = 0; iOutCol < _iOutCols; iOutCol++)
-							{
-
+							pfImRow[iKCol] += pfCol[iKCol];
+						pfCol += _iKernelCols;
+					}
+					continue;
+				}
 
-							float f = mCol(
-								iInChannel*_iKernelRows * _iKernelCols + iKRow * _iKernelCols + iKCol,
-								iFromCol + iOutCol
-							);
+				// on the borders or with a dilation: the gradients of the padding are dropped
+				Index iKColBegin, iKColEnd;
+				kernel_cols_in_image(iInCol0, iKColBegin, iKColEnd);
 
-							*(pfIm + iRowInPlane + iKCol+ iOutCol * _iColStride) += f;
-						}
+				for (Index iKRow = 0; iKRow < _iKernelRows; iKRow++)
+				{
+					Index iInRow = iInRow0 + iKRow * _iRowDilation;
+					Index iRowOffset = pLUT[iKRow] + iOffset;
+					if ((iInRow >= 0) && (iInRow < _iInRows))
+					{
+						for (Index iKCol = iKColBegin; iKCol < iKColEnd; iKCol++)
+							pfImSample[iRowOffset + iKCol * _iColDilation] += pfCol[iKCol];
 					}
+					pfCol += _iKernelCols;
 				}
-
 			}
 		}
-	}
 
-	//rescale data to compute mean instead of sum
-	mIm *= (1.f / (_iKernelRows* _iKernelCols* _iOutChannels));
+		for (Index i = 0; i < iPlaneSize; i++)
+			pfPlane[i] *= fScale;
+	});
 }
 ///////////////////////////////////////////////////////////////////////////////
-void LayerConvolution2D::reshape_to_out(MatrixFloat & mOut)
+void LayerConvolution2D::im2col_LUT(const MatrixFloat & mIn, MatrixFloat & mCol) const
 {
-	assert(mOut.cols() == _iSamples * _iOutRows * _iOutCols);
-	assert(mOut.rows() ==  _iOutChannels);
+	assert(mIn.cols() == _iInRows * _iInCols*_iInChannels);
+	Index iSamples = mIn.rows();
+	Index iKernelSize = _iKernelRows * _iKernelCols * _iInChannels;
+	mCol.resize(_iOutRows * _iOutCols* iSamples, iKernelSize);
 
-	mOut.resize(_iSamples * _iOutChannels, _iOutRows * _iOutCols );
-	_tempImg = mOut; //for now, use a copy
+	Index iLUTRows = _im2ColLUT.size();
+	const float* pfInData = mIn.data();
+	float* pfColData = mCol.data();
 
-	for (Index iOutChannel = 0; iOutChannel < _iOutChannels; iOutChannel++)
+	// one task by sample and output row: the tasks write distinct im2col rows
+	parallel_for(iSamples * _iOutRows, [&](Index iTask)
 	{
-		for (Index iSample = 0; iSample < _iSamples; iSample++)
+		Index iSample = iTask / _iOutRows;
+		Index iOutRow = iTask % _iOutRows;
+		Index iInRow0 = iOutRow * _iRowStride - _iRowPadding;
+		bool bInteriorRow = (iOutRow >= _iOutRowBegin) && (iOutRow < _iOutRowEnd) && (_iColDilation == 1);
+
+		const float* pfInSample = pfInData + iSample * _iInRows * _iInCols * _iInChannels;
+		float* pfCol = pfColData + (iSample * _iOutRows * _iOutCols + iOutRow * _iOutCols) * iKernelSize;
+
+		for (Index iOutCol = 0; iOutCol < _iOutCols; iOutCol++)
 		{
-			Index iOrigRow = iSample+ iOutChannel* _iSamples;
-			Index iDestRow = iOutChannel+ iSample* _iOutChannels;
+			Index iInCol0 = iOutCol * _iColStride - _iColPadding;
+			Index iOffset = iInRow0 * _iInCols + iInCol0;
 
-			mOut.row(iDestRow) = _tempImg.row(iOrigRow);
-		}
-	}
-	mOut.resize(_iSamples, _iOutRows * _iOutCols * _iOutChannels);
-}
-///////////////////////////////////////////////////////////////////////////////
-void LayerConvolution2D::reshape_from_out(MatrixFloat & mOut)
-{
-	assert(mOut.cols() == _iOutChannels*_iOutRows * _iOutCols);
-	assert(mOut.rows() == _iSamples);
+			// a kernel row is contiguous in the image and in the im2col row
+			if (bInteriorRow && (iOutCol >= _iOutColBegin) && (iOutCol < _iOutColEnd))
+			{
+				const float* pfIn = pfInSample + iOffset;
+				for (Index iLUT = 0; iLUT < iLUTRows; iLUT++)
+				{
+					const float* pfInKernelRow = pfIn + _im2ColLUT[iLUT];
+					for (Index iKCol = 0; iKCol < _iKernelCols; iKCol++)
+						pfCol[iKCol] = pfInKernelRow[iKCol];
+					pfCol += _iKernelCols;
+				}
+				continue;
+			}
 
-	mOut.resize(_iSamples * _iOutChannels, _iOutRows * _iOutCols);
+			// on the borders or with a dilation: the taps in the padding are zeros
+			Index iKColBegin, iKColEnd;
+			kernel_cols_in_image(iInCol0, iKColBegin, iKColEnd);
+			const Index* pLUT = _im2ColLUT.data();
 
-	_tempImg = mOut; //for now, use a copy
+			for (Index iInChannel = 0; iInChannel < _iInChannels; iInChannel++)
+				for (Index iKRow = 0; iKRow < _iKernelRows; iKRow++)
+				{
+					Index iInRow = iInRow0 + iKRow * _iRowDilation;
+					Index iRowOffset = *pLUT++ + iOffset;
+					bool bInRow = (iInRow >= 0) && (iInRow < _iInRows);
+					Index iKCol = 0;
 
-	for (Index iOutChannel = 0; iOutChannel < _iOutChannels; iOutChannel++)
-	{
-		for (Index iSample = 0; iSample < _iSamples; iSample++)
-		{
-			Index iOrigRow = iSample + iOutChannel * _iSamples;
-			Index iDestRow = iOutChannel + iSample * _iOutChannels;
+					if (bInRow)
+					{
+						for (; iKCol < iKColBegin; iKCol++)
+							pfCol[iKCol] = 0.f;
+						for (; iKCol < iKColEnd; iKCol++)
+							pfCol[iKCol] = pfInSample[iRowOffset + iKCol * _iColDilation];
+					}
+					for (; iKCol < _iKernelCols; iKCol++)
+						pfCol[iKCol] = 0.f;
 
-			mOut.row(iOrigRow) = _tempImg.row(iDestRow);
+					pfCol += _iKernelCols;
+				}
 		}
-	}
-	mOut.resize(_iOutChannels, _iOutRows*_iOutCols*_iSamples);
+	});
 }
 ///////////////////////////////////////////////////////////////////////////////
-void LayerConvolution2D::im2col_LUT(const MatrixFloat & mIn, MatrixFloat & mCol)
+// [iBegin, iEnd) the outputs with all their taps in the image, along one axis
+static void interior_range(Index iIn, Index iOut, Index iKernel, Index iStride, Index iPadding, Index iDilation, Index& iBegin, Index& iEnd)
 {
-	assert(mIn.cols() == _iInRows * _iInCols*_iInChannels);
-	_iSamples = (int)mIn.rows();
-	mCol.resize(_iOutRows * _iOutCols* _iSamples, _iKernelRows * _iKernelCols*_iInChannels);
-
-	Index iLUTRows = _im2ColLUT.size();
-
-//#pragma omp parallel for
-	for (Index iSample = 0; iSample < _iSamples; iSample++)
-	{
-		for (Index iOutRow = 0; iOutRow < _iOutRows; iOutRow++)
-		{
-			for (Index iOutCol = 0; iOutCol < _iOutCols; iOutCol++)
-			{
-				Index iDecal = iSample * _iInRows*_iInCols*_iInChannels + iOutRow * _iInCols *_iRowStride + iOutCol* _iColStride;
+	iBegin = min(iOut, (iPadding + iStride - 1) / iStride);
 
-				const float *pfIn = mIn.data() + iDecal;
-				Index iRowDest = iOutCol + iOutRow * _iOutCols;
-				float * pfCol = mCol.data() + iRowDest * mCol.cols()+iSample*_iOutCols*_iOutRows*iLUTRows;
-				for (Index iLUT = 0; iLUT < iLUTRows; iLUT++)
-				{
-					*(pfCol +iLUT)= *(pfIn+_im2ColLUT[iLUT]);
-				}
-			}
-		}
-	}
+	Index iLastStart = iIn - 1 + iPadding - (iKernel - 1) * iDilation; // last first tap in the image, in the padded image
+	iEnd = iLastStart < 0 ? 0 : iLastStart / iStride + 1;
+	iEnd = max(iBegin, min(iOut, iEnd));
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerConvolution2D::kernel_cols_in_image(Index iInCol0, Index& iKColBegin, Index& iKColEnd) const
+{
+	// the kernel columns of the taps in the image, the first tap is at the column iInCol0
+	iKColBegin = iInCol0 >= 0 ? 0 : min(_iKernelCols, (_iColDilation - 1 - iInCol0) / _iColDilation);
+	iKColEnd = iInCol0 >= _iInCols ? 0 : min(_iKernelCols, (_iInCols - 1 - iInCol0) / _iColDilation + 1);
+	iKColEnd = max(iKColBegin, iKColEnd);
 }
 ///////////////////////////////////////////////////////////////////////////////
 void LayerConvolution2D::create_im2col_LUT()
 {
-	_im2ColLUT.resize(_iKernelRows * _iKernelCols*_iInChannels);
+	// offset in the image of each kernel position, for the direct convolution
+	_directLUT.resize(_iInChannels * _iKernelRows * _iKernelCols);
+	for (Index iInChannel = 0; iInChannel < _iInChannels; iInChannel++)
+		for (Index iKRow = 0; iKRow < _iKernelRows; iKRow++)
+			for (Index iKCol = 0; iKCol < _iKernelCols; iKCol++)
+				_directLUT[(iInChannel * _iKernelRows + iKRow) * _iKernelCols + iKCol] = iInChannel * _iInRows * _iInCols + iKRow * _iRowDilation * _iInCols + iKCol * _iColDilation;
+
+	// offset of each kernel row in the image, by input channel then kernel row
+	_im2ColLUT.resize(_iInChannels * _iKernelRows);
 	for (Index iInChannel = 0; iInChannel < _iInChannels; iInChannel++)
 	{
 		for (Index iKRow = 0; iKRow < _iKernelRows; iKRow++)
 		{
-			for (Index iKCol = 0; iKCol < _iKernelCols; iKCol++)
-			{
-				_im2ColLUT[iKCol + iKRow * _iKernelCols+iInChannel* _iKernelRows*_iKernelCols] = 
-					(iInChannel*_iInRows*_iInCols+iKRow*_iInCols+iKCol);
-			}
+			_im2ColLUT[iKRow + iInChannel * _iKernelRows] = iInChannel * _iInRows * _iInCols + iKRow * _iRowDilation * _iInCols;
 		}
 	}
+
+	interior_range(_iInRows, _iOutRows, _iKernelRows, _iRowStride, _iRowPadding, _iRowDilation, _iOutRowBegin, _iOutRowEnd);
+	interior_range(_iInCols, _iOutCols, _iKernelCols, _iColStride, _iColPadding, _iColDilation, _iOutColBegin, _iOutColEnd);
 }
 ///////////////////////////////////////////////////////////////////////////////
 }
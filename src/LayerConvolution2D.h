@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "Layer.h"
@@ -17,7 +18,11 @@ namespace beednn {
 class LayerConvolution2D : public Layer
 {
 public:
-	LayerConvolution2D(Index iInRows, Index iInCols,Index iInChannels, Index iKernelRows, Index iKernelCols,Index iOutChannels,Index iRowStride=1, Index iColStride=1);
+	// the padding adds zeros around the image without copy, the taps out of the image are zeros: no LayerZeroPadding2D needed
+	// 'same' output size with stride 1 and odd kernels: padding = dilation * (kernel - 1) / 2
+	// the dilation spaces the kernel taps, the kernel covers dilation * (kernel - 1) + 1 pixels
+	LayerConvolution2D(Index iInRows, Index iInCols,Index iInChannels, Index iKernelRows, Index iKernelCols,Index iOutChannels,Index iRowStride=1, Index iColStride=1,
+		Index iRowPadding = 0, Index iColPadding = 0, Index iRowDilation = 1, Index iColDilation = 1);
     virtual ~LayerConvolution2D() override;
 
 	void get_params(Index& iInRows, Index& iInCols,Index& iInChannels, Index& iKernelRows, Index& iKernelCols,Index& iOutChannels) const;
@@ -27,42 +32,77 @@ public:
 	virtual void init() override;
 
     void get_params(Index & iInRows, Index & iInCols, Index & iInChannels, Index & iKernelRows, Index & iKernelCols, Index & iOutChannels, Index & iRowStride, Index & iColStride) const;
+    void get_padding(Index & iRowPadding, Index & iColPadding) const;
+    void get_dilation(Index & iRowDilation, Index & iColDilation) const;
+    void get_output_size(Index & iOutRows, Index & iOutCols) const;
+
+    // "Im2Col": im2col then GEMM, "Direct": convolution without im2col, in output tiles kept in registers
+    // "Winograd2x2", "Winograd4x4": Winograd F(2x2,3x3) or F(4x4,3x3), 2.25 or 4 times less multiplications, for the 3x3 kernels with stride 1 and without dilation only
+    // "Auto" (default): in predict(), Direct for the small kernels with few input channels, else Im2Col, Winograd is only used on demand
+    // in training Auto is Im2Col: the backpropagation of Direct needs the im2col anyway
+    void set_algorithm(const std::string& sAlgorithm);
+    std::string algorithm() const; // the algorithm used by predict(): Im2Col, Direct, Winograd2x2 or Winograd4x4
 
     virtual void forward(const MatrixFloat& mIn, MatrixFloat &mOut) override;
+    virtual void predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const override;
     virtual void backpropagation(const MatrixFloat &mIn,const MatrixFloat &mGradientOut, MatrixFloat &mGradientIn) override;
 
 	//public for tests
-	void im2col(const MatrixFloat & mIn, MatrixFloat & mCol);
-	void im2col_LUT(const MatrixFloat & mIn, MatrixFloat & mCol);
+	// mCol is (OutRows*OutCols*Samples) x (KernelRows*KernelCols*InChannels), the rows of a sample are contiguous
+	void im2col(const MatrixFloat & mIn, MatrixFloat & mCol) const;
+	void im2col_LUT(const MatrixFloat & mIn, MatrixFloat & mCol) const;
 	void col2im(const MatrixFloat & mCol, MatrixFloat & mIm);
 	void col2im_LUT(const MatrixFloat & mCol, MatrixFloat & mIm);
 
 	bool fastLUT; //temporary
 
 private:
-	void reshape_to_out(MatrixFloat & mOut);
-	void reshape_from_out(MatrixFloat & mOut);
+	// GEMM of the weights with each sample im2col, written in the samples rows of mOut
+	void gemm_to_out(const MatrixFloat& mCol, MatrixFloat& mOut) const;
+
+	void direct_convolution(const MatrixFloat& mIn, MatrixFloat& mOut, MatrixFloat& mPackedWeight) const;
+	void direct_pixel(const float* pfInSample, Index iOutRow, Index iOutCol, float* pfOutSample) const; // on the borders, with the taps out of the image
+
+	// Winograd F(iTile x iTile, 3x3), the transformed input is kept in _im2colT for the backpropagation
+	void winograd_weight(Index iTile, MatrixFloat& mTransformedWeight) const;
+	void winograd_forward(Index iTile, const MatrixFloat& mIn, MatrixFloat& mOut, const MatrixFloat& mTransformedWeight, MatrixFloat& mTransformedIn, MatrixFloat& mProduct) const;
+	void winograd_backpropagation(Index iTile, const MatrixFloat& mGradientOut, MatrixFloat& mGradientIn);
+	MatrixFloat _winogradWeight; // transformed weights of the last forward()
+	MatrixFloat _winogradProduct;
+
+	std::string _sAlgorithm;
+	std::string _sForwardAlgorithm; // algorithm of the last forward(), for the backpropagation
 	
-	// LUT algo
+	// LUT algo: offset in the image of each kernel row, the kernel rows are copied as contiguous runs (strided with a dilation)
+	// the outputs in [_iOutRowBegin, _iOutRowEnd) x [_iOutColBegin, _iOutColEnd) have all their taps in the image, the others are checked
 	void create_im2col_LUT();
+	void kernel_cols_in_image(Index iInCol0, Index& iKColBegin, Index& iKColEnd) const;
 	std::vector<Index> _im2ColLUT;
+	std::vector<Index> _directLUT; // offset in the image of each kernel position
 
 	Index _iInRows;
 	Index _iInCols;
-	Index _iSamples;
+	Index _iSamples; // of the last forward(), for the backpropagation
 	Index _iInChannels;
 	Index _iKernelRows;
 	Index _iKernelCols;
 	Index _iRowStride;
 	Index _iColStride;
 	Index _iOutChannels;
+	Index _iRowPadding;
+	Index _iColPadding;
+	Index _iRowDilation;
+	Index _iColDilation;
 	Index _iBorderRows;
 	Index _iBorderCols;
 	Index _iOutRows;
 	Index _iOutCols;
+	Index _iOutRowBegin;
+	Index _iOutRowEnd;
+	Index _iOutColBegin;
+	Index _iOutColEnd;
 
 public:
 	MatrixFloat _im2colT; // input image, im2col format
-	MatrixFloat _tempImg; // temporary image, to avoid malloc
 };
 }
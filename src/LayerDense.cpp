@@ -54,21 +54,21 @@ void LayerDense::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 {
 	assert(mIn.cols() == _weight.rows());
 	assert(_weight.cols() == _bias.cols());
-	mOut = mIn * _weight;
-    mOut = rowWiseAdd(mOut,_bias);
+	gemm(mIn, false, _weight, false, mOut); // in the mOut buffer, no temporary
+
+	for (Index l = 0; l < mOut.rows(); l++)
+		mOut.row(l) += _bias;
 }
 ///////////////////////////////////////////////////////////////////////////////
 void LayerDense::backpropagation(const MatrixFloat &mIn,const MatrixFloat &mGradientOut, MatrixFloat &mGradientIn)
 {
-	_gradientWeight = mIn.transpose()*mGradientOut;
-
 	// average the gradient as in: https://stats.stackexchange.com/questions/183840/sum-or-average-of-gradients-in-mini-batch-gradient-decent
-	_gradientWeight *= (1.f / mIn.rows());
+	gemm(mIn, true, mGradientOut, false, _gradientWeight, 1.f / mIn.rows());
 
 	_gradientBias = colWiseMean(mGradientOut);
 
 	if (!_bFirstLayer)
-		mGradientIn = mGradientOut * (_weight.transpose());
+		gemm(mGradientOut, false, _weight, true, mGradientIn);
 }
 ///////////////////////////////////////////////////////////////
 Index LayerDense::input_size() const
@@ -58,10 +58,10 @@ void LayerDot::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 void LayerDot::backpropagation(const MatrixFloat &mIn,const MatrixFloat &mGradientOut, MatrixFloat &mGradientIn)
 {
 	// average the gradient as in: https://stats.stackexchange.com/questions/183840/sum-or-average-of-gradients-in-mini-batch-gradient-decent
-	_gradientWeight = (mIn.transpose())*mGradientOut*(1.f / mIn.rows());
+	gemm(mIn, true, mGradientOut, false, _gradientWeight, 1.f / mIn.rows());
 
 	if (!_bFirstLayer)
-		mGradientIn = mGradientOut * (_weight.transpose());
+		gemm(mGradientOut, false, _weight, true, mGradientIn);
 }
 ///////////////////////////////////////////////////////////////
 Index LayerDot::input_size() const
@@ -16,7 +16,9 @@ namespace beednn {
 LayerDropout::LayerDropout(float fRate):
     Layer("Dropout"),
     _fRate(fRate)
-{ }
+{
+	_bInPlace = true;
+}
 ///////////////////////////////////////////////////////////////////////////////
 LayerDropout::~LayerDropout()
 { }
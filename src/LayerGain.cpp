@@ -14,6 +14,8 @@ namespace beednn {
 LayerGain::LayerGain() :
     Layer("Gain")
 {
+	_bInPlace = true;
+	_bGradientWeightSum = true; // mean on the features, not on the samples
     LayerGain::init();
 }
 ///////////////////////////////////////////////////////////////////////////////
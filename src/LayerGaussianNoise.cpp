@@ -16,7 +16,9 @@ LayerGaussianNoise::LayerGaussianNoise(float fNoise):
     Layer("GaussianNoise"),
     _fNoise(fNoise),
 	_distNormal(0.f, fNoise)
-{ }
+{
+	_bInPlace = true;
+}
 ///////////////////////////////////////////////////////////////////////////////
 LayerGaussianNoise::~LayerGaussianNoise()
 { }
@@ -17,6 +17,8 @@ LayerGlobalAffine::LayerGlobalAffine():
 	_gradientWeight.resize(1, 1);
     _bias.resize(1,1);
 	_gradientBias.resize(1, 1);
+	_bInPlace = true;
+	_bGradientWeightSum = true; // mean on the features, not on the samples
 
 	LayerGlobalAffine::init();
 }
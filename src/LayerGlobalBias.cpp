@@ -15,6 +15,7 @@ LayerGlobalBias::LayerGlobalBias() :
 {
     _bias.resize(1,1);
 	_gradientBias.resize(1, 1);
+	_bInPlace = true;
     LayerGlobalBias::init();
 }
 ///////////////////////////////////////////////////////////////////////////////
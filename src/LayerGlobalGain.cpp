@@ -15,6 +15,8 @@ LayerGlobalGain::LayerGlobalGain():
 {
     _weight.resize(1,1);
 	_gradientWeight.resize(1, 1);
+	_bInPlace = true;
+	_bGradientWeightSum = true; // mean on the features, not on the samples
     LayerGlobalGain::init();
 }
 ///////////////////////////////////////////////////////////////////////////////
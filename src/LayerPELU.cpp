@@ -44,15 +44,34 @@ void LayerPELU::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 		_gradientWeight.resizeLike(_weight);
 	}
 
+	forward_weight(mIn, _weight, mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+// the weights are created by the first forward(), the default ones are used before, without writing the layer
+void LayerPELU::predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const
+{
+	if (_weight.size() != 0)
+	{
+		forward_weight(mIn, _weight, mOut);
+		return;
+	}
+
+	vScratch.resize(1);
+	vScratch[0].setConstant(2, mIn.cols(), 1.f);
+	forward_weight(mIn, vScratch[0], mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerPELU::forward_weight(const MatrixFloat& mIn, const MatrixFloat& mWeight, MatrixFloat& mOut) const
+{
     mOut = mIn;
 
 	for (Index i = 0; i < mOut.rows(); i++)
 		for (Index j = 0; j < mOut.cols(); j++)
 		{
 			if (mOut(i,j) > 0.f)
-				mOut(i,j) *= _weight(0,j)/_weight(1,j); //f(h)=h*a/b
+				mOut(i,j) *= mWeight(0,j)/mWeight(1,j); //f(h)=h*a/b
 			else
-				mOut(i,j) = _weight(0,j)*(expm1f(mOut(i,j)/_weight(1,j))); // f(h)=a*(exp(h/b)-1)
+				mOut(i,j) = mWeight(0,j)*(expm1f(mOut(i,j)/mWeight(1,j))); // f(h)=a*(exp(h/b)-1)
 		}
 }
 ///////////////////////////////////////////////////////////////////////////////
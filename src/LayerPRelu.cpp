@@ -43,13 +43,32 @@ void LayerPRelu::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 		_gradientWeight.resizeLike(_weight);
 	}
 
+	forward_weight(mIn, _weight, mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+// the weights are created by the first forward(), the default ones are used before, without writing the layer
+void LayerPRelu::predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const
+{
+	if (_weight.size() != 0)
+	{
+		forward_weight(mIn, _weight, mOut);
+		return;
+	}
+
+	vScratch.resize(1);
+	vScratch[0].setConstant(1, mIn.cols(), 0.25f);
+	forward_weight(mIn, vScratch[0], mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerPRelu::forward_weight(const MatrixFloat& mIn, const MatrixFloat& mWeight, MatrixFloat& mOut) const
+{
     mOut = mIn;
 
 	for (Index i = 0; i < mOut.rows(); i++)
 		for (Index j = 0; j < mOut.cols(); j++)
 		{
 			if (mOut(i,j) < 0.f)
-				mOut(i,j) *= _weight(j);
+				mOut(i,j) *= mWeight(j);
 		}
 }
 ///////////////////////////////////////////////////////////////////////////////
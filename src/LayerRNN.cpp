@@ -33,13 +33,34 @@ void LayerRNN::forward(const MatrixFloat& mIn, MatrixFloat& mOut)
     for (Index iS = 0; iS < mIn.cols() - _iFrameSize; iS += _iFrameSize)
     {
         mFrame = colExtract(mIn, iS , iS + _iFrameSize);
-	    forward_frame(mFrame,mOut);
+	    forward_frame(mFrame,_h,mOut);
 
         if (_bTrainMode)
             _savedH.push_back(_h);
     }
 }
 ///////////////////////////////////////////////////////////////////////////////
+void LayerRNN::predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const
+{
+    assert( (mIn.cols() % _iFrameSize)==0); // all samples are concatened horizontaly
+
+    vScratch.resize(1);
+    MatrixFloat& mH = vScratch[0];
+
+    if ( (mIn.size() != _iFrameSize) || (mH.rows() != mIn.rows()) )
+    {
+        // not on-the-fly prediction, reset state on startup
+        mH.setZero(mIn.rows(), _iUnits);
+    }
+
+    MatrixFloat mFrame;
+    for (Index iS = 0; iS < mIn.cols() - _iFrameSize; iS += _iFrameSize)
+    {
+        mFrame = colExtract(mIn, iS , iS + _iFrameSize);
+        forward_frame(mFrame,mH,mOut);
+    }
+}
+///////////////////////////////////////////////////////////////////////////////
 void LayerRNN::backpropagation(const MatrixFloat& mIn, const MatrixFloat& mGradientOut, MatrixFloat& mGradientIn)
 {
     MatrixFloat mFrame,mGradientOutTemp= mGradientOut,mH,mHm1;
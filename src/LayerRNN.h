@@ -23,9 +23,10 @@ public:
 
     virtual Layer* clone() const override =0;
     virtual void forward(const MatrixFloat& mIn, MatrixFloat& mOut) override;
+    virtual void predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const override; // the state is in the context
     virtual void backpropagation(const MatrixFloat& mIn, const MatrixFloat& mGradientOut, MatrixFloat& mGradientIn) override;
 
-    virtual void forward_frame(const MatrixFloat& mInFrame, MatrixFloat& mOut) =0;
+    virtual void forward_frame(const MatrixFloat& mInFrame, MatrixFloat& mH, MatrixFloat& mOut) const =0; // update the state mH
     virtual void backpropagation_frame(const MatrixFloat& mInFrame, const MatrixFloat& mH, const MatrixFloat& mHm1,const MatrixFloat& mGradientOut, MatrixFloat& mGradientIn) =0;
 
 protected:
@@ -44,7 +44,7 @@ void LayerRandomFlip::get_params(Index & iRows, Index & iCols, Index & iChannels
 void LayerRandomFlip::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 {
 	mOut = mIn;
-	if (_bTrainMode)
+	if (!_bTrainMode)
 		return;
 
 	_flipped.resize(mIn.rows(),1);
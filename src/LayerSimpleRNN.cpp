@@ -40,12 +40,12 @@ Layer* LayerSimpleRNN::clone() const
     return pLayer;
 }
 ///////////////////////////////////////////////////////////////////////////////
-void LayerSimpleRNN::forward_frame(const MatrixFloat& mIn, MatrixFloat& mOut)
+void LayerSimpleRNN::forward_frame(const MatrixFloat& mIn, MatrixFloat& mH, MatrixFloat& mOut) const
 {
-        _h = _h * _whh + mIn * _wxh;
-        rowWiseAdd(_h, _bh);
-        _h = tanh(_h);
-		mOut=_h;
+        mH = mH * _whh + mIn * _wxh;
+        rowWiseAdd(mH, _bh);
+        mH = tanh(mH);
+		mOut=mH;
 }
 ///////////////////////////////////////////////////////////////////////////////
 void LayerSimpleRNN::backpropagation_frame(const MatrixFloat& mInFrame, const MatrixFloat& mH, const MatrixFloat& mHm1, const MatrixFloat& mGradientOut, MatrixFloat& mGradientIn)
@@ -21,7 +21,7 @@ public:
     virtual void init() override;
 
     virtual Layer* clone() const override;
-    virtual void forward_frame(const MatrixFloat& mIn, MatrixFloat& mOut) override;
+    virtual void forward_frame(const MatrixFloat& mIn, MatrixFloat& mH, MatrixFloat& mOut) const override;
 
     virtual void backpropagation_frame(const MatrixFloat& mInFrame, const MatrixFloat& mH, const MatrixFloat& mHm1, const MatrixFloat& mGradientOut, MatrixFloat& mGradientIn) override;
 
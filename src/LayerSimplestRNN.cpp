@@ -13,6 +13,7 @@ namespace beednn {
 LayerSimplestRNN::LayerSimplestRNN(int iFrameSize) :
     LayerRNN(iFrameSize, iFrameSize)
 {
+    _bGradientWeightSum = true; // divided by the number of units, not of samples
     LayerSimplestRNN::init();
 }
 ///////////////////////////////////////////////////////////////////////////////
@@ -35,14 +36,14 @@ Layer* LayerSimplestRNN::clone() const
     return pLayer;
 }
 ///////////////////////////////////////////////////////////////////////////////
-void LayerSimplestRNN::forward_frame(const MatrixFloat& mInFrame, MatrixFloat& mOut)
+void LayerSimplestRNN::forward_frame(const MatrixFloat& mInFrame, MatrixFloat& mH, MatrixFloat& mOut) const
 {
-    if (_h.rows() != mInFrame.rows())  // adapt to batch size
-        _h.setZero(mInFrame.rows(), _iUnits);
+    if (mH.rows() != mInFrame.rows())  // adapt to batch size
+        mH.setZero(mInFrame.rows(), _iUnits);
 
-    MatrixFloat u = _h * _weight + mInFrame;
-    _h = u;// tanh(u);
-	mOut=_h;
+    MatrixFloat u = mH * _weight + mInFrame;
+    mH = u;// tanh(u);
+	mOut=mH;
 }
 ///////////////////////////////////////////////////////////////////////////////
 void LayerSimplestRNN::backpropagation_frame(const MatrixFloat& mInFrame, const MatrixFloat& mH, const MatrixFloat& mHm1, const MatrixFloat& mGradientOut, MatrixFloat& mGradientIn)
@@ -14,7 +14,9 @@ namespace beednn {
 ///////////////////////////////////////////////////////////////////////////////
 LayerSoftmax::LayerSoftmax():
     Layer("Softmax")
-{ }
+{
+	_bInPlace = true;
+}
 ///////////////////////////////////////////////////////////////////////////////
 LayerSoftmax::~LayerSoftmax()
 { }
@@ -26,15 +28,21 @@ Layer* LayerSoftmax::clone() const
 ///////////////////////////////////////////////////////////////////////////////
 void LayerSoftmax::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 {
-	MatrixFloat S;
 	mOut=mIn;
 
-	for (Index r = 0; r < mOut.rows(); r++)// todo simplify and optimize
+	for (Index r = 0; r < mOut.rows(); r++) // in place, no temporary row
 	{
-		S = mOut.row(r); 
-		S.array() -= S.maxCoeff(); //remove max
-		S = S.array().exp();
-		mOut.row(r) =S/ S.sum();
+		float fMax = mOut.row(r).maxCoeff(); //remove max
+		float fSum = 0.f;
+		for (Index c = 0; c < mOut.cols(); c++)
+		{
+			float fExp = expf(mOut(r, c) - fMax);
+			mOut(r, c) = fExp;
+			fSum += fExp;
+		}
+
+		for (Index c = 0; c < mOut.cols(); c++)
+			mOut(r, c) /= fSum;
 	}
 }
 ///////////////////////////////////////////////////////////////////////////////
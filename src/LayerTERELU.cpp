@@ -46,6 +46,25 @@ void LayerTERELU::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 		_gradientWeight.resizeLike(_weight);
 	}
 
+	forward_weight(mIn, _weight, mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+// the weights are created by the first forward(), the default ones are used before, without writing the layer
+void LayerTERELU::predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const
+{
+	if (_weight.size() != 0)
+	{
+		forward_weight(mIn, _weight, mOut);
+		return;
+	}
+
+	vScratch.resize(1);
+	vScratch[0].setConstant(1, mIn.cols(), 1.f);
+	forward_weight(mIn, vScratch[0], mOut);
+}
+///////////////////////////////////////////////////////////////////////////////
+void LayerTERELU::forward_weight(const MatrixFloat& mIn, const MatrixFloat& mWeight, MatrixFloat& mOut) const
+{
     mOut = mIn;
 
 	for (Index i = 0; i < mOut.rows(); i++)
@@ -54,7 +73,7 @@ void LayerTERELU::forward(const MatrixFloat& mIn,MatrixFloat& mOut)
 			if (mIn(i,j) <= 0.f)
 				mOut(i,j) = _alpha*expm1f(mIn(i, j));
 			else if (mIn(i, j)>=_mu)
-				mOut(i, j) = _weight(j) * (_mu- expm1f(_mu-mIn(i, j)));
+				mOut(i, j) = mWeight(j) * (_mu- expm1f(_mu-mIn(i, j)));
 		}
 }
 ///////////////////////////////////////////////////////////////////////////////
@@ -21,9 +21,11 @@ public:
     virtual void init() override;
 	
 	virtual void forward(const MatrixFloat& mIn, MatrixFloat &mOut) override;
+	virtual void predict(const MatrixFloat& mIn, MatrixFloat& mOut, std::vector<MatrixFloat>& vScratch) const override;
 	virtual void backpropagation(const MatrixFloat &mIn,const MatrixFloat &mGradientOut, MatrixFloat &mGradientIn) override;
 
 private:
+	void forward_weight(const MatrixFloat& mIn, const MatrixFloat& mWeight, MatrixFloat& mOut) const;
     float _alpha, _mu;
 };
 }
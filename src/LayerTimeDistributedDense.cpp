@@ -75,12 +75,12 @@ void LayerTimeDistributedDense::backpropagation(const MatrixFloat &mIn,const Mat
 	MatrixFloat mGradientOutR = viewResize(mGradientOut, iNbFrames * mGradientOut.rows(), _iOutFrameSize);
 	MatrixFloat mInR = viewResize(mIn, iNbFrames * mIn.rows(), _iInFrameSize);
 	
-	_gradientWeight = (mInR.transpose()) * mGradientOutR * (1.f / mIn.rows());
+	gemm(mInR, true, mGradientOutR, false, _gradientWeight, 1.f / mIn.rows());
     _gradientBias = colWiseMean(mGradientOutR);
 
 	if (!_bFirstLayer)
 	{
-		mGradientIn = mGradientOutR * (_weight.transpose());
+		gemm(mGradientOutR, false, _weight, true, mGradientIn);
 		mGradientIn.resize(mIn.rows(), iNbFrames * _iInFrameSize);
 	}
 }
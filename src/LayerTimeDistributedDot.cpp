@@ -70,11 +70,11 @@ void LayerTimeDistributedDot::backpropagation(const MatrixFloat &mIn,const Matri
 	MatrixFloat mGradientOutR = viewResize(mGradientOut, iNbFrames * mGradientOut.rows(), _iOutFrameSize);
 	MatrixFloat mInR = viewResize(mIn, iNbFrames * mIn.rows(), _iInFrameSize);
 	
-	_gradientWeight = (mInR.transpose()) * mGradientOutR * (1.f / mIn.rows());
+	gemm(mInR, true, mGradientOutR, false, _gradientWeight, 1.f / mIn.rows());
 
 	if (!_bFirstLayer)
 	{
-		mGradientIn = mGradientOutR * (_weight.transpose());
+		gemm(mGradientOutR, false, _weight, true, mGradientIn);
 		mGradientIn.resize(mIn.rows(), iNbFrames * _iInFrameSize);
 	}
 }
@@ -14,7 +14,9 @@ LayerUniformNoise::LayerUniformNoise(float fNoise):
     Layer("UniformNoise"),
     _fNoise(fNoise),
 	_distUniform(-fNoise, fNoise)
-{ }
+{
+	_bInPlace = true;
+}
 ///////////////////////////////////////////////////////////////////////////////
 LayerUniformNoise::~LayerUniformNoise()
 { }
@@ -7,6 +7,7 @@
 */
 
 #include "MNISTReader.h"
+#include "DataStream.h"
 
 #include <fstream>
 using namespace std;
@@ -41,6 +42,78 @@ bool MNISTReader::load(const string& sName)
 	return true;
 }
 ////////////////////////////////////////////////////////////////////////////////////
+bool MNISTReader::load_mapped(const string& sName, Index iShardSize)
+{
+	const unsigned char* pTrainImages, *pTrainLabels, *pValidationImages, *pValidationLabels;
+	Index iNbTrain, iNbTrainLabels, iNbValidation, iNbValidationLabels, iImageSize, iValidationImageSize, iLabelSize;
+
+	// the streams read in the files mapped before, unmapped by map_idx(): no stream is kept if the load fails
+	delete _pTrainStream;
+	delete _pValidationStream;
+	_pTrainStream = nullptr;
+	_pValidationStream = nullptr;
+
+	if (!map_idx(sName + "/train-images.idx3-ubyte", _trainImages, pTrainImages, iNbTrain, iImageSize))
+		return false;
+
+	if (!map_idx(sName + "/train-labels.idx1-ubyte", _trainLabels, pTrainLabels, iNbTrainLabels, iLabelSize) || (iNbTrainLabels != iNbTrain))
+		return false;
+
+	if (!map_idx(sName + "/t10k-images.idx3-ubyte", _validationImages, pValidationImages, iNbValidation, iValidationImageSize) || (iValidationImageSize != iImageSize))
+		return false;
+
+	if (!map_idx(sName + "/t10k-labels.idx1-ubyte", _validationLabels, pValidationLabels, iNbValidationLabels, iLabelSize) || (iNbValidationLabels != iNbValidation))
+		return false;
+
+	// same normalization as load()
+	ByteDataStream* pTrainStream = new ByteDataStream(iImageSize, 256.f, iShardSize);
+	pTrainStream->add_block(pTrainImages, iImageSize, pTrainLabels, 1, iNbTrain);
+	_pTrainStream = pTrainStream;
+
+	ByteDataStream* pValidationStream = new ByteDataStream(iImageSize, 256.f, iShardSize);
+	pValidationStream->add_block(pValidationImages, iImageSize, pValidationLabels, 1, iNbValidation);
+	_pValidationStream = pValidationStream;
+
+	return true;
+}
+////////////////////////////////////////////////////////////////////////////////////
+// check the header of a mapped byte idx file, pData is after the header
+bool MNISTReader::map_idx(const string& sName, MappedFile& file, const unsigned char*& pData, Index& iNbItems, Index& iItemSize)
+{
+	if (!file.open(sName))
+		return false;
+
+	const unsigned char* pHeader = file.data();
+	if ((file.size() < 4) || (pHeader[0] != 0) || (pHeader[1] != 0) || (pHeader[2] != 0x08))
+		return false; //only byte format for now
+
+	unsigned char ucNbDim = pHeader[3];
+	if ((ucNbDim != 0x01) && (ucNbDim != 0x03))
+		return false;
+
+	size_t iHeaderSize = 4 + 4 * (size_t)ucNbDim;
+	if (file.size() < iHeaderSize)
+		return false;
+
+	// big endian sizes, the items are flattened
+	iItemSize = 1;
+	for (unsigned char i = 0; i < ucNbDim; i++)
+	{
+		const unsigned char* pSize = pHeader + 4 + 4 * i;
+		Index iSize = ((Index)pSize[0] << 24) + ((Index)pSize[1] << 16) + ((Index)pSize[2] << 8) + (Index)pSize[3];
+		if (i == 0)
+			iNbItems = iSize;
+		else
+			iItemSize *= iSize;
+	}
+
+	if (file.size() < iHeaderSize + (size_t)(iNbItems * iItemSize))
+		return false;
+
+	pData = pHeader + iHeaderSize;
+	return true;
+}
+////////////////////////////////////////////////////////////////////////////////////
 bool MNISTReader::read_Matrix(string sName,MatrixFloat& m)
 {
     // file format and data at: http://yann.lecun.com/exdb/mnist/
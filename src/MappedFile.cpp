@@ -0,0 +1,156 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+namespace beednn {
+
+///////////////////////////////////////////////////////////////////////////
+MappedFile::MappedFile()
+{
+	_pData = nullptr;
+	_iSize = 0;
+	_bOpen = false;
+	_bCopyOnWrite = false;
+#ifdef _WIN32
+	_hFile = INVALID_HANDLE_VALUE;
+	_hMapping = nullptr;
+#endif
+}
+///////////////////////////////////////////////////////////////////////////
+MappedFile::~MappedFile()
+{
+	close();
+}
+///////////////////////////////////////////////////////////////////////////
+bool MappedFile::open(const string& sFile, bool bCopyOnWrite)
+{
+	close();
+	_bCopyOnWrite = bCopyOnWrite;
+
+#ifdef _WIN32
+	_hFile = CreateFileA(sFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER iFileSize;
+	if (!GetFileSizeEx(_hFile, &iFileSize))
+	{
+		close();
+		return false;
+	}
+
+	_iSize = (size_t)iFileSize.QuadPart;
+	if (_iSize == 0)
+	{
+		_bOpen = true;
+		return true; // empty file, nothing to map
+	}
+
+	_hMapping = CreateFileMappingA(_hFile, nullptr, bCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+	if (_hMapping == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	_pData = (const unsigned char*)MapViewOfFile(_hMapping, bCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (_pData == nullptr)
+	{
+		close();
+		return false;
+	}
+#else
+	int iFile = ::open(sFile.c_str(), O_RDONLY);
+	if (iFile < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(iFile, &fileStat) != 0)
+	{
+		::close(iFile);
+		return false;
+	}
+
+	_iSize = (size_t)fileStat.st_size;
+	if (_iSize == 0)
+	{
+		::close(iFile);
+		_bOpen = true;
+		return true; // empty file, nothing to map
+	}
+
+	void* pData = mmap(nullptr, _iSize, bCopyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_PRIVATE, iFile, 0);
+	::close(iFile); // the mapping keeps the file
+	if (pData == MAP_FAILED)
+	{
+		_iSize = 0;
+		return false;
+	}
+
+	_pData = (const unsigned char*)pData;
+#endif
+
+	_bOpen = true;
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (_pData)
+		UnmapViewOfFile(_pData);
+	if (_hMapping)
+		CloseHandle(_hMapping);
+	if (_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(_hFile);
+	_hMapping = nullptr;
+	_hFile = INVALID_HANDLE_VALUE;
+#else
+	if (_pData)
+		munmap((void*)_pData, _iSize);
+#endif
+
+	_pData = nullptr;
+	_iSize = 0;
+	_bOpen = false;
+	_bCopyOnWrite = false;
+}
+///////////////////////////////////////////////////////////////////////////
+bool MappedFile::is_open() const
+{
+	return _bOpen;
+}
+///////////////////////////////////////////////////////////////////////////
+const unsigned char* MappedFile::data() const
+{
+	return _pData;
+}
+///////////////////////////////////////////////////////////////////////////
+unsigned char* MappedFile::writable_data()
+{
+	return _bCopyOnWrite ? (unsigned char*)_pData : nullptr;
+}
+///////////////////////////////////////////////////////////////////////////
+size_t MappedFile::size() const
+{
+	return _iSize;
+}
+///////////////////////////////////////////////////////////////////////////
+}
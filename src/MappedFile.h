@@ -0,0 +1,47 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace beednn {
+
+// read only memory mapped file: open() is immediate whatever the file size, the pages are read by the system on first access
+// and are shared with the file cache, they do not count in the process memory and are dropped first if the memory is low
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// with bCopyOnWrite, the data can be written: a written page is copied in the process memory, the file is not modified
+	bool open(const std::string& sFile, bool bCopyOnWrite = false);
+	void close();
+
+	bool is_open() const;
+	const unsigned char* data() const;
+	unsigned char* writable_data(); // nullptr if not opened with bCopyOnWrite
+	size_t size() const; // in bytes
+
+private:
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const unsigned char* _pData;
+	size_t _iSize;
+	bool _bOpen;
+	bool _bCopyOnWrite;
+#ifdef _WIN32
+	void* _hFile;
+	void* _hMapping;
+#endif
+};
+
+}
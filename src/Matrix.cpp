@@ -14,8 +14,12 @@
 #include <random>
 #include <vector>
 #include <iomanip>
+#include <charconv>
+#include <system_error>
 
 #include "Matrix.h"
+#include "ThreadPool.h"
+#include "MappedFile.h"
 
 using namespace std;
 namespace beednn {
@@ -46,6 +50,15 @@ MatrixFloatView fromRawBuffer(float *pBuffer,Index iRows,Index iCols)
 #endif
 }
 ///////////////////////////////////////////////////////////////////////////
+void setView(MatrixFloat& m, const float* pBuffer, Index iRows, Index iCols)
+{
+#ifdef USE_EIGEN
+	m = Eigen::Map<const MatrixFloat>(pBuffer, iRows, iCols);
+#else
+	m.set_view((float*)pBuffer, iRows, iCols);
+#endif
+}
+///////////////////////////////////////////////////////////////////////////
 MatrixFloatView createView(MatrixFloat & mRef)
 {
 	return fromRawBuffer(mRef.data(), mRef.rows(), mRef.cols());
@@ -285,18 +298,27 @@ void applyRowPermutation(const vector<Index>& vPermutation, const MatrixFloat &
 {
     assert((Index)vPermutation.size() == mIn.rows());
 
-    mPermuted.resizeLike(mIn);
+	gatherRows(vPermutation, 0, (Index)vPermutation.size(), mIn, mPermuted);
+}
+///////////////////////////////////////////////////////////////////////////
+void gatherRows(const vector<Index>& vIndex, Index iStart, Index iEnd, const MatrixFloat& mIn, MatrixFloat& mOut)
+{
+	assert(iStart >= 0);
+	assert(iEnd <= (Index)vIndex.size());
+	assert(&mIn != &mOut);
 
 	Index iCols = mIn.cols();
-	for (Index i = 0; i < (Index)(vPermutation.size()); i++)
+	mOut.resize(iEnd - iStart, iCols);
+
+	for (Index i = iStart; i < iEnd; i++)
 	{
-		Index iPerm= vPermutation[i];
+		Index iRow = vIndex[i];
 
-		assert(iPerm >=0);
-		assert(iPerm < mIn.rows());
+		assert(iRow >= 0);
+		assert(iRow < mIn.rows());
 
-		//mPermuted.row(i) = mIn.row(iPerm);
-		std::memcpy(mPermuted.data() + iCols * i, mIn.data() + iCols * iPerm, iCols * sizeof(float));
+		//mOut.row(i - iStart) = mIn.row(iRow);
+		std::memcpy(mOut.data() + iCols * (i - iStart), mIn.data() + iCols * iRow, iCols * sizeof(float));
 	}
 }
 ///////////////////////////////////////////////////////////////////////////
@@ -368,39 +390,179 @@ string toString(const MatrixFloat& m)
     return ss.str();
 }
 ///////////////////////////////////////////////////////////////////////////
-const MatrixFloat fromFile(const string& sFile)
-{    
-    vector<float> vf;
-    std::fstream f(sFile,std::ios::in);
-    Index iNbLine=0;
-    while(!f.eof() && (!f.bad()) && (!f.fail()) )
-    {
-        string s;
-        getline(f,s);
+// the separators are the spaces, tabs and commas, a line with only separators is empty
+static inline bool is_csv_separator(char c)
+{
+	return (c == ' ') || (c == ',') || (c == '\t') || (c == '\r') || (c == ';');
+}
+///////////////////////////////////////////////////////////////////////////
+// parse a float at p, return the end of the number or nullptr if p is not a number
+static const char* parse_float(const char* p, const char* pEnd, float& f)
+{
+	if ((p < pEnd) && (*p == '+'))
+		p++;
 
-        if(s.empty())
-            continue;
+#ifdef __cpp_lib_to_chars
+	from_chars_result result = from_chars(p, pEnd, f);
+	if (result.ec == errc())
+		return result.ptr;
+	if (result.ec != errc::result_out_of_range)
+		return nullptr;
+#endif
 
-        std::replace( s.begin(), s.end(), ',', ' '); //replace ',' by spaces if present
+	// denormals, overflow or no from_chars for float: strtof on a zero terminated copy
+	char buffer[64];
+	size_t iSize = 0;
+	while ((p + iSize < pEnd) && (iSize < sizeof(buffer) - 1) && !is_csv_separator(p[iSize]) && (p[iSize] != '\n'))
+	{
+		buffer[iSize] = p[iSize];
+		iSize++;
+	}
+	buffer[iSize] = 0;
 
-        iNbLine++;
+	char* pParsed;
+	f = strtof(buffer, &pParsed);
+	if (pParsed == buffer)
+		return nullptr;
 
-        std::stringstream ss;
-        ss.str(s);
-        while(!ss.eof())
-        {
-            float sF;
-            ss >> sF;
-            vf.push_back(sF);
-        }
-    }
+	return p + (pParsed - buffer);
+}
+///////////////////////////////////////////////////////////////////////////
+// parse the numbers of a line in pRow, if not nullptr, return the number of values or -1 if not a number
+static Index parse_line(const char* p, const char* pEnd, float* pRow, Index iMaxValues)
+{
+	Index iNbValues = 0;
+	for (;;)
+	{
+		while ((p < pEnd) && is_csv_separator(*p))
+			p++;
+		if (p == pEnd)
+			return iNbValues;
+
+		float f;
+		p = parse_float(p, pEnd, f);
+		if ((p == nullptr) || ((p < pEnd) && !is_csv_separator(*p)))
+			return -1; // not a number, or garbage after the number
+
+		if (pRow)
+		{
+			if (iNbValues == iMaxValues)
+				return -1;
+			pRow[iNbValues] = f;
+		}
+		iNbValues++;
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+static bool is_empty_line(const char* p, const char* pEnd)
+{
+	while ((p < pEnd) && is_csv_separator(*p))
+		p++;
 
-    if(iNbLine==0)
-        return MatrixFloat();
+	return p == pEnd;
+}
+///////////////////////////////////////////////////////////////////////////
+static const char* line_end(const char* p, const char* pEnd)
+{
+	const char* pLineEnd = (const char*)memchr(p, '\n', (size_t)(pEnd - p));
+	return pLineEnd ? pLineEnd : pEnd;
+}
+///////////////////////////////////////////////////////////////////////////
+static const char* next_line(const char* pLineEnd, const char* pEnd)
+{
+	return pLineEnd < pEnd ? pLineEnd + 1 : pEnd;
+}
+///////////////////////////////////////////////////////////////////////////
+// the file is mapped and cut in chunks at the line ends, the chunks are parsed in the threads of set_nb_threads()
+// a first pass counts the lines of each chunk, then each chunk parses its lines directly in its rows of the matrix
+bool fromFile(const string& sFile, MatrixFloat& m)
+{
+	m.resize(0, 0);
 
-    MatrixFloat r(iNbLine,(Index)vf.size()/iNbLine); // todo check size
-    std::copy(vf.begin(),vf.end(),r.data());
-    return r;
+	MappedFile file;
+	if (!file.open(sFile))
+		return false;
+
+	const char* pData = (const char*)file.data();
+	const char* pDataEnd = pData + file.size();
+
+	// the first non empty line gives the number of columns
+	const char* pFirst = pData;
+	while ((pFirst < pDataEnd) && is_empty_line(pFirst, line_end(pFirst, pDataEnd)))
+		pFirst = next_line(line_end(pFirst, pDataEnd), pDataEnd);
+	if (pFirst >= pDataEnd)
+		return true; // no data
+
+	Index iNbCols = parse_line(pFirst, line_end(pFirst, pDataEnd), nullptr, 0);
+	if (iNbCols <= 0)
+		return false;
+
+	// chunks of at least 64 kB, starting on a line start
+	Index iSize = (Index)(pDataEnd - pFirst);
+	Index iNbChunks = min<Index>(get_nb_threads() * 4, iSize / 65536 + 1);
+	vector<const char*> vChunkStart(iNbChunks + 1);
+	for (Index i = 0; i < iNbChunks; i++)
+	{
+		const char* pStart = pFirst + i * iSize / iNbChunks;
+		if (i > 0)
+			pStart = next_line(line_end(pStart - 1, pDataEnd), pDataEnd);
+		vChunkStart[i] = pStart;
+	}
+	vChunkStart[iNbChunks] = pDataEnd;
+
+	vector<Index> vChunkRows(iNbChunks + 1, 0);
+	parallel_for(iNbChunks, [&](ptrdiff_t i)
+	{
+		Index iNbRows = 0;
+		for (const char* p = vChunkStart[i]; p < vChunkStart[i + 1]; )
+		{
+			const char* pEnd = line_end(p, vChunkStart[i + 1]);
+			iNbRows += !is_empty_line(p, pEnd);
+			p = next_line(pEnd, vChunkStart[i + 1]);
+		}
+		vChunkRows[i + 1] = iNbRows;
+	});
+
+	// first row of each chunk
+	for (Index i = 0; i < iNbChunks; i++)
+		vChunkRows[i + 1] += vChunkRows[i];
+
+	MatrixFloat r(vChunkRows[iNbChunks], iNbCols);
+	vector<char> vChunkOk(iNbChunks, 1);
+	parallel_for(iNbChunks, [&](ptrdiff_t i)
+	{
+		Index iRow = vChunkRows[i];
+		for (const char* p = vChunkStart[i]; p < vChunkStart[i + 1]; )
+		{
+			const char* pEnd = line_end(p, vChunkStart[i + 1]);
+			if (!is_empty_line(p, pEnd))
+			{
+				if (parse_line(p, pEnd, rowPtr(r, iRow), iNbCols) != iNbCols)
+				{
+					vChunkOk[i] = 0; // not a number or not the same number of columns
+					return;
+				}
+				iRow++;
+			}
+			p = next_line(pEnd, vChunkStart[i + 1]);
+		}
+	});
+
+	for (Index i = 0; i < iNbChunks; i++)
+		if (!vChunkOk[i])
+			return false;
+
+	m = std::move(r);
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+const MatrixFloat fromFile(const string& sFile)
+{
+	MatrixFloat r;
+	if (!fromFile(sFile, r))
+		r.resize(0, 0);
+
+	return r;
 }
 ///////////////////////////////////////////////////////////////////////////
 const MatrixFloat fromString(const string& s)
@@ -459,12 +621,23 @@ const MatrixFloat colExtract(const MatrixFloat& m, Index iStartCol, Index iEndCo
 	return mr;
 }
 ///////////////////////////////////////////////////////////////////////////
+static thread_local std::default_random_engine* t_pRandomEngine = nullptr;
 std::default_random_engine& randomEngine()
 {
+	if (t_pRandomEngine)
+		return *t_pRandomEngine;
+
 	static std::default_random_engine rng;
 	return rng;
 }
 ///////////////////////////////////////////////////////////////////////////
+std::default_random_engine* setRandomEngine(std::default_random_engine* pEngine)
+{
+	std::default_random_engine* pPrevious = t_pRandomEngine;
+	t_pRandomEngine = pEngine;
+	return pPrevious;
+}
+///////////////////////////////////////////////////////////////////////////
 void setRandomUniform(MatrixFloat& m, float fMin, float fMax)
 {
 	std::uniform_real_distribution<float> dis(fMin, fMax);
@@ -566,4 +739,246 @@ void reverseData(float* pData, Index iSize)
 		*pData++ = *pDataEnd--;
 }
 ///////////////////////////////////////////////////////////////////////////
+#ifdef USE_EIGEN
+template <class TA, class TB>
+static void gemm_eigen(const TA& a, const TB& b, MatrixFloat& mC, float fAlpha, float fBeta)
+{
+	if (fBeta == 0.f)
+		mC.noalias() = fAlpha * (a * b);
+	else
+	{
+		mC *= fBeta;
+		mC.noalias() += fAlpha * (a * b);
+	}
+}
+#endif
+///////////////////////////////////////////////////////////////////////////
+void gemm(const MatrixFloat& mA, bool bTransposeA, const MatrixFloat& mB, bool bTransposeB, MatrixFloat& mC, float fAlpha, float fBeta)
+{
+	assert(mA.data() != mC.data());
+	assert(mB.data() != mC.data());
+
+	Index iM = bTransposeA ? mA.cols() : mA.rows();
+	Index iK = bTransposeA ? mA.rows() : mA.cols();
+	Index iN = bTransposeB ? mB.rows() : mB.cols();
+	assert(iK == (bTransposeB ? mB.cols() : mB.rows()));
+
+	if (fBeta == 0.f)
+		mC.resize(iM, iN);
+
+	assert(mC.rows() == iM);
+	assert(mC.cols() == iN);
+
+#ifdef USE_EIGEN
+	if (bTransposeA && bTransposeB)
+		gemm_eigen(mA.transpose(), mB.transpose(), mC, fAlpha, fBeta);
+	else if (bTransposeA)
+		gemm_eigen(mA.transpose(), mB, mC, fAlpha, fBeta);
+	else if (bTransposeB)
+		gemm_eigen(mA, mB.transpose(), mC, fAlpha, fBeta);
+	else
+		gemm_eigen(mA, mB, mC, fAlpha, fBeta);
+#else
+	// a transposed operand is only a swap of its strides
+	gemm_packed(iM, iN, iK, fAlpha,
+		mA.data(), bTransposeA ? 1 : mA.cols(), bTransposeA ? mA.cols() : 1,
+		mB.data(), bTransposeB ? 1 : mB.cols(), bTransposeB ? mB.cols() : 1,
+		fBeta, mC.data(), iN);
+#endif
+}
+///////////////////////////////////////////////////////////////////////////
+// packed GEMM, loop order and panel names from the BLIS papers:
+// C is cut in NC columns panels, the shared dimension in KC panels and A in MC rows panels,
+// A and B panels are packed so the micro kernel reads them contiguously, and a MRxNR C tile stays in registers
+#define GEMM_MR 6 // micro tile rows
+#define GEMM_NR 8 // micro tile columns
+#define GEMM_MC 120 // A panel rows, the MCxKC packed A panel fits in L2 cache
+#define GEMM_KC 256 // shared dimension panel, a KCxNR packed B micro panel fits in L1 cache
+#define GEMM_NC 2048 // B panel columns, the KCxNC packed B panel fits in L3 cache
+#define GEMM_SMALL_MAC (32*32*32) // under this number of MAC, packing costs more than it saves
+#define GEMM_PARALLEL_MAC (128*128*128) // under this number of MAC, waking up the workers costs more than it saves
+///////////////////////////////////////////////////////////////////////////
+static void gemm_small(Index iM, Index iN, Index iK, float fAlpha,
+	const float* pA, Index iRowStrideA, Index iColStrideA,
+	const float* pB, Index iRowStrideB, Index iColStrideB,
+	float fBeta, float* pC, Index iLdC)
+{
+	// RKC algorithm
+	for (Index r = 0; r < iM; r++)
+	{
+		float* pCRow = pC + r * iLdC;
+		for (Index c = 0; c < iN; c++)
+			pCRow[c] = (fBeta == 0.f) ? 0.f : pCRow[c] * fBeta;
+
+		for (Index k = 0; k < iK; k++)
+		{
+			float fA = fAlpha * pA[r * iRowStrideA + k * iColStrideA];
+			const float* pBRow = pB + k * iRowStrideB;
+			for (Index c = 0; c < iN; c++)
+				pCRow[c] += fA * pBRow[c * iColStrideB];
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+// pack a iMc x iKc block of A as MR rows micro panels, column by column, scaled by fAlpha, zero padded
+static void gemm_pack_A(Index iMc, Index iKc, float fAlpha, const float* pA, Index iRowStrideA, Index iColStrideA, float* pPacked)
+{
+	for (Index ir = 0; ir < iMc; ir += GEMM_MR)
+	{
+		Index iMr = std::min<Index>(GEMM_MR, iMc - ir);
+		const float* pPanel = pA + ir * iRowStrideA;
+
+		for (Index k = 0; k < iKc; k++)
+		{
+			const float* pCol = pPanel + k * iColStrideA;
+			Index i = 0;
+			for (; i < iMr; i++)
+				*pPacked++ = fAlpha * pCol[i * iRowStrideA];
+			for (; i < GEMM_MR; i++)
+				*pPacked++ = 0.f;
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+// pack a iKc x iNc block of B as NR columns micro panels, row by row, zero padded
+static void gemm_pack_B(Index iKc, Index iNc, const float* pB, Index iRowStrideB, Index iColStrideB, float* pPacked)
+{
+	for (Index jr = 0; jr < iNc; jr += GEMM_NR)
+	{
+		Index iNr = std::min<Index>(GEMM_NR, iNc - jr);
+		const float* pPanel = pB + jr * iColStrideB;
+
+		for (Index k = 0; k < iKc; k++)
+		{
+			const float* pRow = pPanel + k * iRowStrideB;
+			Index j = 0;
+			for (; j < iNr; j++)
+				*pPacked++ = pRow[j * iColStrideB];
+			for (; j < GEMM_NR; j++)
+				*pPacked++ = 0.f;
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+// C tile = packed A micro panel * packed B micro panel + fBeta * C tile, only the iMr x iNr top left part is written
+static void gemm_micro_kernel(Index iKc, const float* pA, const float* pB, float fBeta, float* pC, Index iLdC, Index iMr, Index iNr)
+{
+	float ab[GEMM_MR * GEMM_NR] = { 0.f };
+
+	// fixed size loops, the compiler keeps ab in registers and vectorizes the inner loop
+	for (Index k = 0; k < iKc; k++)
+	{
+		for (Index i = 0; i < GEMM_MR; i++)
+		{
+			float fA = pA[i];
+			for (Index j = 0; j < GEMM_NR; j++)
+				ab[i * GEMM_NR + j] += fA * pB[j];
+		}
+
+		pA += GEMM_MR;
+		pB += GEMM_NR;
+	}
+
+	for (Index i = 0; i < iMr; i++)
+	{
+		float* pCRow = pC + i * iLdC;
+		const float* pAB = ab + i * GEMM_NR;
+
+		if (fBeta == 0.f)
+		{
+			for (Index j = 0; j < iNr; j++)
+				pCRow[j] = pAB[j];
+		}
+		else if (fBeta == 1.f)
+		{
+			for (Index j = 0; j < iNr; j++)
+				pCRow[j] += pAB[j];
+		}
+		else
+		{
+			for (Index j = 0; j < iNr; j++)
+				pCRow[j] = pAB[j] + fBeta * pCRow[j];
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+void gemm_packed(Index iM, Index iN, Index iK, float fAlpha,
+	const float* pA, Index iRowStrideA, Index iColStrideA,
+	const float* pB, Index iRowStrideB, Index iColStrideB,
+	float fBeta, float* pC, Index iLdC)
+{
+	if ((iM == 0) || (iN == 0))
+		return;
+
+	if ((iK == 0) || (fAlpha == 0.f))
+	{
+		for (Index r = 0; r < iM; r++)
+			for (Index c = 0; c < iN; c++)
+				pC[r * iLdC + c] = (fBeta == 0.f) ? 0.f : pC[r * iLdC + c] * fBeta;
+		return;
+	}
+
+	if (iM * iN * iK <= GEMM_SMALL_MAC)
+	{
+		gemm_small(iM, iN, iK, fAlpha, pA, iRowStrideA, iColStrideA, pB, iRowStrideB, iColStrideB, fBeta, pC, iLdC);
+		return;
+	}
+
+	// B packing buffer is kept from call to call, to avoid malloc
+	thread_local vector<float> vPackedB;
+	vPackedB.resize(GEMM_KC * (GEMM_NC + GEMM_NR));
+	float* pPackedB = vPackedB.data();
+
+	// split the work by MC rows panels of A, and by NR columns chunks of the B panel if not enough rows panels for all threads
+	Index iNbThreads = (iM * iN * iK >= GEMM_PARALLEL_MAC) ? get_nb_threads() : 1;
+	Index iNbRowBlocks = (iM + GEMM_MC - 1) / GEMM_MC;
+
+	for (Index jc = 0; jc < iN; jc += GEMM_NC)
+	{
+		Index iNc = std::min<Index>(GEMM_NC, iN - jc);
+		Index iNbMicroPanels = (iNc + GEMM_NR - 1) / GEMM_NR;
+		Index iNbColBlocks = 1;
+		if (iNbRowBlocks < iNbThreads)
+			iNbColBlocks = std::min<Index>((iNbThreads + iNbRowBlocks - 1) / iNbRowBlocks, iNbMicroPanels);
+		Index iColBlockSize = ((iNbMicroPanels + iNbColBlocks - 1) / iNbColBlocks) * GEMM_NR;
+
+		for (Index pc = 0; pc < iK; pc += GEMM_KC)
+		{
+			Index iKc = std::min<Index>(GEMM_KC, iK - pc);
+			float fBetaPanel = (pc == 0) ? fBeta : 1.f; // next KC panels accumulate in C
+
+			gemm_pack_B(iKc, iNc, pB + pc * iRowStrideB + jc * iColStrideB, iRowStrideB, iColStrideB, pPackedB);
+
+			// each task writes its own C block, so the result does not depend on the number of threads
+			parallel_for(iNbRowBlocks * iNbColBlocks, [&](Index iTask)
+			{
+				Index ic = (iTask / iNbColBlocks) * GEMM_MC;
+				Index iMc = std::min<Index>(GEMM_MC, iM - ic);
+				Index iColStart = (iTask % iNbColBlocks) * iColBlockSize;
+				Index iColEnd = std::min<Index>(iColStart + iColBlockSize, iNc);
+
+				// A packing buffer is owned by the running thread
+				thread_local vector<float> vPackedA;
+				vPackedA.resize(GEMM_MC * GEMM_KC);
+				float* pPackedA = vPackedA.data();
+
+				gemm_pack_A(iMc, iKc, fAlpha, pA + ic * iRowStrideA + pc * iColStrideA, iRowStrideA, iColStrideA, pPackedA);
+
+				for (Index jr = iColStart; jr < iColEnd; jr += GEMM_NR)
+				{
+					Index iNr = std::min<Index>(GEMM_NR, iNc - jr);
+
+					for (Index ir = 0; ir < iMc; ir += GEMM_MR)
+					{
+						Index iMr = std::min<Index>(GEMM_MR, iMc - ir);
+
+						gemm_micro_kernel(iKc, pPackedA + ir * iKc, pPackedB + jr * iKc, fBetaPanel,
+							pC + (ic + ir) * iLdC + jc + jr, iLdC, iMr, iNr);
+					}
+				}
+			});
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////
 }
\ No newline at end of file
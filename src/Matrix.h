@@ -15,6 +15,9 @@
 #include <cmath>
 #include <random>
 
+#include "MatrixAllocator.h"
+#include "SimdKernels.h"
+
 #ifdef USE_EIGEN
     #define EIGEN_DONT_PARALLELIZE // keep the cpu core for upper algorithms
     #include <Eigen/Core>
@@ -27,28 +30,262 @@ namespace beednn {
     using MatrixFloat=Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
     using MatrixFloatView=Eigen::Map<MatrixFloat>;
 #else
+    using Index=std::ptrdiff_t;
+#endif
+
+// packed and cache blocked GEMM on strided buffers: C = fAlpha * A * B + fBeta * C
+// A(r,k) is pA[r*iRowStrideA + k*iColStrideA], same for B, C is row major with iLdC floats per row
+void gemm_packed(Index iM, Index iN, Index iK, float fAlpha,
+	const float* pA, Index iRowStrideA, Index iColStrideA,
+	const float* pB, Index iRowStrideB, Index iColStrideB,
+	float fBeta, float* pC, Index iLdC);
+
+#ifndef USE_EIGEN
+template <class T> class Matrix;
+template <class Op, class Arg> class ExprUnary;
+template <class Op, class Arg> class ExprScalar;
+template <class Op, class Lhs, class Rhs> class ExprBinary;
+
+#define MATRIX_EXPR_BLOCK 256 // elements computed at once by an expression, the blocks of the operands stay in L1 cache
+
+// element-wise operations on blocks of floats, the output can be an input
+struct OpAdd { static void apply(const float* pA, const float* pB, float* pOut, Index iSize) { simd_add(pA, pB, pOut, iSize); } };
+struct OpSub { static void apply(const float* pA, const float* pB, float* pOut, Index iSize) { simd_sub(pA, pB, pOut, iSize); } };
+struct OpMul { static void apply(const float* pA, const float* pB, float* pOut, Index iSize) { simd_mul(pA, pB, pOut, iSize); } };
+struct OpDiv { static void apply(const float* pA, const float* pB, float* pOut, Index iSize) { simd_div(pA, pB, pOut, iSize); } };
+struct OpMax { static void apply(const float* pA, const float* pB, float* pOut, Index iSize) { simd_max(pA, pB, pOut, iSize); } };
+struct OpMin { static void apply(const float* pA, const float* pB, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = std::min<float>(pA[i], pB[i]); } };
+
+struct OpAddScalar { static void apply(const float* pA, float f, float* pOut, Index iSize) { simd_add(pA, f, pOut, iSize); } };
+struct OpMulScalar { static void apply(const float* pA, float f, float* pOut, Index iSize) { simd_mul(pA, f, pOut, iSize); } };
+struct OpDivScalar { static void apply(const float* pA, float f, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = pA[i] / f; } };
+struct OpMaxScalar { static void apply(const float* pA, float f, float* pOut, Index iSize) { simd_max(pA, f, pOut, iSize); } };
+struct OpMinScalar { static void apply(const float* pA, float f, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = std::min<float>(pA[i], f); } };
+
+struct OpNeg { static void apply(const float* pA, float* pOut, Index iSize) { simd_mul(pA, -1.f, pOut, iSize); } };
+struct OpAbs { static void apply(const float* pA, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = std::abs(pA[i]); } };
+struct OpSign { static void apply(const float* pA, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = std::copysign(1.f, pA[i]); } };
+struct OpSquare { static void apply(const float* pA, float* pOut, Index iSize) { simd_mul(pA, pA, pOut, iSize); } };
+struct OpCube { static void apply(const float* pA, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = pA[i] * pA[i] * pA[i]; } };
+struct OpSqrt { static void apply(const float* pA, float* pOut, Index iSize) { simd_sqrt(pA, pOut, iSize); } };
+struct OpExp { static void apply(const float* pA, float* pOut, Index iSize) { simd_exp(pA, pOut, iSize); } };
+struct OpTanh { static void apply(const float* pA, float* pOut, Index iSize) { simd_tanh(pA, pOut, iSize); } };
+struct OpLog { static void apply(const float* pA, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = std::log(pA[i]); } };
+struct OpRound { static void apply(const float* pA, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = std::round(pA[i]); } };
+struct OpCosh { static void apply(const float* pA, float* pOut, Index iSize) { for (Index i = 0; i < iSize; i++) pOut[i] = std::cosh(pA[i]); } };
+
+// a matrix operand is held by reference, an expression operand by value
+template <class E> struct ExprNested { typedef const E type; };
+template <class T> struct ExprNested<Matrix<T> > { typedef const Matrix<T>& type; };
+
+// lazy element-wise expression, as Eigen array expressions: a chain as (a*b+c).cwiseSqrt() is computed in one pass, block by block, without full size temporaries
+// the operands are held by reference: assign an expression in the same statement, never keep it in an auto variable
+template <class Derived>
+class MatrixExpr
+{
+public:
+	const Derived& derived() const { return static_cast<const Derived&>(*this); }
+
+	Index rows() const { return derived().rows(); }
+	Index cols() const { return derived().cols(); }
+	Index size() const { return derived().size(); }
+
+	float operator()(Index i) const
+	{
+		float f;
+		return *derived().block(i, 1, &f);
+	}
+
+	const Derived& array() const //for eigen compatibility
+	{
+		return derived();
+	}
+
+	Matrix<float> eval() const;
+
+	template <class Other> ExprBinary<OpMul, Derived, Other> cwiseProduct(const MatrixExpr<Other>& m) const { return ExprBinary<OpMul, Derived, Other>(derived(), m.derived()); }
+	template <class Other> ExprBinary<OpDiv, Derived, Other> cwiseQuotient(const MatrixExpr<Other>& m) const { return ExprBinary<OpDiv, Derived, Other>(derived(), m.derived()); }
+	template <class Other> ExprBinary<OpMax, Derived, Other> cwiseMax(const MatrixExpr<Other>& m) const { return ExprBinary<OpMax, Derived, Other>(derived(), m.derived()); }
+	template <class Other> ExprBinary<OpMin, Derived, Other> cwiseMin(const MatrixExpr<Other>& m) const { return ExprBinary<OpMin, Derived, Other>(derived(), m.derived()); }
+	ExprScalar<OpMaxScalar, Derived> cwiseMax(float f) const { return ExprScalar<OpMaxScalar, Derived>(derived(), f); }
+	ExprScalar<OpMinScalar, Derived> cwiseMin(float f) const { return ExprScalar<OpMinScalar, Derived>(derived(), f); }
+
+	ExprUnary<OpAbs, Derived> cwiseAbs() const { return ExprUnary<OpAbs, Derived>(derived()); }
+	ExprUnary<OpSign, Derived> cwiseSign() const { return ExprUnary<OpSign, Derived>(derived()); }
+	ExprUnary<OpSquare, Derived> cwiseAbs2() const { return ExprUnary<OpSquare, Derived>(derived()); }
+	ExprUnary<OpSquare, Derived> square() const { return ExprUnary<OpSquare, Derived>(derived()); }
+	ExprUnary<OpCube, Derived> cube() const { return ExprUnary<OpCube, Derived>(derived()); }
+	ExprUnary<OpSqrt, Derived> cwiseSqrt() const { return ExprUnary<OpSqrt, Derived>(derived()); }
+	ExprUnary<OpExp, Derived> exp() const { return ExprUnary<OpExp, Derived>(derived()); } // applies on array only
+	ExprUnary<OpTanh, Derived> tanh() const { return ExprUnary<OpTanh, Derived>(derived()); } // applies on array only
+	ExprUnary<OpLog, Derived> log() const { return ExprUnary<OpLog, Derived>(derived()); } // applies on array only
+	ExprUnary<OpRound, Derived> round() const { return ExprUnary<OpRound, Derived>(derived()); } // applies on array only
+	ExprUnary<OpCosh, Derived> cosh() const { return ExprUnary<OpCosh, Derived>(derived()); } // applies on array only
+
+	// reductions, block by block
+	float sum() const
+	{
+		float scratch[MATRIX_EXPR_BLOCK];
+		float fSum = 0.f;
+		for (Index i = 0; i < size(); i += MATRIX_EXPR_BLOCK)
+		{
+			Index iBlockSize = std::min<Index>(MATRIX_EXPR_BLOCK, size() - i);
+			fSum += simd_sum(derived().block(i, iBlockSize, scratch), iBlockSize);
+		}
+		return fSum;
+	}
+
+	float squaredNorm() const
+	{
+		float scratch[MATRIX_EXPR_BLOCK];
+		float fSumSq = 0.f;
+		for (Index i = 0; i < size(); i += MATRIX_EXPR_BLOCK)
+		{
+			Index iBlockSize = std::min<Index>(MATRIX_EXPR_BLOCK, size() - i);
+			fSumSq += simd_squared_norm(derived().block(i, iBlockSize, scratch), iBlockSize);
+		}
+		return fSumSq;
+	}
+
+	float norm() const
+	{
+		return ::sqrtf(squaredNorm());
+	}
+
+	float mean() const
+	{
+		return sum() / (float)size();
+	}
+
+	float maxCoeff() const
+	{
+		if (size() == 0)
+			return 0.; //not clean
+
+		float scratch[MATRIX_EXPR_BLOCK];
+		float fMax = operator()(0);
+		for (Index i = 0; i < size(); i += MATRIX_EXPR_BLOCK)
+		{
+			Index iBlockSize = std::min<Index>(MATRIX_EXPR_BLOCK, size() - i);
+			const float* pBlock = derived().block(i, iBlockSize, scratch);
+			for (Index j = 0; j < iBlockSize; j++)
+				if (pBlock[j] > fMax)
+					fMax = pBlock[j];
+		}
+		return fMax;
+	}
+
+	Matrix<float> transpose() const; // slow function!
+};
+
+template <class Op, class Arg>
+class ExprUnary : public MatrixExpr<ExprUnary<Op, Arg> >
+{
+public:
+	explicit ExprUnary(const Arg& a) : _a(a) { }
+
+	Index rows() const { return _a.rows(); }
+	Index cols() const { return _a.cols(); }
+	Index size() const { return _a.size(); }
+
+	// compute the block iStart to iStart+iSize, in pScratch or not, return its address
+	const float* block(Index iStart, Index iSize, float* pScratch) const
+	{
+		Op::apply(_a.block(iStart, iSize, pScratch), pScratch, iSize);
+		return pScratch;
+	}
+
+	bool overlaps(const float* pBegin, const float* pEnd) const { return _a.overlaps(pBegin, pEnd); }
+
+private:
+	typename ExprNested<Arg>::type _a;
+};
+
+template <class Op, class Arg>
+class ExprScalar : public MatrixExpr<ExprScalar<Op, Arg> >
+{
+public:
+	ExprScalar(const Arg& a, float f) : _a(a), _f(f) { }
+
+	Index rows() const { return _a.rows(); }
+	Index cols() const { return _a.cols(); }
+	Index size() const { return _a.size(); }
+
+	const float* block(Index iStart, Index iSize, float* pScratch) const
+	{
+		Op::apply(_a.block(iStart, iSize, pScratch), _f, pScratch, iSize);
+		return pScratch;
+	}
+
+	bool overlaps(const float* pBegin, const float* pEnd) const { return _a.overlaps(pBegin, pEnd); }
+
+private:
+	typename ExprNested<Arg>::type _a;
+	float _f;
+};
+
+template <class Op, class Lhs, class Rhs>
+class ExprBinary : public MatrixExpr<ExprBinary<Op, Lhs, Rhs> >
+{
+public:
+	ExprBinary(const Lhs& l, const Rhs& r) : _l(l), _r(r)
+	{
+		assert(l.rows() == r.rows());
+		assert(l.cols() == r.cols());
+	}
+
+	Index rows() const { return _l.rows(); }
+	Index cols() const { return _l.cols(); }
+	Index size() const { return _l.size(); }
+
+	const float* block(Index iStart, Index iSize, float* pScratch) const
+	{
+		float scratchR[MATRIX_EXPR_BLOCK];
+		const float* pL = _l.block(iStart, iSize, pScratch);
+		const float* pR = _r.block(iStart, iSize, scratchR);
+		Op::apply(pL, pR, pScratch, iSize);
+		return pScratch;
+	}
+
+	bool overlaps(const float* pBegin, const float* pEnd) const { return _l.overlaps(pBegin, pEnd) || _r.overlaps(pBegin, pEnd); }
+
+private:
+	typename ExprNested<Lhs>::type _l;
+	typename ExprNested<Rhs>::type _r;
+};
+
+template <class Lhs, class Rhs> ExprBinary<OpAdd, Lhs, Rhs> operator+(const MatrixExpr<Lhs>& a, const MatrixExpr<Rhs>& b) { return ExprBinary<OpAdd, Lhs, Rhs>(a.derived(), b.derived()); }
+template <class Lhs, class Rhs> ExprBinary<OpSub, Lhs, Rhs> operator-(const MatrixExpr<Lhs>& a, const MatrixExpr<Rhs>& b) { return ExprBinary<OpSub, Lhs, Rhs>(a.derived(), b.derived()); }
+template <class E> ExprScalar<OpAddScalar, E> operator+(const MatrixExpr<E>& a, float f) { return ExprScalar<OpAddScalar, E>(a.derived(), f); }
+template <class E> ExprScalar<OpAddScalar, E> operator-(const MatrixExpr<E>& a, float f) { return ExprScalar<OpAddScalar, E>(a.derived(), -f); }
+template <class E> ExprScalar<OpMulScalar, E> operator*(const MatrixExpr<E>& a, float f) { return ExprScalar<OpMulScalar, E>(a.derived(), f); }
+template <class E> ExprScalar<OpMulScalar, E> operator*(float f, const MatrixExpr<E>& a) { return ExprScalar<OpMulScalar, E>(a.derived(), f); }
+template <class E> ExprScalar<OpDivScalar, E> operator/(const MatrixExpr<E>& a, float f) { return ExprScalar<OpDivScalar, E>(a.derived(), f); }
+template <class E> ExprUnary<OpNeg, E> operator-(const MatrixExpr<E>& a) { return ExprUnary<OpNeg, E>(a.derived()); }
 
-using Index=std::ptrdiff_t;
 template <class T>
-class Matrix
+class Matrix : public MatrixExpr<Matrix<T> >
 {
 public:
+    typedef T Scalar;
+
     Matrix<T>()
     {
         _iRows=0;
         _iColumns=0;
         _iSize=_iRows*_iColumns;
+        _iCapacity=0;
         _data=0;
+        _pAllocator=nullptr;
         _bIsView=false;
     }
 
-    Matrix<T>(Index iRows, Index iColumns)
+    Matrix<T>(Index iRows, Index iColumns) : Matrix<T>()
     {
         _iRows=iRows;
         _iColumns=iColumns;
         _iSize=_iRows*_iColumns;
-        _data=new T[_iSize];
-        _bIsView=false;
+        reallocate(_iSize,false);
     }
     
     Matrix<T>(T* pData,Index iRows,Index iColumns)
@@ -56,7 +293,9 @@ public:
         _iRows=iRows;
         _iColumns=iColumns;
         _iSize=_iRows*_iColumns;
+        _iCapacity=_iSize;
         _data=pData;
+        _pAllocator=nullptr;
         _bIsView=true;
     }
     
@@ -67,29 +306,54 @@ public:
         m._iRows=iRows;
         m._iColumns=iColumns;
         m._iSize=iRows*iColumns;
+        m._iCapacity=m._iSize;
         m._data=(T*)pData;
         m._bIsView=true;
 
         return m;
     }
 
-    Matrix<T>(const Matrix<T> &a)
+    Matrix<T>(const Matrix<T> &a) : Matrix<T>()
     {
         _iRows=a._iRows;
         _iColumns=a._iColumns;
         _iSize=_iRows*_iColumns;
-        _data=new T[_iSize];
-        _bIsView=false;
+        reallocate(_iSize,false);
 
         for( Index i=0;i< _iSize;i++)
             _data[i]=a(i);
         //todo use or merge with operator=()(a); ??
     }
 
+    template <class Derived>
+    Matrix<T>(const MatrixExpr<Derived>& e) : Matrix<T>(e.rows(),e.cols())
+    {
+        eval_expr(e.derived(),false);
+    }
+
+    Matrix<T>(Matrix<T>&& a) noexcept
+    {
+        // steal the buffer, a view stays a view on the same data
+        _iRows=a._iRows;
+        _iColumns=a._iColumns;
+        _iSize=a._iSize;
+        _iCapacity=a._iCapacity;
+        _data=a._data;
+        _pAllocator=a._pAllocator;
+        _bIsView=a._bIsView;
+
+        a._iRows=0;
+        a._iColumns=0;
+        a._iSize=0;
+        a._iCapacity=0;
+        a._data=0;
+        a._pAllocator=nullptr;
+        a._bIsView=false;
+    }
+
     ~Matrix<T>()
     {
-        if(!_bIsView)
-            delete [] _data;
+        release();
     }
 
     void assign(T* first,T* last)
@@ -103,6 +367,9 @@ public:
     
     Matrix<T>& operator=( const Matrix<T>& b)
     {
+        if(this==&b)
+            return *this;
+
         resize(b.rows(),b.cols());
         
         for(Index i=0;i<size();i++)
@@ -110,6 +377,31 @@ public:
         
         return *this;
     }
+
+    template <class Derived>
+    Matrix<T>& operator=(const MatrixExpr<Derived>& e)
+    {
+        if((e.rows()!=_iRows) || (e.cols()!=_iColumns))
+            return operator=(Matrix<T>(e)); // resizing first would release the data of an expression reading this matrix
+
+        eval_expr(e.derived(),e.derived().overlaps(_data,_data+_iSize));
+        return *this;
+    }
+
+    Matrix<T>& operator=(Matrix<T>&& b)
+    {
+        // a view writes in the viewed data, and the buffer of a view can't be stolen
+        if(_bIsView || b._bIsView)
+            return operator=((const Matrix<T>&)b);
+
+        std::swap(_data,b._data);
+        std::swap(_iRows,b._iRows);
+        std::swap(_iColumns,b._iColumns);
+        std::swap(_iSize,b._iSize);
+        std::swap(_iCapacity,b._iCapacity);
+        std::swap(_pAllocator,b._pAllocator);
+        return *this;
+    }
     
 	Matrix<T>& array() //for eigen compatibility
 	{
@@ -120,15 +412,6 @@ public:
 		return *this;
 	}
 	
-	Matrix<T> operator-() const
-	{
-		Matrix<T> m(_iRows,_iColumns);
-		for (Index i = 0; i < size(); i++)
-			m._data[i] = -_data[i];
-
-		return m;
-	}
-
 	Index rows() const
     {
         return _iRows;
@@ -144,25 +427,56 @@ public:
         return _iSize;
     }
 
-    void resize(Index iRows, Index iColumns) // slow function!
+	Index capacity() const
+    {
+        return _iCapacity;
+    }
+
+    // the data are not kept, the memory is reallocated only if the capacity is too small
+    // a view keeps viewing its data if the size is the same, else it becomes a matrix
+    void resize(Index iRows, Index iColumns)
     {
         if((iColumns==_iColumns) && ( iRows==_iRows))
             return;
 
+        Index iSize=iRows*iColumns;
+        if(_bIsView ? (iSize!=_iSize) : (iSize>_iCapacity))
+            reallocate(iSize,false);
+
         _iRows=iRows;
         _iColumns=iColumns;
-        Index iSize=_iRows*_iColumns;
-		if (iSize == _iSize)
-			return;
+        _iSize=iSize;
+    }
 
-		_iSize = iSize;
+    // the matrix becomes a view on external data, its own data are released
+    void set_view(T* pData,Index iRows,Index iColumns)
+    {
+        release();
+        _iRows=iRows;
+        _iColumns=iColumns;
+        _iSize=iRows*iColumns;
+        _iCapacity=_iSize;
+        _data=pData;
+        _pAllocator=nullptr;
+        _bIsView=true;
+    }
 
-        if(!_bIsView)
-            delete[] _data;
-        else
-            _bIsView=false;
+    // keep room for iCapacity elements, the data are kept, no effect on a view
+    void reserve(Index iCapacity)
+    {
+        if(_bIsView || (iCapacity<=_iCapacity))
+            return;
 
-        _data=new T[_iSize];
+        reallocate(iCapacity,true);
+    }
+
+    // release the unused capacity, the data are kept, no effect on a view
+    void shrink_to_fit()
+    {
+        if(_bIsView || (_iCapacity==_iSize))
+            return;
+
+        reallocate(_iSize,true);
     }
     
 	void resizeLike(const Matrix<T>& other)
@@ -259,69 +573,42 @@ public:
         return *(_data+iX);
     }
     
-    Matrix<T>& operator+=(const Matrix<T>& a)
+    template <class Derived>
+    Matrix<T>& operator+=(const MatrixExpr<Derived>& a)
     {
         assert(_iRows==a.rows());
         assert(_iColumns==a.cols());
 
-        for(Index i=0;i<_iSize;i++)
-            _data[i]+=a(i);
+        // *this is the first operand, its blocks are read before being written
+        eval_expr(*this+a, a.derived().overlaps(_data,_data+_iSize));
         return *this;
     }
-    
-    Matrix<T> operator+( const Matrix<T>& a ) const
-    {
-        assert(_iRows==a.rows());
-        assert(_iColumns==a.cols());
-
-        return Matrix<T>(*this).operator+=(a);
-    }
 
     Matrix<T>& operator+=(T d)
     {
-        for(Index i=0;i<_iSize;i++)
-            _data[i]+=d;
+        simd_add(_data,d,_data,_iSize);
         return *this;
     }
-    Matrix<T> operator+(T d ) const
-    {
-        return Matrix<T>(*this).operator+=(d);
-    }
 
-    Matrix<T>& operator-=(const Matrix<T>& a)
+    template <class Derived>
+    Matrix<T>& operator-=(const MatrixExpr<Derived>& a)
     {
         assert(_iRows==a.rows());
         assert(_iColumns==a.cols());
 
-        for(Index i=0;i<_iSize;i++)
-            _data[i]-=a(i);
+        eval_expr(*this-a, a.derived().overlaps(_data,_data+_iSize));
         return *this;
     }
 
-    Matrix<T> operator-( const Matrix<T>& a ) const
-    {
-        assert(_iRows==a.rows());
-        assert(_iColumns==a.cols());
-
-        return Matrix<T>(*this).operator-=(a);
-    }
-
     Matrix<T>& operator-=(T d)
     {
-        for(Index i=0;i<_iSize;i++)
-            _data[i]-=d;
+        simd_add(_data,-d,_data,_iSize);
         return *this;
     }
-
-    Matrix<T> operator-(T d ) const
-    {
-        return Matrix<T>(*this).operator-=(d);
-    }
     
     Matrix<T>& operator*=(T b)
     {
-        for(Index i=0;i<_iSize;i++)
-            _data[i]*=b;
+        simd_mul(_data,b,_data,_iSize);
 
         return *this;
     }
@@ -334,257 +621,19 @@ public:
         return *this;
     }
 
-    Matrix<T> operator/(T b) const // slow function!
-    {
-        return Matrix<T>(*this).operator/=(b);
-    }
-
-    Matrix<T> operator*(T b) const // slow function!
-    {
-        return Matrix<T>(*this).operator*=(b);
-    }
-
-
-////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////
-//////////////////////////////////////////////
-    Matrix<T>& operator*=(const Matrix<T>& b) // slow function!
-    {
-        assert(cols()==b.rows());
-
-        Matrix<T> a(*this);
-        resize(a._iRows,b._iColumns);
-
-
-		// RKC algorithm
-		Index kMax=a._iColumns;
-		setZero();
-
-		for (Index r = 0; r < _iRows; r++)
-			for (Index k = 0; k < kMax; k++)
-			{ 
-				auto af=a(r, k);
-				for (Index c = 0; c < _iColumns; c++)
-					operator()(r,c)+= af * b(k, c);
-			}
-/*
-		//RCK algorithm, slower
-        for(Index r=0;r<_iRows;r++)
-        {
-            for(Index c=0;c<_iColumns;c++)
-            {
-                T temp=0.;
-
-                for(Index k=0;k<a._iColumns;k++)
-                    temp+=a(r,k)*b(k,c);
-
-                operator()(r,c)=temp;
-            }
-        }
-	*/	
-        return *this;
-    }
-
-    Matrix<T> cwiseProduct(const Matrix<T>& m) const
+    Matrix<T>& operator*=(const Matrix<T>& b)
     {
-        assert(cols()==m.cols());
-        assert(rows()==m.rows());
-
-        Matrix<T> out(*this);
-
-        for(Index i=0;i<_iSize;i++)
-            out(i)*=m(i);
-
-        return out;
-    }
-
-    Matrix<T> cwiseQuotient(const Matrix<T>& m) const
-    {
-        assert(cols()==m.cols());
-        assert(rows()==m.rows());
-
-        Matrix<T> out(*this);
-
-        for(Index i=0;i<_iSize;i++)
-            out(i)/=m(i);
-
-        return out;
-    }
-
-    Matrix<T> cwiseAbs() const
-    {
-        Matrix<T> out(*this);
-
-        for(Index i=0;i<_iSize;i++)
-            out(i)=::abs(_data[i]);
-
-        return out;
-    }
-
-	Matrix<T> cwiseSign() const
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = std::copysign(1.f,_data[i]);
-
-		return out;
-	}
-
-	Matrix<T> cwiseAbs2() const
-    {
-        Matrix<T> out(*this);
-
-        for(Index i=0;i<_iSize;i++)
-            out(i)=_data[i]*_data[i]; //todo optimize
-
-        return out;
-    }
-
-	Matrix<T> cube() const
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = _data[i] * _data[i] * _data[i]; //todo optimize
-
-		return out;
-	}
-
-	Matrix<T> log() const // applies on array only
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = ::log(_data[i]);
-
-		return out;
-	}
-
-	Matrix<T> round() const // applies on array only
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = ::round(_data[i]);
-
-		return out;
-	}
-
-	Matrix<T> cosh() const // applies on array only
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = ::cosh(_data[i]);
-
-		return out;
-	}
-
-	Matrix<T> tanh() const // applies on array only
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = ::tanh(_data[i]);
-
-		return out;
-	}
-
-	Matrix<T> exp() const // applies on array only
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = ::exp(_data[i]);
-
-		return out;
-	}
-
-	Matrix<T> cwiseSqrt() const
-    {
-        Matrix<T> out(*this);
-
-        for(Index i=0;i<_iSize;i++)
-            out(i)=::sqrt(_data[i]);
-
-        return out;
-    }
-
-	Matrix<T> square() const
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) =_data[i]* _data[i];
-
-		return out;
-	}
-
-	Matrix<T> cwiseMin(T f) const
-	{
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = std::min<T>(_data[i], f);
-
-		return out;
-	}
-	
-	Matrix<T> cwiseMin(const Matrix<T>& m) const
-	{
-		assert(m.rows() == rows());
-		assert(m.cols() == cols());
-
-		Matrix<T> out(*this);
-
-		for (Index i = 0; i < _iSize; i++)
-			out(i) = std::min<T>(_data[i], m._data[i]);
-
-		return out;
-	}
-
-	Matrix<T> cwiseMax(T f) const
-    {
-        Matrix<T> out(*this);
-
-        for(Index i=0;i<_iSize;i++)
-            out(i)=std::max<T>(_data[i],f);
-
-        return out;
-    }
-
-    Matrix<T> cwiseMax(const Matrix<T>& m) const
-    {
-        assert(m.rows()==rows());
-        assert(m.cols()==cols());
-
-        Matrix<T> out(*this);
-
-        for(Index i=0;i<_iSize;i++)
-            out(i)=std::max<T>(_data[i],m._data[i]);
-
-        return out;
+        return operator=(operator*(b)); // the product buffer is moved in, or copied in a view
     }
 
     T sum() const
     {
-        T dSum=0.;
-        for(Index i=0;i<_iSize;i++)
-            dSum+=_data[i];
-
-        return dSum;
+        return simd_sum(_data,_iSize);
     }
 
 	T squaredNorm() const
 	{
-		T dSumSq = 0.;
-		for (Index i = 0; i < _iSize; i++)
-			dSumSq += _data[i]* _data[i];
-
-		return dSumSq;
+		return simd_squared_norm(_data, _iSize);
 	}
 
 	T norm() const
@@ -621,9 +670,17 @@ public:
         return out;
     }
 
-    Matrix<T> operator*(const Matrix<T>& a) const  // slow function!
+    Matrix<T> operator*(const Matrix<T>& b) const
     {
-        return Matrix<T>(*this).operator*=(a);
+        assert(cols()==b.rows());
+
+        Matrix<T> ab(_iRows,b._iColumns);
+        gemm_packed(_iRows,b._iColumns,_iColumns,1.f,
+            _data,_iColumns,1,
+            b._data,b._iColumns,1,
+            0.f,ab._data,b._iColumns);
+
+        return ab;
     }
 
     Matrix<T> row(Index iRow)
@@ -676,19 +733,84 @@ public:
         return trace;
     }
 
+    // expression leaf
+    const T* block(Index iStart, Index /*iSize*/, T* /*pScratch*/) const
+    {
+        return _data+iStart;
+    }
+
+    bool overlaps(const T* pBegin, const T* pEnd) const
+    {
+        return (_data<pEnd) && (pBegin<_data+_iSize);
+    }
+
 private:
+    // new data from the allocator of the calling thread, the matrix is no more a view
+    void reallocate(Index iCapacity,bool bKeepData)
+    {
+        MatrixAllocator* pAllocator=get_matrix_allocator();
+        T* pData=static_cast<T*>(pAllocator->allocate(sizeof(T)*(size_t)iCapacity));
+        if(bKeepData)
+            std::copy(_data,_data+_iSize,pData);
+
+        release();
+        _data=pData;
+        _iCapacity=iCapacity;
+        _pAllocator=pAllocator;
+        _bIsView=false;
+    }
+
+    // give back the data to their allocator
+    void release()
+    {
+        if(_data && !_bIsView)
+            _pAllocator->deallocate(_data,sizeof(T)*(size_t)_iCapacity);
+    }
+
+    // evaluate the expression block by block, the blocks are computed in place if the expression does not read this matrix
+    template <class Derived>
+    void eval_expr(const Derived& e, bool bAlias)
+    {
+        T scratch[MATRIX_EXPR_BLOCK];
+
+        for(Index i=0;i<_iSize;i+=MATRIX_EXPR_BLOCK)
+        {
+            Index iBlockSize=std::min<Index>(MATRIX_EXPR_BLOCK,_iSize-i);
+            T* pOut=_data+i;
+            const T* pBlock=e.block(i,iBlockSize,bAlias ? scratch : pOut);
+            if(pBlock!=pOut)
+                std::copy(pBlock,pBlock+iBlockSize,pOut);
+        }
+    }
+
     Index _iRows,_iColumns,_iSize;
+    Index _iCapacity; // allocated elements, a smaller resize keeps the memory
+
     T* _data;
+    MatrixAllocator* _pAllocator; // owner of _data
     bool _bIsView;
 };
 
 typedef Matrix<float> MatrixFloat;
 typedef Matrix<float> MatrixFloatView;
 
+template <class Derived>
+MatrixFloat MatrixExpr<Derived>::eval() const
+{
+	return MatrixFloat(*this);
+}
+
+template <class Derived>
+MatrixFloat MatrixExpr<Derived>::transpose() const
+{
+	return eval().transpose();
+}
+
 #endif
 
 MatrixFloatView fromRawBuffer(float *pBuffer, Index iRows, Index iCols);
 const MatrixFloatView fromRawBuffer(const float *pBuffer, Index iRows, Index iCols);
+void setView(MatrixFloat& m, const float* pBuffer, Index iRows, Index iCols); // m views the buffer without copy, m is a copy with Eigen
 void copyInto(const MatrixFloat& mToCopy, MatrixFloat& m, Index iStartRow);
 float* rowPtr(MatrixFloat& m, Index iRow);
 const float* rowPtr(const MatrixFloat& m, Index iRow);
@@ -698,6 +820,9 @@ const MatrixFloatView viewResize(const MatrixFloat& m, Index iRows, Index iCols)
 const MatrixFloatView viewRow(const MatrixFloat& m, Index iStartRow, Index iEndRow); //create a row view starting at iStartRow to (not included) iEndRow
 const MatrixFloat colExtract(const MatrixFloat& m, Index iStartCol , Index iEndCol);
 
+// mC = fAlpha * op(mA) * op(mB) + fBeta * mC, op() transposes if asked, without building the transposed matrix
+void gemm(const MatrixFloat& mA, bool bTransposeA, const MatrixFloat& mB, bool bTransposeB, MatrixFloat& mC, float fAlpha = 1.f, float fBeta = 0.f);
+
 MatrixFloat rowWiseSum(const MatrixFloat& m);
 MatrixFloat rowWiseSumSq(const MatrixFloat& m);
 MatrixFloat rowWiseAdd(const MatrixFloat& m, const MatrixFloat& d);
@@ -713,9 +838,11 @@ MatrixFloat colWiseMax(const MatrixFloat& m);
 void setRandomUniform(MatrixFloat& m, float fMin = -1.f, float fMax = 1.f);
 void setRandomNormal(MatrixFloat& m, float fMean, float fNormal);
 void setQuickBernoulli(MatrixFloat& m, float fProba); //quick bernoulli is 6x faster than ref bernoulli, resolution proba is 1/65536 
-std::default_random_engine& randomEngine();
+std::default_random_engine& randomEngine(); // engine of the calling thread, the shared one if not set
+std::default_random_engine* setRandomEngine(std::default_random_engine* pEngine); // for the calling thread, nullptr for the shared one, return the previous one
 std::vector<Index> randPerm(Index iSize); //create a vector of index shuffled
 void applyRowPermutation(const std::vector<Index>& vPermutation, const MatrixFloat & mIn, MatrixFloat & mPermuted);
+void gatherRows(const std::vector<Index>& vIndex, Index iStart, Index iEnd, const MatrixFloat& mIn, MatrixFloat& mOut); // mOut rows are the mIn rows vIndex[iStart] to vIndex[iEnd-1], a batch without a shuffled copy of the data
 MatrixFloat decimate(const MatrixFloat& m, Index iRatio);
 Index argmax(const MatrixFloat& m);
 void rowsArgmax(const MatrixFloat& m, MatrixFloat& argM); //compute the argmax row by row
@@ -729,7 +856,8 @@ void channelWiseAdd(MatrixFloat& mIn,Index iNbSamples,Index iNbChannels,Index iN
 MatrixFloat channelWiseMean(const MatrixFloat& m, Index iNbSamples, Index iNbChannels, Index iNbRows, Index iNbCols);
 
 std::string toString(const MatrixFloat& m);
-const MatrixFloat fromFile(const std::string& sFile);
+const MatrixFloat fromFile(const std::string& sFile); // empty if the file is not valid
+bool fromFile(const std::string& sFile, MatrixFloat& m); // text file, one row by line, false if not a number or not the same number of columns on all lines
 const MatrixFloat fromString(const std::string& s);
 bool toFile(const std::string& sFile, const MatrixFloat & m);
 
@@ -0,0 +1,314 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#include "MatrixAllocator.h"
+
+#include <new>
+
+using namespace std;
+namespace beednn {
+
+static thread_local MatrixAllocator* t_pMatrixAllocator = nullptr;
+
+///////////////////////////////////////////////////////////////////////////
+MatrixAllocator::~MatrixAllocator()
+{ }
+///////////////////////////////////////////////////////////////////////////
+void MatrixAllocator::reset()
+{ }
+///////////////////////////////////////////////////////////////////////////
+void MatrixAllocator::release_free_blocks()
+{ }
+///////////////////////////////////////////////////////////////////////////
+MatrixDefaultAllocator& MatrixDefaultAllocator::instance()
+{
+	static MatrixDefaultAllocator allocator;
+	return allocator;
+}
+///////////////////////////////////////////////////////////////////////////
+void* MatrixDefaultAllocator::allocate(size_t iBytes)
+{
+	return ::operator new(iBytes, align_val_t(MATRIX_ALIGNMENT));
+}
+///////////////////////////////////////////////////////////////////////////
+void MatrixDefaultAllocator::deallocate(void* p, size_t iBytes)
+{
+	(void)iBytes;
+	::operator delete(p, align_val_t(MATRIX_ALIGNMENT));
+}
+///////////////////////////////////////////////////////////////////////////
+// free lists of one thread, its mutex is only contended by release_free_blocks()
+struct MatrixPoolAllocator::ThreadCache
+{
+	mutex cacheMutex;
+	void* freeBlocks[MATRIX_POOL_SIZE_CLASSES];
+	int nbFreeBlocks[MATRIX_POOL_SIZE_CLASSES];
+	size_t iCachedBytes;
+	bool bUsed;
+};
+///////////////////////////////////////////////////////////////////////////
+// give back the thread cache at the end of the thread
+struct MatrixPoolAllocator::ThreadCacheOwner
+{
+	ThreadCache* pCache = nullptr;
+	~ThreadCacheOwner();
+};
+static thread_local bool t_bPoolCacheReleased = false; // trivially destructible: still valid in the last deallocations of the thread
+///////////////////////////////////////////////////////////////////////////
+MatrixPoolAllocator::ThreadCacheOwner::~ThreadCacheOwner()
+{
+	t_bPoolCacheReleased = true;
+	if (pCache)
+		MatrixPoolAllocator::instance().release_thread_cache(pCache);
+}
+///////////////////////////////////////////////////////////////////////////
+static void free_list_release(void*& pBlock)
+{
+	while (pBlock)
+	{
+		void* pNext = *(void**)pBlock;
+		::operator delete(pBlock, align_val_t(MATRIX_ALIGNMENT));
+		pBlock = pNext;
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+MatrixPoolAllocator::MatrixPoolAllocator()
+{
+	for (auto& pBlock : _freeBlocks)
+		pBlock = nullptr;
+
+	_iCachedBytes = 0;
+	_iNbSystemAllocations = 0;
+	_iNbSystemAllocationsAtReset = 0;
+	_iNbSystemAllocationsLastBatch = 0;
+}
+///////////////////////////////////////////////////////////////////////////
+MatrixPoolAllocator::~MatrixPoolAllocator()
+{ }
+///////////////////////////////////////////////////////////////////////////
+MatrixPoolAllocator& MatrixPoolAllocator::instance()
+{
+	static MatrixPoolAllocator* pPool = new MatrixPoolAllocator; // never destroyed, see class comment
+	return *pPool;
+}
+///////////////////////////////////////////////////////////////////////////
+// class 0 is up to MATRIX_ALIGNMENT bytes, then 4 classes by power of two: 1.25, 1.5, 1.75 and 2 times the power
+size_t MatrixPoolAllocator::size_class(size_t iBytes, size_t& iClassBytes)
+{
+	if (iBytes <= MATRIX_ALIGNMENT)
+	{
+		iClassBytes = MATRIX_ALIGNMENT;
+		return 0;
+	}
+
+	size_t iLast = iBytes - 1;
+	int iPower = 0;
+	while ((iLast >> iPower) > 1)
+		iPower++;
+
+	// iLast is in [2^iPower, 2^(iPower+1)), iQuarter in [4, 8)
+	int iShift = iPower - 2;
+	size_t iQuarter = iLast >> iShift;
+	iClassBytes = (iQuarter + 1) << iShift;
+	return 1 + (iPower - 6) * 4 + (iQuarter - 4);
+}
+///////////////////////////////////////////////////////////////////////////
+MatrixPoolAllocator::ThreadCache* MatrixPoolAllocator::thread_cache()
+{
+	if (t_bPoolCacheReleased)
+		return nullptr;
+
+	static thread_local ThreadCacheOwner owner;
+	if (owner.pCache)
+		return owner.pCache;
+
+	ThreadCache* pCache = nullptr;
+	{
+		lock_guard<mutex> lock(_mutex);
+		for (ThreadCache* pFreeCache : _threadCaches)
+		{
+			if (!pFreeCache->bUsed)
+			{
+				pCache = pFreeCache;
+				break;
+			}
+		}
+
+		if (pCache == nullptr)
+		{
+			pCache = new ThreadCache;
+			for (int i = 0; i < MATRIX_POOL_SIZE_CLASSES; i++)
+			{
+				pCache->freeBlocks[i] = nullptr;
+				pCache->nbFreeBlocks[i] = 0;
+			}
+			pCache->iCachedBytes = 0;
+			_threadCaches.push_back(pCache);
+		}
+		pCache->bUsed = true;
+	}
+
+	owner.pCache = pCache;
+	return pCache;
+}
+///////////////////////////////////////////////////////////////////////////
+void MatrixPoolAllocator::release_thread_cache(ThreadCache* pCache)
+{
+	{
+		lock_guard<mutex> lock(pCache->cacheMutex);
+		for (int i = 0; i < MATRIX_POOL_SIZE_CLASSES; i++)
+		{
+			free_list_release(pCache->freeBlocks[i]);
+			pCache->nbFreeBlocks[i] = 0;
+		}
+		pCache->iCachedBytes = 0;
+	}
+
+	lock_guard<mutex> lock(_mutex);
+	pCache->bUsed = false;
+}
+///////////////////////////////////////////////////////////////////////////
+void* MatrixPoolAllocator::allocate(size_t iBytes)
+{
+	size_t iClassBytes;
+	size_t iClass = size_class(iBytes, iClassBytes);
+
+	ThreadCache* pCache = thread_cache();
+	if (pCache)
+	{
+		lock_guard<mutex> lock(pCache->cacheMutex);
+		void* pBlock = pCache->freeBlocks[iClass];
+		if (pBlock)
+		{
+			pCache->freeBlocks[iClass] = *(void**)pBlock;
+			pCache->nbFreeBlocks[iClass]--;
+			pCache->iCachedBytes -= iClassBytes;
+			return pBlock;
+		}
+	}
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		void* pBlock = _freeBlocks[iClass];
+		if (pBlock)
+		{
+			_freeBlocks[iClass] = *(void**)pBlock;
+			_iCachedBytes -= iClassBytes;
+			return pBlock;
+		}
+	}
+
+	_iNbSystemAllocations++;
+	return ::operator new(iClassBytes, align_val_t(MATRIX_ALIGNMENT));
+}
+///////////////////////////////////////////////////////////////////////////
+void MatrixPoolAllocator::deallocate(void* p, size_t iBytes)
+{
+	if (p == nullptr)
+		return;
+
+	size_t iClassBytes;
+	size_t iClass = size_class(iBytes, iClassBytes);
+
+	ThreadCache* pCache = thread_cache();
+	if (pCache)
+	{
+		lock_guard<mutex> lock(pCache->cacheMutex);
+		if (pCache->nbFreeBlocks[iClass] < MATRIX_POOL_THREAD_BLOCKS)
+		{
+			*(void**)p = pCache->freeBlocks[iClass];
+			pCache->freeBlocks[iClass] = p;
+			pCache->nbFreeBlocks[iClass]++;
+			pCache->iCachedBytes += iClassBytes;
+			return;
+		}
+	}
+
+	// a thread freeing the blocks allocated by another one: they go back to the shared free lists
+	lock_guard<mutex> lock(_mutex);
+	*(void**)p = _freeBlocks[iClass];
+	_freeBlocks[iClass] = p;
+	_iCachedBytes += iClassBytes;
+}
+///////////////////////////////////////////////////////////////////////////
+void MatrixPoolAllocator::reset()
+{
+	lock_guard<mutex> lock(_mutex);
+	size_t iNbSystemAllocations = _iNbSystemAllocations;
+	_iNbSystemAllocationsLastBatch = iNbSystemAllocations - _iNbSystemAllocationsAtReset;
+	_iNbSystemAllocationsAtReset = iNbSystemAllocations;
+}
+///////////////////////////////////////////////////////////////////////////
+void MatrixPoolAllocator::release_free_blocks()
+{
+	lock_guard<mutex> lock(_mutex);
+	for (auto& pBlock : _freeBlocks)
+		free_list_release(pBlock);
+	_iCachedBytes = 0;
+
+	for (ThreadCache* pCache : _threadCaches)
+	{
+		lock_guard<mutex> lockCache(pCache->cacheMutex);
+		for (int i = 0; i < MATRIX_POOL_SIZE_CLASSES; i++)
+		{
+			free_list_release(pCache->freeBlocks[i]);
+			pCache->nbFreeBlocks[i] = 0;
+		}
+		pCache->iCachedBytes = 0;
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+size_t MatrixPoolAllocator::nb_system_allocations() const
+{
+	return _iNbSystemAllocations;
+}
+///////////////////////////////////////////////////////////////////////////
+size_t MatrixPoolAllocator::nb_system_allocations_last_batch() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _iNbSystemAllocationsLastBatch;
+}
+///////////////////////////////////////////////////////////////////////////
+size_t MatrixPoolAllocator::cached_bytes() const
+{
+	lock_guard<mutex> lock(_mutex);
+	size_t iCachedBytes = _iCachedBytes;
+	for (ThreadCache* pCache : _threadCaches)
+	{
+		lock_guard<mutex> lockCache(pCache->cacheMutex);
+		iCachedBytes += pCache->iCachedBytes;
+	}
+	return iCachedBytes;
+}
+///////////////////////////////////////////////////////////////////////////
+MatrixAllocator* get_matrix_allocator()
+{
+	if (t_pMatrixAllocator)
+		return t_pMatrixAllocator;
+
+	return &MatrixDefaultAllocator::instance();
+}
+///////////////////////////////////////////////////////////////////////////
+void set_matrix_allocator(MatrixAllocator* pAllocator)
+{
+	t_pMatrixAllocator = pAllocator;
+}
+///////////////////////////////////////////////////////////////////////////
+MatrixAllocatorScope::MatrixAllocatorScope(MatrixAllocator* pAllocator)
+{
+	_pPreviousAllocator = t_pMatrixAllocator;
+	if (pAllocator)
+		t_pMatrixAllocator = pAllocator;
+}
+///////////////////////////////////////////////////////////////////////////
+MatrixAllocatorScope::~MatrixAllocatorScope()
+{
+	t_pMatrixAllocator = _pPreviousAllocator;
+}
+///////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,98 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#define MATRIX_ALIGNMENT 64 // data alignment in bytes, a cache line and an AVX-512 register
+#define MATRIX_POOL_SIZE_CLASSES 256 // size classes of the pool allocator
+#define MATRIX_POOL_THREAD_BLOCKS 64 // free blocks of a size class kept by a thread, the others go to the shared free lists
+
+namespace beednn {
+
+// source of the internal Matrix data, each matrix gives back its data to the allocator it comes from
+// with Eigen, the Eigen allocator is used and this one is ignored
+class MatrixAllocator
+{
+public:
+	virtual ~MatrixAllocator();
+
+	virtual void* allocate(size_t iBytes) = 0; // MATRIX_ALIGNMENT aligned
+	virtual void deallocate(void* p, size_t iBytes) = 0; // same iBytes as allocate()
+	virtual void reset(); // end of a batch, nothing by default
+	virtual void release_free_blocks(); // end of a training, give back the cached memory to the system, nothing by default
+};
+
+// aligned operator new and delete
+class MatrixDefaultAllocator : public MatrixAllocator
+{
+public:
+	static MatrixDefaultAllocator& instance();
+
+	void* allocate(size_t iBytes) override;
+	void deallocate(void* p, size_t iBytes) override;
+};
+
+// keep the freed blocks in size classes and give them back on the next allocations
+// a training loop allocates the same temporaries on every batch: once warm, the pool does not call the system allocator any more
+// size classes are 4 by power of two, so at most 25% of memory is lost, the free lists are stored in the free blocks
+// each thread has its own free lists, the shared ones are only locked when a thread has too many or no free blocks of a size
+// thread safe, never destroyed: a matrix can be freed after the end of the training or of the program
+class MatrixPoolAllocator : public MatrixAllocator
+{
+public:
+	static MatrixPoolAllocator& instance(); // shared by all NetTrain
+
+	void* allocate(size_t iBytes) override;
+	void deallocate(void* p, size_t iBytes) override;
+	void reset() override; // end of a batch, update the statistics
+	void release_free_blocks() override; // give back the free blocks of all threads to the system, done at the end of NetTrain::fit()
+
+	size_t nb_system_allocations() const; // since the creation
+	size_t nb_system_allocations_last_batch() const; // between the two last reset(), 0 in a warm training loop
+	size_t cached_bytes() const; // in the free blocks
+
+private:
+	struct ThreadCache;
+	struct ThreadCacheOwner;
+
+	MatrixPoolAllocator();
+	~MatrixPoolAllocator() override;
+
+	static size_t size_class(size_t iBytes, size_t& iClassBytes);
+	ThreadCache* thread_cache(); // of the calling thread, nullptr once the thread is ending
+	void release_thread_cache(ThreadCache* pCache); // at the end of its thread
+
+	mutable std::mutex _mutex; // shared free lists and thread caches list
+	void* _freeBlocks[MATRIX_POOL_SIZE_CLASSES]; // head of the shared free list of each size class
+	size_t _iCachedBytes; // in the shared free lists
+	std::vector<ThreadCache*> _threadCaches; // never deleted, reused by the next threads
+	std::atomic<size_t> _iNbSystemAllocations;
+	size_t _iNbSystemAllocationsAtReset;
+	size_t _iNbSystemAllocationsLastBatch;
+};
+
+MatrixAllocator* get_matrix_allocator(); // allocator of the new matrices in the calling thread, the default one if not set
+void set_matrix_allocator(MatrixAllocator* pAllocator); // for the calling thread, nullptr for the default one
+
+// use an allocator in the calling thread until the end of the scope, nullptr keeps the current one
+class MatrixAllocatorScope
+{
+public:
+	explicit MatrixAllocatorScope(MatrixAllocator* pAllocator);
+	~MatrixAllocatorScope();
+
+private:
+	MatrixAllocator* _pPreviousAllocator;
+};
+
+}
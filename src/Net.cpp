@@ -12,6 +12,9 @@
 #include "Matrix.h"
 
 #include <cmath>
+#include <utility>
+
+using namespace std;
 namespace beednn {
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -19,6 +22,7 @@ Net::Net()
 { 
     _bTrainMode = false;
 	_bClassificationMode = true;
+	_iInferenceBatchSize = 256;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
 Net::~Net()
@@ -33,6 +37,7 @@ void Net::clear()
 
     _layers.clear();
     _bTrainMode=false;
+	_pWeightsKeepAlive.reset(); // after the layers viewing the weights
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
 Net& Net::operator=(const Net& other)
@@ -43,6 +48,7 @@ Net& Net::operator=(const Net& other)
         _layers.push_back(other._layers[i]->clone());
 
     _bClassificationMode = other._bClassificationMode;
+	_iInferenceBatchSize = other._iInferenceBatchSize;
 
     return *this;
 }
@@ -62,15 +68,116 @@ void Net::replace(size_t iLayer, Layer* l)
 	_layers[iLayer] = l;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
+void InferenceContext::clear()
+{
+	_buffers[0] = MatrixFloat();
+	_buffers[1] = MatrixFloat();
+	_layersScratch.clear();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+MatrixFloat& InferenceContext::buffer(int iBuffer)
+{
+	assert((iBuffer == 0) || (iBuffer == 1));
+	return _buffers[iBuffer];
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void InferenceContext::set_nb_layers(size_t iNbLayers)
+{
+	if (_layersScratch.size() != iNbLayers)
+		_layersScratch.resize(iNbLayers);
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+vector<MatrixFloat>& InferenceContext::layer_scratch(size_t iLayer)
+{
+	assert(iLayer < _layersScratch.size());
+	return _layersScratch[iLayer];
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
 void Net::predict(const MatrixFloat& mIn,MatrixFloat& mOut) const
 {
-	//todo cut in mini batches so save memory
-    MatrixFloat mTemp=mIn;
-    for(unsigned int i=0;i<_layers.size();i++)
-    {
-        _layers[i]->forward(mTemp,mOut);
-        mTemp=mOut; //todo avoid resize
-    }
+	InferenceContext context;
+	if (!_layers.empty() && ((_iInferenceBatchSize <= 0) || (mIn.rows() <= _iInferenceBatchSize)))
+	{
+		context.set_nb_layers(_layers.size());
+		mOut = std::move(*forward_buffers(mIn, context)); // moved: the temporary context does not keep its buffer
+		return;
+	}
+
+	predict(mIn, mOut, context);
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Net::predict(const MatrixFloat& mIn, MatrixFloat& mOut, InferenceContext& context) const
+{
+	if (_layers.empty())
+	{
+		mOut = mIn;
+		return;
+	}
+
+	context.set_nb_layers(_layers.size());
+	Index iNbSamples = mIn.rows();
+
+	if ((_iInferenceBatchSize <= 0) || (iNbSamples <= _iInferenceBatchSize))
+	{
+		mOut = *forward_buffers(mIn, context); // copied: the context keeps its buffer for the next call
+		return;
+	}
+
+	if (&mIn == &mOut)
+	{
+		// mOut is written while mIn is read
+		MatrixFloat mInCopy = mIn;
+		predict(mInCopy, mOut, context);
+		return;
+	}
+
+	// the buffers keep the capacity of the first batch, each batch result is copied in mOut
+	for (Index iStart = 0; iStart < iNbSamples; iStart += _iInferenceBatchSize)
+	{
+		Index iEnd = std::min(iStart + _iInferenceBatchSize, iNbSamples);
+		auto mBatch = viewRow(mIn, iStart, iEnd);
+		const MatrixFloat* pResult = forward_buffers(mBatch, context);
+
+		if (iStart == 0)
+			mOut.resize(iNbSamples, pResult->cols());
+
+		copyInto(*pResult, mOut, iStart);
+	}
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// two buffers used in turn: the input is not copied, an in place layer writes over its input buffer
+// return the buffer holding the result, at least one layer is needed
+MatrixFloat* Net::forward_buffers(const MatrixFloat& mIn, InferenceContext& context) const
+{
+	assert(!_layers.empty());
+	MatrixFloat* pCurrent = nullptr; // nullptr: still the input
+
+	for (size_t i = 0; i < _layers.size(); i++)
+	{
+		const Layer& l = *_layers[i];
+		vector<MatrixFloat>& vScratch = context.layer_scratch(i);
+		if (pCurrent && l.is_inplace())
+		{
+			l.predict(*pCurrent, *pCurrent, vScratch);
+			continue;
+		}
+
+		MatrixFloat* pNext = (pCurrent == &context.buffer(0)) ? &context.buffer(1) : &context.buffer(0);
+		l.predict(pCurrent ? *pCurrent : mIn, *pNext, vScratch);
+		pCurrent = pNext;
+	}
+
+	return pCurrent;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+void Net::set_inference_batchsize(Index iBatchSize)
+{
+	_iInferenceBatchSize = iBatchSize;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+Index Net::get_inference_batchsize() const
+{
+	return _iInferenceBatchSize;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////
 void Net::set_classification_mode(bool bClassificationMode)
@@ -84,9 +191,15 @@ bool Net::is_classification_mode() const
 }
 /////////////////////////////////////////////////////////////////////////////////////////////
 void Net::predict_classes(const MatrixFloat& mIn, MatrixFloat& mClass) const
+{
+	InferenceContext context;
+	predict_classes(mIn, mClass, context);
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+void Net::predict_classes(const MatrixFloat& mIn, MatrixFloat& mClass, InferenceContext& context) const
 {
     MatrixFloat mOut;
-	predict(mIn, mOut);
+	predict(mIn, mOut, context);
 	
 	if (mOut.cols() != 1)
 		rowsArgmax(mOut, mClass); //one hot case
@@ -106,6 +219,16 @@ void Net::set_train_mode(bool bTrainMode)
         _layers[i]->set_train_mode(bTrainMode);
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
+bool Net::is_train_mode() const
+{
+	return _bTrainMode;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void Net::set_weights_keepalive(const shared_ptr<void>& pKeepAlive)
+{
+	_pWeightsKeepAlive = pKeepAlive;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
 const std::vector<Layer*> Net::layers() const
 {
     return _layers;
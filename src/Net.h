@@ -8,11 +8,29 @@
 #pragma once
 
 #include "Matrix.h"
+#include <memory>
 #include <vector>
 
 namespace beednn {
 class Layer;
 
+// state of one inference: the ping-pong buffers and the temporaries of the layers
+// one const Net can predict in many threads at once, with one context by thread, without lock nor weights copy
+// the context keeps its memory from call to call, and the states of the recurrent layers for an on-the-fly prediction
+class InferenceContext
+{
+public:
+	void clear(); // release the memory and reset the states
+
+	void set_nb_layers(size_t iNbLayers);
+	MatrixFloat& buffer(int iBuffer); // 0 or 1
+	std::vector<MatrixFloat>& layer_scratch(size_t iLayer);
+
+private:
+	MatrixFloat _buffers[2];
+	std::vector<std::vector<MatrixFloat>> _layersScratch;
+};
+
 class Net
 {
 public:
@@ -37,14 +55,31 @@ public:
 	void set_classification_mode(bool bClassificationMode); //true by default
 	bool is_classification_mode() const;
 
-	void predict(const MatrixFloat& mIn, MatrixFloat& mOut) const;
+	// thread safe if not in train mode: the layers are not modified
+	// a layer initialized on its first forward() (Gain, Affine, PRelu ...) must be trained or used once before
+	void predict(const MatrixFloat& mIn, MatrixFloat& mOut) const; // with a temporary context
+	void predict(const MatrixFloat& mIn, MatrixFloat& mOut, InferenceContext& context) const; // faster, the context memory is reused
 	void predict_classes(const MatrixFloat& mIn, MatrixFloat& mClass) const;
+	void predict_classes(const MatrixFloat& mIn, MatrixFloat& mClass, InferenceContext& context) const;
+
+	// predict() cuts the input in batches of this size, so the layers buffers (im2col ...) do not grow with the input size
+	void set_inference_batchsize(Index iBatchSize); // 256 by default, 0 for all samples at once
+	Index get_inference_batchsize() const;
 
     void set_train_mode(bool bTrainMode); // set to true if training, set to false if testing (default)
+	bool is_train_mode() const;
+
+	// storage of the weights viewed by the layers, as the file mapped by NetUtil::load(), kept until clear()
+	// operator= does not share it: the copied layers own their weights
+	void set_weights_keepalive(const std::shared_ptr<void>& pKeepAlive);
 
 private:
+	MatrixFloat* forward_buffers(const MatrixFloat& mIn, InferenceContext& context) const;
+
 	bool _bTrainMode;
 	std::vector<Layer*> _layers;
 	bool _bClassificationMode;
+	Index _iInferenceBatchSize;
+	std::shared_ptr<void> _pWeightsKeepAlive;
 };
 }
@@ -11,17 +11,50 @@
 #include "Net.h"
 #include "Layer.h"
 #include "Matrix.h"
+#include "MatrixAllocator.h"
+#include "ThreadPool.h"
+#include "BatchPrefetcher.h"
+#include "DataStream.h"
 
 #include "Optimizer.h"
 #include "Regularizer.h"
 #include "Loss.h"
 
+#include <atomic>
 #include <cmath>
 #include <cassert>
+#include <random>
+#include <thread>
 
 using namespace std;
 namespace beednn {
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// a part of the batch in the data parallel training, with its own buffers and random engine
+struct NetTrain::TrainShard
+{
+	Net net; // copy of the trained net, not used by the first shard
+	vector<MatrixFloat> inOut;
+	vector<MatrixFloat> gradient;
+	vector<MatrixFloat*> pParams; // all weights then all biases, as in _pWeights and _pBiases
+	vector<MatrixFloat*> pGradParams;
+	default_random_engine randomEngine;
+	Index iStart, iEnd; // rows of the batch
+
+	// hogwild only
+	vector<Optimizer*> optimizers;
+	vector<MatrixFloat> steps; // optimizer steps of the batch, added to the shared weights
+	MatrixFloat batchSamples, batchTruth;
+	float fOnlineLoss;
+	int iOnlineAccuracyGood;
+
+	~TrainShard()
+	{
+		for (size_t i = 0; i < optimizers.size(); i++)
+			delete optimizers[i];
+	}
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 NetTrain::NetTrain():
     _sOptimizer("Adam"),
@@ -55,17 +88,26 @@ NetTrain::NetTrain():
 	_iNbLayers=0;
 	_fOnlineLoss = 0.f;
 	_pNet = nullptr;
+	_pAllocator = &MatrixPoolAllocator::instance();
+	_iNbShards = 1;
+	_bHogwild = false;
+	_iPrefetchBatches = 0;
+	_pPrefetcher = new BatchPrefetcher;
 
     _pmSamplesTrain = nullptr;
     _pmTruthTrain = nullptr;
+	_pTrainStream = nullptr;
 
 	_pmSamplesValidation = nullptr;
 	_pmTruthValidation = nullptr;
+	_pValidationStream = nullptr;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
 NetTrain::~NetTrain()
 {
 	clear_optimizers();
+	clear_shards();
+	delete _pPrefetcher;
     delete _pLoss;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -86,6 +128,7 @@ NetTrain& NetTrain::operator=(const NetTrain& other)
 {
 	_pNet = nullptr;
     clear();
+	clear_shards();
 
 	_iBatchSizeAdjusted=-1; //invalid
 	
@@ -130,9 +173,15 @@ NetTrain& NetTrain::operator=(const NetTrain& other)
 
     _pmSamplesTrain = other._pmSamplesTrain;
     _pmTruthTrain = other._pmTruthTrain;
+	_pTrainStream = other._pTrainStream;
 
 	_pmSamplesValidation = other._pmSamplesValidation;
 	_pmTruthValidation = other._pmTruthValidation;
+	_pValidationStream = other._pValidationStream;
+	_pAllocator = other._pAllocator;
+	_iNbShards = other._iNbShards;
+	_bHogwild = other._bHogwild;
+	_iPrefetchBatches = other._iPrefetchBatches;
 
 	return *this;
 }
@@ -299,6 +348,61 @@ Index NetTrain::get_validation_batchsize() const
 	return _iValidationBatchSize;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::set_allocator(MatrixAllocator* pAllocator)
+{
+	_pAllocator = pAllocator;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+MatrixAllocator* NetTrain::get_allocator() const
+{
+	return _pAllocator;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::set_nb_shards(int iNbShards)
+{
+	if (iNbShards < 1)
+		iNbShards = 1;
+
+	_iNbShards = iNbShards;
+	clear_shards();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+int NetTrain::get_nb_shards() const
+{
+	return _iNbShards;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::set_hogwild(bool bHogwild)
+{
+	_bHogwild = bHogwild;
+	clear_shards();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+bool NetTrain::get_hogwild() const
+{
+	return _bHogwild;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::set_prefetch_batches(int iNbBatches)
+{
+	_iPrefetchBatches = iNbBatches;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+int NetTrain::get_prefetch_batches() const
+{
+	return _iPrefetchBatches;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+float NetTrain::get_prefetch_stall_time() const
+{
+	return (float)_pPrefetcher->stall_time();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+float NetTrain::get_prefetch_queue_depth() const
+{
+	return (float)_pPrefetcher->mean_queue_depth();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
 void NetTrain::set_classbalancing(bool bBalancing) //true by default
 {
 	_bClassBalancingWeightLoss = bBalancing;
@@ -380,20 +484,70 @@ float NetTrain::compute_loss_accuracy(const MatrixFloat &mSamples, const MatrixF
 	return fLoss;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
+float NetTrain::compute_loss_accuracy(DataStream& stream, float* pfAccuracy) const
+{
+	MatrixFloat mSamples, mTruth;
+	float fLoss = 0.f;
+	double dGood = 0.;
+	Index iNbSamples = 0;
+
+	for (Index iShard = 0; iShard < stream.nb_shards(); iShard++)
+	{
+		if (!stream.read_shard(iShard, mSamples, mTruth))
+			continue;
+
+		float fAccuracy = 0.f;
+		fLoss += compute_loss_accuracy(mSamples, mTruth, pfAccuracy ? &fAccuracy : nullptr);
+		dGood += fAccuracy * mSamples.rows() / 100.;
+		iNbSamples += mSamples.rows();
+	}
+
+	if (pfAccuracy)
+		*pfAccuracy = iNbSamples ? (float)(100. * dGood / iNbSamples) : 0.f;
+
+	return fLoss;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+float NetTrain::compute_validation_loss_accuracy(float* pfAccuracy) const
+{
+	if (_pValidationStream)
+		return compute_loss_accuracy(*_pValidationStream, pfAccuracy);
+
+	return compute_loss_accuracy(*_pmSamplesValidation, *_pmTruthValidation, pfAccuracy);
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
 void NetTrain::set_train_data(const MatrixFloat& mSamples, const MatrixFloat& mTruth)
 {
     _pmSamplesTrain = &mSamples;
     _pmTruthTrain = &mTruth;
+	_pTrainStream = nullptr;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::set_train_stream(DataStream* pStream)
+{
+	_pTrainStream = pStream;
+	_pmSamplesTrain = nullptr;
+	_pmTruthTrain = nullptr;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
 void NetTrain::set_validation_data(const MatrixFloat& mSamplesValidation, const MatrixFloat& mTruthValidation)
 {
 	_pmSamplesValidation = &mSamplesValidation;
 	_pmTruthValidation = &mTruthValidation;
+	_pValidationStream = nullptr;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::set_validation_stream(DataStream* pStream)
+{
+	_pValidationStream = pStream;
+	_pmSamplesValidation = nullptr;
+	_pmTruthValidation = nullptr;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////
 void NetTrain::fit(Net& rNet)
 {
+	MatrixAllocatorScope allocatorScope(_pAllocator);
+
 	set_net(rNet);
 
 	if (_pNet == nullptr)
@@ -403,10 +557,12 @@ void NetTrain::fit(Net& rNet)
 	if (_iNbLayers == 0)
 		return; //nothing to do
 
-	update_class_weight();
+	// the weights created in the first forward are trained as the others, also by the copies of the net in the shards and in Hogwild
+	if (_pmSamplesTrain && create_weights(*_pmSamplesTrain))
+		set_net(rNet);
 
-    const MatrixFloat& mSamples = *_pmSamplesTrain;
-    const MatrixFloat& mTruth = *_pmTruthTrain;
+	update_class_weight();
+	_pPrefetcher->reset_statistics();
 
     _trainLoss.clear();
     _validationLoss.clear();
@@ -418,7 +574,7 @@ void NetTrain::fit(Net& rNet)
 	_fValidationAccuracy = 0;
 	_iCurrentPatience = 0;
 
-    int iNbSamples=(int)mSamples.rows();
+    int iNbSamples = (int)(_pTrainStream ? _pTrainStream->nb_samples() : _pmSamplesTrain->rows());
     int iReboost = 0;
 
     Net bestNet;
@@ -437,13 +593,14 @@ void NetTrain::fit(Net& rNet)
 	float fMinLoss = 1.e10f;
 	if(_bKeepBest)
     {
-        if (_pmSamplesValidation == nullptr)
+        if ((_pmSamplesValidation == nullptr) && (_pValidationStream == nullptr))
         {
-            fMinLoss=compute_loss_accuracy(*_pmSamplesTrain, *_pmTruthTrain,&fMaxAccuracy);
+            if (_pTrainStream == nullptr) // a stream is not read before the training: the first epoch is kept at least
+                fMinLoss=compute_loss_accuracy(*_pmSamplesTrain, *_pmTruthTrain,&fMaxAccuracy);
         }
         else
         {
-            fMinLoss=compute_loss_accuracy( *_pmSamplesValidation, *_pmTruthValidation,&fMaxAccuracy);
+            fMinLoss=compute_validation_loss_accuracy(&fMaxAccuracy);
         }
         bestNet= *_pNet;
     }
@@ -453,44 +610,40 @@ void NetTrain::fit(Net& rNet)
         _fOnlineLoss=0.f;
         _iOnlineAccuracyGood = 0;
 
-        MatrixFloat mSampleShuffled;
-        MatrixFloat mTruthShuffled;
-
-        if (_iBatchSizeAdjusted < iNbSamples)
-        {
-            auto vShuffle = randPerm(iNbSamples);
-            applyRowPermutation(vShuffle, mSamples, mSampleShuffled);
-            applyRowPermutation(vShuffle, mTruth, mTruthShuffled);
-        }
-        else
-        {
-			// no need to shuffle
-            mSampleShuffled = mSamples; //todo remove copy
-            mTruthShuffled = mTruth;
-        }
-
 		_pNet->set_train_mode(true);
 
-		train_one_epoch(mSampleShuffled, mTruthShuffled);
+		Index iNbEpochSamples = iNbSamples;
+		if (_pTrainStream)
+			iNbEpochSamples = train_one_epoch_stream();
+		else
+		{
+			// the batches are gathered from the shuffled index, the samples are not copied
+			vector<Index> vShuffle;
+			if (_iBatchSizeAdjusted < iNbSamples)
+				vShuffle = randPerm(iNbSamples);
+			// else no need to shuffle
+
+			train_one_epoch(*_pmSamplesTrain, *_pmTruthTrain, vShuffle);
+		}
 
 		_pNet->set_train_mode(false);
 
-		_fTrainLoss =_fOnlineLoss/iNbSamples;
+		_fTrainLoss =_fOnlineLoss/iNbEpochSamples;
         _trainLoss.push_back(_fTrainLoss);
 
         if(_pNet->is_classification_mode())
         {
-			_fTrainAccuracy =100.f*_iOnlineAccuracyGood/ iNbSamples;
+			_fTrainAccuracy =100.f*_iOnlineAccuracyGood/ iNbEpochSamples;
             _trainAccuracy.push_back(_fTrainAccuracy);
         }
 		float fSelectedLoss = _fTrainLoss;
 		float fSelectedAccuracy = _fTrainAccuracy;
 
 		// if having test data, compute stats with it
-        if (_pmSamplesValidation != nullptr)
+        if ((_pmSamplesValidation != nullptr) || (_pValidationStream != nullptr))
         { 	
 			//use the test_db to keep the best model
-			_fValidationLoss =compute_loss_accuracy( *_pmSamplesValidation, *_pmTruthValidation,&_fValidationAccuracy);
+			_fValidationLoss =compute_validation_loss_accuracy(&_fValidationAccuracy);
             _validationLoss.push_back(_fValidationLoss);
             _validationAccuracy.push_back(_fValidationAccuracy);
 
@@ -532,6 +685,8 @@ void NetTrain::fit(Net& rNet)
 				_iCurrentPatience = 0;
 				set_learningrate(get_learningrate() / 2.f);
 				(*_pNet).operator=(bestNet);
+				_pNet->layers()[0]->set_first_layer(true);
+				collect_all_weights_biases(); // the layers are new
 			}
 		}
 
@@ -545,31 +700,63 @@ void NetTrain::fit(Net& rNet)
                 iReboost = 0;
                 for (size_t i = 0; i < _optimizers.size(); i++)
                     _optimizers[i]->init();
+
+				for (size_t i = 0; i < _hogwildWorkers.size(); i++)
+					for (size_t j = 0; j < _hogwildWorkers[i]->optimizers.size(); j++)
+						_hogwildWorkers[i]->optimizers[j]->init();
             }
         }
     }
 
 	if(_bKeepBest)
 		(*_pNet).operator=(bestNet);
+
+	// the memory kept for the next batches is given back, with the copy of the best net
+	bestNet.clear();
+	if (_pAllocator)
+		_pAllocator->release_free_blocks();
 }
 /////////////////////////////////////////////////////////////////////////////////////////////
 void NetTrain::train_batch(const MatrixFloat& mSample, const MatrixFloat& mTruth)
 {
 	assert(_pNet);
 
+	// the temporaries of all batches have the same sizes: the pool reuses the memory of the previous batch
+	MatrixAllocatorScope allocatorScope(_pAllocator);
+
+	if (_iNbShards > 1)
+		train_batch_shards(mSample, mTruth);
+	else
+	{
+		forward_backward(*_pNet, _inOut, _gradient, mSample, mTruth);
+		optimize_weights_biases();
+
+		//compute and save statistics
+		add_online_statistics(_inOut[_iNbLayers], mTruth);
+	}
+
+	if (_pAllocator)
+		_pAllocator->reset();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// compute the gradients of all layers, the outputs are kept in inOut
+void NetTrain::forward_backward(Net& net, vector<MatrixFloat>& inOut, vector<MatrixFloat>& gradient, const MatrixFloat& mSample, const MatrixFloat& mTruth)
+{
 	//forward pass with store
-	_inOut[0] = mSample;
+	inOut[0] = mSample;
 	for (size_t i = 0; i < _iNbLayers; i++)
-		_pNet->layer(i).forward(_inOut[i], _inOut[i + 1]);
+		net.layer(i).forward(inOut[i], inOut[i + 1]);
 
 	//compute error gradient
-	_pLoss->compute_gradient(_inOut[_iNbLayers], mTruth, _gradient[_iNbLayers]);
+	_pLoss->compute_gradient(inOut[_iNbLayers], mTruth, gradient[_iNbLayers]);
 
 	//backward pass
 	for (int i = (int)_iNbLayers - 1; i >= 0; i--)
-		_pNet->layer(i).backpropagation(_inOut[i], _gradient[(size_t)i + 1], _gradient[i]);
-
-	// optimize weights and biases
+		net.layer(i).backpropagation(inOut[i], gradient[(size_t)i + 1], gradient[i]);
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::optimize_weights_biases()
+{
 	Index iNbWeights = _pWeights.size();
 	Index iNbBiases = _pBiases.size();
 	for (int i = 0; i < iNbWeights; i++)
@@ -587,8 +774,183 @@ void NetTrain::train_batch(const MatrixFloat& mSample, const MatrixFloat& mTruth
 		_optimizers[i + iNbWeights]->optimize(*_pBiases[i], *_pGradBiases[i]);
 	}
 
-	//compute and save statistics
-	add_online_statistics(_inOut[_iNbLayers], mTruth);
+	// the layers keeping computations made from their weights compute them again
+	for (size_t i = 0; i < _iNbLayers; i++)
+		_pNet->layer(i).weights_changed();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// each shard computes the gradients of its rows, in parallel, then the gradients are merged in the net in the shards order
+// and the other shards view the updated weights, they are copied only with Eigen
+void NetTrain::train_batch_shards(const MatrixFloat& mSample, const MatrixFloat& mTruth)
+{
+	if (_shards.size() != (size_t)_iNbShards)
+		create_shards();
+
+	Index iNbSamples = mSample.rows();
+	Index iNbShards = min((Index)_iNbShards, iNbSamples); // no empty shard
+	for (Index s = 0; s < iNbShards; s++)
+	{
+		_shards[s]->iStart = s * iNbSamples / iNbShards;
+		_shards[s]->iEnd = (s + 1) * iNbSamples / iNbShards;
+		if (s > 0)
+			_shards[s]->net.set_train_mode(_pNet->is_train_mode());
+	}
+
+	MatrixAllocator* pAllocator = get_matrix_allocator();
+	parallel_for(iNbShards, [&](ptrdiff_t s)
+	{
+		TrainShard& shard = *_shards[s];
+		MatrixAllocatorScope allocatorScope(pAllocator);
+		default_random_engine* pPreviousEngine = setRandomEngine(&shard.randomEngine); // same dropout masks whatever the thread
+
+		auto mShardSample = viewRow(mSample, shard.iStart, shard.iEnd);
+		auto mShardTruth = viewRow(mTruth, shard.iStart, shard.iEnd);
+		forward_backward(s == 0 ? *_pNet : shard.net, shard.inOut, shard.gradient, mShardSample, mShardTruth);
+
+		setRandomEngine(pPreviousEngine);
+	});
+
+	// merge the gradients in the first shard, i.e. in the net, a mean gradient is weighted by the shard size
+	const vector<MatrixFloat*>& pGradParams = _shards[0]->pGradParams;
+	parallel_for((ptrdiff_t)pGradParams.size(), [&](ptrdiff_t iParam)
+	{
+		MatrixFloat& mGradient = *pGradParams[iParam];
+		bool bSum = _bGradientSum[iParam];
+		if (!bSum)
+			mGradient *= (float)_shards[0]->iEnd / iNbSamples;
+
+		for (Index s = 1; s < iNbShards; s++)
+		{
+			const TrainShard& shard = *_shards[s];
+			float fWeight = bSum ? 1.f : (float)(shard.iEnd - shard.iStart) / iNbSamples;
+			mGradient += (*shard.pGradParams[iParam]) * fWeight;
+		}
+	});
+
+	optimize_weights_biases();
+
+#ifdef USE_EIGEN
+	// synchronize the copies of the net, without Eigen they view the weights of the net
+	const vector<MatrixFloat*>& pParams = _shards[0]->pParams;
+	parallel_for((ptrdiff_t)_shards.size() - 1, [&](ptrdiff_t s)
+	{
+		TrainShard& shard = *_shards[s + 1];
+		for (size_t iParam = 0; iParam < pParams.size(); iParam++)
+			*shard.pParams[iParam] = *pParams[iParam];
+	});
+#endif
+
+	//compute and save statistics, on the whole batch
+	for (Index s = 0; s < iNbShards; s++)
+	{
+		const MatrixFloat& mPredicted = _shards[s]->inOut[_iNbLayers];
+		if (s == 0)
+			_mShardsPredicted.resize(iNbSamples, mPredicted.cols());
+		copyInto(mPredicted, _mShardsPredicted, _shards[s]->iStart);
+	}
+	add_online_statistics(_mShardsPredicted, mTruth);
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::create_shards()
+{
+	clear_shards();
+
+	// the first shard is the net itself
+	TrainShard* pShard = new TrainShard;
+	pShard->inOut.resize(_iNbLayers + 1);
+	pShard->gradient.resize(_iNbLayers + 1);
+	pShard->randomEngine.seed(1); // fixed seeds, the shared engine is kept for the shuffles
+	pShard->pParams = _pWeights;
+	pShard->pParams.insert(pShard->pParams.end(), _pBiases.begin(), _pBiases.end());
+	pShard->pGradParams = _pGradWeights;
+	pShard->pGradParams.insert(pShard->pGradParams.end(), _pGradBiases.begin(), _pGradBiases.end());
+	_shards.push_back(pShard);
+
+	for (int s = 1; s < _iNbShards; s++)
+	{
+		TrainShard* pCopy = create_shard_copy((unsigned int)s + 1);
+
+		// the copies read the weights of the net, updated in place by the optimizers: no synchronization after each batch
+		for (size_t iParam = 0; iParam < pCopy->pParams.size(); iParam++)
+		{
+			const MatrixFloat& mParam = *pShard->pParams[iParam];
+			setView(*pCopy->pParams[iParam], mParam.data(), mParam.rows(), mParam.cols());
+		}
+		_shards.push_back(pCopy);
+	}
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// some layers create their weights in their first forward (PRelu, Affine ...): a forward of one sample, out of the train mode, creates them
+// return true if new weights or biases are created, they must then be collected
+bool NetTrain::create_weights(const MatrixFloat& mSamples)
+{
+	if (mSamples.rows() == 0)
+		return false;
+
+	size_t iNbBlobs = 0;
+	for (size_t i = 0; i < _iNbLayers; i++)
+		iNbBlobs += _pNet->layer(i).has_weights() + _pNet->layer(i).has_biases();
+
+	bool bTrainMode = _pNet->is_train_mode();
+	_pNet->set_train_mode(false);
+	vector<MatrixFloat> inOut(_iNbLayers + 1);
+	inOut[0] = viewRow(mSamples, 0, 1);
+	for (size_t i = 0; i < _iNbLayers; i++)
+		_pNet->layer(i).forward(inOut[i], inOut[i + 1]);
+	_pNet->set_train_mode(bTrainMode);
+
+	for (size_t i = 0; i < _iNbLayers; i++)
+		iNbBlobs -= _pNet->layer(i).has_weights() + _pNet->layer(i).has_biases();
+	return iNbBlobs != 0;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+NetTrain::TrainShard* NetTrain::create_shard_copy(unsigned int uiSeed)
+{
+	TrainShard* pShard = new TrainShard;
+	pShard->inOut.resize(_iNbLayers + 1);
+	pShard->gradient.resize(_iNbLayers + 1);
+	pShard->randomEngine.seed(uiSeed);
+
+	// the layers constructors draw their initial weights: keep the shared random sequence as without shards
+	default_random_engine* pPreviousEngine = setRandomEngine(&pShard->randomEngine);
+	pShard->net = *_pNet;
+	setRandomEngine(pPreviousEngine);
+	pShard->net.layer(0).set_first_layer(true);
+
+	vector<MatrixFloat*> pBiases, pGradBiases;
+	for (size_t i = 0; i < _iNbLayers; i++)
+	{
+		Layer& l = pShard->net.layer(i);
+		if (l.has_weights())
+		{
+			vector<MatrixFloat*> vw = l.weights(), vgw = l.gradient_weights();
+			pShard->pParams.insert(pShard->pParams.end(), vw.begin(), vw.end());
+			pShard->pGradParams.insert(pShard->pGradParams.end(), vgw.begin(), vgw.end());
+		}
+		if (l.has_biases())
+		{
+			vector<MatrixFloat*> vb = l.biases(), vgb = l.gradient_biases();
+			pBiases.insert(pBiases.end(), vb.begin(), vb.end());
+			pGradBiases.insert(pGradBiases.end(), vgb.begin(), vgb.end());
+		}
+	}
+	pShard->pParams.insert(pShard->pParams.end(), pBiases.begin(), pBiases.end());
+	pShard->pGradParams.insert(pShard->pGradParams.end(), pGradBiases.begin(), pGradBiases.end());
+	assert(pShard->pParams.size() == _pWeights.size() + _pBiases.size());
+
+	return pShard;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+void NetTrain::clear_shards()
+{
+	for (size_t i = 0; i < _shards.size(); i++)
+		delete _shards[i];
+
+	for (size_t i = 0; i < _hogwildWorkers.size(); i++)
+		delete _hogwildWorkers[i];
+
+	_shards.clear();
+	_hogwildWorkers.clear();
 }
 /////////////////////////////////////////////////////////////////////////////////////////////
 void NetTrain::collect_all_weights_biases()
@@ -597,6 +959,10 @@ void NetTrain::collect_all_weights_biases()
 	_pGradWeights.clear();
 	_pBiases.clear();
 	_pGradBiases.clear();
+	clear_shards(); // the shards copy the weights
+
+	vector<bool> bGradientBiasSum;
+	_bGradientSum.clear();
 	
 	for (size_t i = 0; i < _iNbLayers; i++)
 	{
@@ -608,6 +974,7 @@ void NetTrain::collect_all_weights_biases()
 
 			vector<MatrixFloat*> vgw = l.gradient_weights();
 			_pGradWeights.insert(_pGradWeights.end(), vgw.begin(), vgw.end());
+			_bGradientSum.insert(_bGradientSum.end(), vgw.size(), l.is_gradient_weight_sum());
 		}
 		if (l.has_biases())
 		{
@@ -616,16 +983,25 @@ void NetTrain::collect_all_weights_biases()
 
 			vector<MatrixFloat*> vgb = l.gradient_biases();
 			_pGradBiases.insert(_pGradBiases.end(), vgb.begin(), vgb.end());
+			bGradientBiasSum.insert(bGradientBiasSum.end(), vgb.size(), l.is_gradient_bias_sum());
 		}
 	}
+
+	_bGradientSum.insert(_bGradientSum.end(), bGradientBiasSum.begin(), bGradientBiasSum.end());
 }
 /////////////////////////////////////////////////////////////////////////////////////////////
 void NetTrain::add_online_statistics(const MatrixFloat&mPredicted, const MatrixFloat&mTruth )
+{
+	compute_online_statistics(mPredicted, mTruth, _fOnlineLoss, _iOnlineAccuracyGood);
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// add the loss and the number of good predictions of the batch to fLoss and iAccuracyGood
+void NetTrain::compute_online_statistics(const MatrixFloat& mPredicted, const MatrixFloat& mTruth, float& fLoss, int& iAccuracyGood) const
 {
     //update loss
 	MatrixFloat mLoss;
     _pLoss->compute(mPredicted, mTruth,mLoss);
-	_fOnlineLoss += mLoss.mean();
+	fLoss += mLoss.mean();
 
     if (!_pNet->is_classification_mode())
         return;
@@ -636,7 +1012,7 @@ void NetTrain::add_online_statistics(const MatrixFloat&mPredicted, const MatrixF
         //categorical predicted, categorical truth
         assert(mTruth.cols() == 1);
         for (int i = 0; i < iNbRows; i++)
-            _iOnlineAccuracyGood += (roundf(mPredicted(i)) == mTruth(i));
+            iAccuracyGood += (roundf(mPredicted(i)) == mTruth(i));
     }
     else
     {
@@ -645,14 +1021,14 @@ void NetTrain::add_online_statistics(const MatrixFloat&mPredicted, const MatrixF
         {
             // categorical truth
             for (int i = 0; i < iNbRows; i++)
-                _iOnlineAccuracyGood += (argmax(mPredicted.row(i)) == mTruth(i) );
+                iAccuracyGood += (argmax(mPredicted.row(i)) == mTruth(i) );
         }
         else
         {
             // one hot truth
             assert(mTruth.cols() == mPredicted.cols());
             for (int i = 0; i < iNbRows; i++)
-                _iOnlineAccuracyGood += (argmax(mPredicted.row(i)) == argmax(mTruth.row(i)));
+                iAccuracyGood += (argmax(mPredicted.row(i)) == argmax(mTruth.row(i)));
         }
     }
 }
@@ -697,6 +1073,33 @@ float NetTrain::get_current_train_accuracy() const
 	return _fTrainAccuracy;
 }
 /////////////////////////////////////////////////////////////////////////////////////////////
+// count the samples of each class, vOccurences grows with the classes found
+static void add_class_occurences(const MatrixFloat& mTruth, vector<float>& vOccurences)
+{
+	if (mTruth.cols() != 1)
+	{
+		//convert ot categorical
+		if (vOccurences.size() < (size_t)mTruth.cols())
+			vOccurences.resize((size_t)mTruth.cols(), 0.f);
+		MatrixFloat mCategory;
+
+		rowsArgmax(mTruth, mCategory);
+
+		for (Index i = 0; i < mTruth.rows(); i++)
+			vOccurences[(size_t)mCategory(i)]++;
+	}
+	else
+	{
+		for (Index i = 0; i < mTruth.rows(); i++)
+		{
+			size_t iClass = (size_t)mTruth(i);
+			if (vOccurences.size() <= iClass)
+				vOccurences.resize(iClass + 1, 0.f);
+			vOccurences[iClass]++;
+		}
+	}
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
 void NetTrain::update_class_weight()
 {
 	// do not recompute each time
@@ -708,27 +1111,21 @@ void NetTrain::update_class_weight()
 	}
 	else
 	{
-		//guess the nb of class and compute occurences
-		if (_pmTruthTrain->cols() != 1)
+		//guess the nb of class and compute occurences, shard by shard for a stream
+		vector<float> vOccurences;
+		if (_pTrainStream)
 		{
-			//convert ot categorical
-			int iNbClass = (int)_pmTruthTrain->cols();
-			mClassWeight.setZero(iNbClass, 1);
-			MatrixFloat mCategory;
-
-			rowsArgmax(*_pmTruthTrain, mCategory);
-
-			for (int i = 0; i < _pmTruthTrain->rows(); i++)
-				mClassWeight((int)(mCategory(i)), 0)++;
+			MatrixFloat mSamples, mTruth;
+			for (Index iShard = 0; iShard < _pTrainStream->nb_shards(); iShard++)
+				if (_pTrainStream->read_shard(iShard, mSamples, mTruth))
+					add_class_occurences(mTruth, vOccurences);
 		}
 		else
-		{
-			int iNbClass = (int)_pmTruthTrain->maxCoeff() + 1;
-			mClassWeight.setZero(iNbClass, 1);
+			add_class_occurences(*_pmTruthTrain, vOccurences);
 
-			for (int i = 0; i < _pmTruthTrain->rows(); i++)
-				mClassWeight((int)(_pmTruthTrain->operator()(i)), 0)++;
-		}
+		mClassWeight.setZero((Index)vOccurences.size(), 1);
+		for (size_t i = 0; i < vOccurences.size(); i++)
+			mClassWeight((Index)i, 0) = vOccurences[i];
 
 		mClassWeight *= mClassWeight.rows() / mClassWeight.sum();
 
@@ -739,9 +1136,28 @@ void NetTrain::update_class_weight()
 	_pLoss->set_class_balancing(mClassWeight);
 }
 /////////////////////////////////////////////////////////////////////////////////////////////
-void NetTrain::train_one_epoch(const MatrixFloat& mSampleShuffled, const MatrixFloat& mTruthShuffled)
+// vShuffle is the order of the samples, empty to keep the data order
+void NetTrain::train_one_epoch(const MatrixFloat& mSamples, const MatrixFloat& mTruth, const vector<Index>& vShuffle)
 {
-	Index iNbSamples = mSampleShuffled.rows();
+	if (_bHogwild && (get_nb_threads() > 1))
+	{
+		train_one_epoch_hogwild(mSamples, mTruth, vShuffle);
+		return;
+	}
+
+	if (_iPrefetchBatches > 0)
+	{
+		const MatrixFloat* pSamples;
+		const MatrixFloat* pTruth;
+
+		_pPrefetcher->start(mSamples, mTruth, vShuffle, _iBatchSizeAdjusted, _iPrefetchBatches);
+		while (_pPrefetcher->next(pSamples, pTruth))
+			train_batch(*pSamples, *pTruth);
+		_pPrefetcher->stop();
+		return;
+	}
+
+	Index iNbSamples = mSamples.rows();
 	Index iBatchStart = 0;
 
 	while (iBatchStart < iNbSamples)
@@ -750,12 +1166,211 @@ void NetTrain::train_one_epoch(const MatrixFloat& mSampleShuffled, const MatrixF
 		if (iBatchEnd > iNbSamples)
 			iBatchEnd = iNbSamples;
 
-		auto mSample = viewRow(mSampleShuffled, iBatchStart, iBatchEnd);
-		auto mTarget = viewRow(mTruthShuffled, iBatchStart, iBatchEnd);
-		train_batch(mSample, mTarget);
+		if (vShuffle.empty())
+		{
+			auto mSample = viewRow(mSamples, iBatchStart, iBatchEnd);
+			auto mTarget = viewRow(mTruth, iBatchStart, iBatchEnd);
+			train_batch(mSample, mTarget);
+		}
+		else
+		{
+			gatherRows(vShuffle, iBatchStart, iBatchEnd, mSamples, _mBatchSamples);
+			gatherRows(vShuffle, iBatchStart, iBatchEnd, mTruth, _mBatchTruth);
+			train_batch(_mBatchSamples, _mBatchTruth);
+		}
 
 		iBatchStart = iBatchEnd;
 	}
 }
 /////////////////////////////////////////////////////////////////////////////////////////////
+// shard level shuffle: the shards are read in a random order, batch level shuffle: the samples of each shard are shuffled
+// only one shard is in memory, or two if the next one is read ahead in a thread
+Index NetTrain::train_one_epoch_stream()
+{
+	Index iNbShards = _pTrainStream->nb_shards();
+	vector<Index> vShards(iNbShards);
+	for (Index i = 0; i < iNbShards; i++)
+		vShards[i] = i;
+	if (iNbShards > 1)
+		vShards = randPerm(iNbShards);
+
+	MatrixAllocator* pAllocator = get_matrix_allocator();
+	bool bReadOk[2] = { false, false };
+	auto read_shard = [&](Index i)
+	{
+		MatrixAllocatorScope allocatorScope(pAllocator);
+		bReadOk[i % 2] = _pTrainStream->read_shard(vShards[i], _mShardSamples[i % 2], _mShardTruth[i % 2]);
+	};
+
+	thread reader;
+	Index iNbSamples = 0;
+	for (Index i = 0; i < iNbShards; i++)
+	{
+		if (reader.joinable())
+			reader.join(); // the shard was read ahead
+		else
+			read_shard(i);
+
+		if ((_iPrefetchBatches > 0) && (i + 1 < iNbShards))
+			reader = thread(read_shard, i + 1);
+
+		if (!bReadOk[i % 2])
+			continue;
+
+		const MatrixFloat& mSamples = _mShardSamples[i % 2];
+		const MatrixFloat& mTruth = _mShardTruth[i % 2];
+		assert(mSamples.rows() == mTruth.rows());
+
+		vector<Index> vShuffle;
+		if (_iBatchSizeAdjusted < mSamples.rows())
+			vShuffle = randPerm(mSamples.rows());
+
+		train_one_epoch(mSamples, mTruth, vShuffle);
+		iNbSamples += mSamples.rows();
+	}
+
+	return iNbSamples;
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// relaxed atomic access to a shared weight, as std::atomic_ref<float> in C++20: no lock, no order, but no torn or undefined value
+static inline float load_relaxed(const float* p)
+{
+#if defined(__cpp_lib_atomic_ref)
+	return atomic_ref<const float>(*p).load(memory_order_relaxed);
+#elif defined(__GNUC__)
+	float f;
+	__atomic_load(p, &f, __ATOMIC_RELAXED);
+	return f;
+#else
+	return *(const volatile float*)p; // aligned 32 bits volatile accesses are atomic with MSVC
+#endif
+}
+static inline void store_relaxed(float* p, float f)
+{
+#if defined(__cpp_lib_atomic_ref)
+	atomic_ref<float>(*p).store(f, memory_order_relaxed);
+#elif defined(__GNUC__)
+	__atomic_store(p, &f, __ATOMIC_RELAXED);
+#else
+	*(volatile float*)p = f;
+#endif
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// lock free: another thread can change the same weight between the load and the store, its change is then lost, as in Hogwild!
+static void add_step(MatrixFloat& mShared, const MatrixFloat& mStep)
+{
+	float* pShared = mShared.data();
+	const float* pStep = mStep.data();
+
+	for (Index i = 0; i < mShared.size(); i++)
+	{
+		if (pStep[i] != 0.f) // sparse gradient: the unchanged cache lines are not written
+			store_relaxed(pShared + i, load_relaxed(pShared + i) + pStep[i]);
+	}
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// snapshot of the shared weights for the batch: the layers and the optimizers read it without atomic
+static void copy_relaxed(const MatrixFloat& mShared, MatrixFloat& mCopy)
+{
+	mCopy.resize(mShared.rows(), mShared.cols());
+	const float* pShared = mShared.data();
+	float* pCopy = mCopy.data();
+
+	for (Index i = 0; i < mShared.size(); i++)
+		pCopy[i] = load_relaxed(pShared + i);
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
+// each thread trains its part of the epoch on its copy of the net, with its own optimizers
+// the shared weights are read in the copy before each batch, the optimizers compute their steps from zero, then the steps are added to the shared weights
+void NetTrain::train_one_epoch_hogwild(const MatrixFloat& mSamples, const MatrixFloat& mTruth, const vector<Index>& vShuffle)
+{
+	int iNbWorkers = get_nb_threads();
+	if (_hogwildWorkers.size() != (size_t)iNbWorkers)
+	{
+		clear_shards();
+		for (int w = 0; w < iNbWorkers; w++)
+		{
+			TrainShard* pWorker = create_shard_copy((unsigned int)w + 1);
+			for (size_t i = 0; i < pWorker->pParams.size(); i++)
+			{
+				Optimizer* pOptimizer = create_optimizer(_sOptimizer);
+				pOptimizer->set_params(_fLearningRate, _fDecay, _fMomentum);
+				pOptimizer->init();
+				pWorker->optimizers.push_back(pOptimizer);
+			}
+			pWorker->steps.resize(pWorker->pParams.size());
+			_hogwildWorkers.push_back(pWorker);
+		}
+	}
+
+	vector<MatrixFloat*> pShared = _pWeights;
+	pShared.insert(pShared.end(), _pBiases.begin(), _pBiases.end());
+	for (int w = 0; w < iNbWorkers; w++)
+		_hogwildWorkers[w]->net.set_train_mode(_pNet->is_train_mode());
+
+	Index iNbSamples = mSamples.rows();
+	Index iNbBatches = (iNbSamples + _iBatchSizeAdjusted - 1) / _iBatchSizeAdjusted;
+	MatrixAllocator* pAllocator = get_matrix_allocator();
+
+	parallel_for(iNbWorkers, [&](ptrdiff_t w)
+	{
+		TrainShard& worker = *_hogwildWorkers[w];
+		MatrixAllocatorScope allocatorScope(pAllocator);
+		default_random_engine* pPreviousEngine = setRandomEngine(&worker.randomEngine);
+		worker.fOnlineLoss = 0.f;
+		worker.iOnlineAccuracyGood = 0;
+
+		for (Index iBatch = w * iNbBatches / iNbWorkers; iBatch < (w + 1) * iNbBatches / iNbWorkers; iBatch++)
+		{
+			Index iBatchStart = iBatch * _iBatchSizeAdjusted;
+			Index iBatchEnd = min(iBatchStart + _iBatchSizeAdjusted, iNbSamples);
+
+			for (size_t i = 0; i < pShared.size(); i++)
+				copy_relaxed(*pShared[i], *worker.pParams[i]);
+
+			if (vShuffle.empty())
+			{
+				worker.batchSamples = viewRow(mSamples, iBatchStart, iBatchEnd);
+				worker.batchTruth = viewRow(mTruth, iBatchStart, iBatchEnd);
+			}
+			else
+			{
+				gatherRows(vShuffle, iBatchStart, iBatchEnd, mSamples, worker.batchSamples);
+				gatherRows(vShuffle, iBatchStart, iBatchEnd, mTruth, worker.batchTruth);
+			}
+			const MatrixFloat& mSample = worker.batchSamples;
+			const MatrixFloat& mTarget = worker.batchTruth;
+			forward_backward(worker.net, worker.inOut, worker.gradient, mSample, mTarget);
+
+			for (size_t i = 0; i < pShared.size(); i++)
+			{
+				if (_pRegularizer)
+					_pRegularizer->apply(*worker.pParams[i], *worker.pGradParams[i]);
+
+				// the weights decay of AdamW, relative to the weights, is not in the step
+				MatrixFloat& mStep = worker.steps[i];
+				mStep.setZero(pShared[i]->rows(), pShared[i]->cols());
+				worker.optimizers[i]->optimize(mStep, *worker.pGradParams[i]);
+				add_step(*pShared[i], mStep);
+			}
+
+			compute_online_statistics(worker.inOut[_iNbLayers], mTarget, worker.fOnlineLoss, worker.iOnlineAccuracyGood);
+		}
+
+		setRandomEngine(pPreviousEngine);
+	});
+
+	for (int w = 0; w < iNbWorkers; w++)
+	{
+		_fOnlineLoss += _hogwildWorkers[w]->fOnlineLoss;
+		_iOnlineAccuracyGood += _hogwildWorkers[w]->iOnlineAccuracyGood;
+	}
+
+	for (size_t i = 0; i < _iNbLayers; i++)
+		_pNet->layer(i).weights_changed();
+
+	if (_pAllocator)
+		_pAllocator->reset();
+}
+/////////////////////////////////////////////////////////////////////////////////////////////
 }
@@ -17,6 +17,9 @@
 namespace beednn {
 
 class Optimizer;
+class MatrixAllocator;
+class BatchPrefetcher;
+class DataStream;
 class Loss;
 class Regularizer;
 class Net;
@@ -33,6 +36,12 @@ public:
     void set_train_data(const MatrixFloat& mSamples, const MatrixFloat& mTruth);
 	void set_validation_data(const MatrixFloat& mSamplesValidation, const MatrixFloat& mTruthValidation);
 
+	// train on a stream read shard by shard, for the datasets bigger than the memory, instead of set_train_data()
+	// each epoch reads the shards in a random order and shuffles the samples inside each shard, the batches do not cross the shards
+	// with set_prefetch_batches(), the next shard is also read in a thread while the current one trains
+	void set_train_stream(DataStream* pStream); // not owned, nullptr to use set_train_data()
+	void set_validation_stream(DataStream* pStream); // not owned, nullptr to use set_validation_data()
+
 	void set_epochs(int iEpochs); //100 by default
 	int get_epochs() const;
 
@@ -79,9 +88,34 @@ public:
 	void set_validation_batchsize(Index iValBatchSize);
 	Index get_validation_batchsize() const;
 
+	// allocator of the matrices created during the training, reset at the end of each batch, its free blocks are released at the end of fit()
+	// MatrixPoolAllocator::instance() by default: no system allocation once the first batch is done, nullptr keeps the thread allocator
+	void set_allocator(MatrixAllocator* pAllocator);
+	MatrixAllocator* get_allocator() const;
+
+	// data parallel training: each batch is cut in iNbShards parts, trained at once in the threads of set_nb_threads(), on copies of the net viewing its weights
+	// the gradients of the parts are merged in a fixed order: the result depends on the number of shards, not on the number of threads
+	void set_nb_shards(int iNbShards); // 1 by default: no copy of the net
+	int get_nb_shards() const;
+
+	// asynchronous training (Hogwild!): the threads of set_nb_threads() train at once on their own part of the epoch
+	// before each batch, each thread reads the shared weights in its copy of the net with relaxed atomic loads
+	// then it adds the steps of its own optimizers to the shared weights, with relaxed atomic stores but without lock
+	// a change made by another thread between the load and the store of a weight is lost, sparse changes rarely collide
+	// the result depends on the threads scheduling, false by default
+	void set_hogwild(bool bHogwild);
+	bool get_hogwild() const;
+
+	// the next batches are gathered in a dedicated thread while the current one trains, not used by the hogwild training
+	void set_prefetch_batches(int iNbBatches); // number of batches ready in advance, 0 by default: no prefetch thread
+	int get_prefetch_batches() const;
+	float get_prefetch_stall_time() const; // seconds the training waited for a batch, during the last fit()
+	float get_prefetch_queue_depth() const; // mean number of batches ready when the training takes one, during the last fit()
+
 	void fit(Net& rNet);
 
 	float compute_loss_accuracy(const MatrixFloat & mSamples, const MatrixFloat& mTruth,float* pfAccuracy = nullptr) const;
+	float compute_loss_accuracy(DataStream& stream, float* pfAccuracy = nullptr) const; // shard by shard
 
 	const std::vector<float>& get_train_loss() const;
 	const std::vector<float>& get_validation_loss() const;
@@ -96,23 +130,38 @@ public:
 	virtual void train_batch(const MatrixFloat& mSample, const MatrixFloat& mTruth); //all the backprop is here	
 
 protected:
-	virtual void train_one_epoch(const MatrixFloat& mSampleShuffled, const MatrixFloat& mTruthShuffled);
+	virtual void train_one_epoch(const MatrixFloat& mSamples, const MatrixFloat& mTruth, const std::vector<Index>& vShuffle);
 	void add_online_statistics(const MatrixFloat&mPredicted, const MatrixFloat&mTruth);	//online statistics, i.e. loss, accuracy ..
+	void compute_online_statistics(const MatrixFloat& mPredicted, const MatrixFloat& mTruth, float& fLoss, int& iAccuracyGood) const;
 	Index _iBatchSize,_iBatchSizeAdjusted;
 	Loss* _pLoss;
 	Regularizer* _pRegularizer;
 	std::vector<Optimizer*> _optimizers;
 	std::vector<MatrixFloat> _inOut;
 	std::vector<MatrixFloat> _gradient;
+	MatrixFloat _mBatchSamples, _mBatchTruth; // gathered from the shuffled samples, reused from batch to batch
 	size_t _iNbLayers;
 
 private:
+	struct TrainShard;
+
 	void set_net(Net& model);
 	void collect_all_weights_biases();
+	void forward_backward(Net& net, std::vector<MatrixFloat>& inOut, std::vector<MatrixFloat>& gradient, const MatrixFloat& mSample, const MatrixFloat& mTruth);
+	void optimize_weights_biases();
+	void train_batch_shards(const MatrixFloat& mSample, const MatrixFloat& mTruth);
+	void create_shards();
+	bool create_weights(const MatrixFloat& mSamples); // of the layers creating them in their first forward, true if new ones
+	TrainShard* create_shard_copy(unsigned int uiSeed);
+	void clear_shards();
+	Index train_one_epoch_stream(); // return the number of samples trained
+	void train_one_epoch_hogwild(const MatrixFloat& mSamples, const MatrixFloat& mTruth, const std::vector<Index>& vShuffle);
+	float compute_validation_loss_accuracy(float* pfAccuracy) const; // on the validation data or stream
 	void update_class_weight(); // compute balanced class weight loss (if asked) and update loss
 	void clear_optimizers();
 
 	Net* _pNet;
+	MatrixAllocator* _pAllocator;
 	int _iOnlineAccuracyGood;
 	float _fOnlineLoss;
 
@@ -131,9 +180,12 @@ private:
 
     const MatrixFloat* _pmSamplesTrain;
     const MatrixFloat* _pmTruthTrain;
+	DataStream* _pTrainStream;
+	MatrixFloat _mShardSamples[2], _mShardTruth[2]; // the shard in training and the shard read ahead
 
 	const MatrixFloat* _pmSamplesValidation;
 	const MatrixFloat* _pmTruthValidation;
+	DataStream* _pValidationStream;
 
 	std::function<void()> _epochCallBack;
 
@@ -147,6 +199,16 @@ private:
 	std::vector<MatrixFloat*> _pGradWeights;
 	std::vector<MatrixFloat*> _pBiases;
 	std::vector<MatrixFloat*> _pGradBiases;
+	std::vector<bool> _bGradientSum; // for all weights then all biases, see Layer::is_gradient_weight_sum()
+
+	int _iNbShards;
+	std::vector<TrainShard*> _shards; // the first one trains the net itself
+	bool _bHogwild;
+	std::vector<TrainShard*> _hogwildWorkers; // all are copies of the net
+	MatrixFloat _mShardsPredicted;
+
+	int _iPrefetchBatches;
+	BatchPrefetcher* _pPrefetcher;
 
 	float _fTrainLoss;
 	float _fTrainAccuracy;
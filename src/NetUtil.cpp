@@ -11,6 +11,7 @@
 #include "NetTrain.h"
 #include "Layer.h"
 #include "Matrix.h"
+#include "Activations.h"
 
 #include "LayerActivation.h"
 #include "LayerChannelBias.h"
@@ -39,7 +40,12 @@
 #include "LayerSimplestRNN.h"
 
 #include "JsonFile.h"
+#include "MappedFile.h"
 
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <string>
 #include <sstream>
 
@@ -47,6 +53,158 @@ using namespace std;
 namespace beednn {
 
 namespace NetUtil {
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	struct LayerParam
+	{
+		string sName;
+		float fValue;
+		bool bInteger;
+	};
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	static void add_param(vector<LayerParam>& params, const string& sName, float fValue, bool bInteger = true)
+	{
+		params.push_back({ sName, fValue, bInteger });
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	// parameters of the layer constructor, false if the layer can not be created again from its type and these parameters
+	static bool layer_params(const Layer& layer, vector<LayerParam>& params)
+	{
+		const string& sType = layer.type();
+
+		if (sType == "Dense")
+		{
+			auto l = static_cast<const LayerDense*>(&layer);
+			add_param(params, "InputSize", (float)l->input_size());
+			add_param(params, "OutputSize", (float)l->output_size());
+		}
+
+		else if (sType == "Dot")
+		{
+			auto l = static_cast<const LayerDot*>(&layer);
+			add_param(params, "InputSize", (float)l->input_size());
+			add_param(params, "OutputSize", (float)l->output_size());
+		}
+
+		else if (sType == "ChannelBias")
+		{
+			auto l = static_cast<const LayerChannelBias*>(&layer);
+
+			Index iRows, iCols, iChannels;
+			l->get_params(iRows, iCols, iChannels);
+
+			add_param(params, "Rows", (float)iRows);
+			add_param(params, "Cols", (float)iCols);
+			add_param(params, "Channels", (float)iChannels);
+		}
+
+		else if (sType == "Dropout")
+		{
+			auto l = static_cast<const LayerDropout*>(&layer);
+			add_param(params, "Rate", l->get_rate(), false);
+		}
+
+		else if (sType == "RRelu")
+		{
+			auto l = static_cast<const LayerRRelu*>(&layer);
+			float alpha1, alpha2;
+			l->get_params(alpha1, alpha2);
+			add_param(params, "Alpha1", alpha1, false);
+			add_param(params, "Alpha2", alpha2, false);
+		}
+
+		else if (sType == "GaussianNoise")
+		{
+			auto l = static_cast<const LayerGaussianNoise*>(&layer);
+			add_param(params, "Noise", l->get_noise(), false);
+		}
+		else if (sType == "UniformNoise")
+		{
+			auto l = static_cast<const LayerUniformNoise*>(&layer);
+			add_param(params, "Noise", l->get_noise(), false);
+		}
+		else if (sType == "MaxPool2D")
+		{
+			auto l = static_cast<const LayerMaxPool2D*>(&layer);
+
+			Index inRows, inCols, iChannels, rowFactor, colFactor;
+			l->get_params(inRows, inCols, iChannels, rowFactor, colFactor);
+
+			add_param(params, "InRows", (float)inRows);
+			add_param(params, "InCols", (float)inCols);
+			add_param(params, "Channels", (float)iChannels);
+			add_param(params, "RowFactor", (float)rowFactor);
+			add_param(params, "ColFactor", (float)colFactor);
+		}
+
+		else if (sType == "GlobalMaxPool2D")
+		{
+			auto l = static_cast<const LayerGlobalMaxPool2D*>(&layer);
+
+			Index inRows, inCols, iChannels;
+			l->get_params(inRows, inCols, iChannels);
+
+			add_param(params, "InRows", (float)inRows);
+			add_param(params, "InCols", (float)inCols);
+			add_param(params, "Channels", (float)iChannels);
+		}
+
+		else if (sType == "Convolution2D")
+		{
+			auto l = static_cast<const LayerConvolution2D*>(&layer);
+
+			Index inRows, inCols, inChannels, kernelRows, kernelCols, outChannels, rowStride, colStride, rowPadding, colPadding, rowDilation, colDilation;
+			l->get_params(inRows, inCols, inChannels, kernelRows, kernelCols, outChannels, rowStride, colStride);
+			l->get_padding(rowPadding, colPadding);
+			l->get_dilation(rowDilation, colDilation);
+
+			add_param(params, "InRows", (float)inRows);
+			add_param(params, "InCols", (float)inCols);
+			add_param(params, "InChannels", (float)inChannels);
+			add_param(params, "KernelRows", (float)kernelRows);
+			add_param(params, "KernelCols", (float)kernelCols);
+			add_param(params, "RowStride", (float)rowStride);
+			add_param(params, "ColStride", (float)colStride);
+			add_param(params, "RowPadding", (float)rowPadding);
+			add_param(params, "ColPadding", (float)colPadding);
+			add_param(params, "RowDilation", (float)rowDilation);
+			add_param(params, "ColDilation", (float)colDilation);
+			add_param(params, "OutChannels", (float)outChannels);
+		}
+
+		else if (sType == "TimeDistributedBias")
+		{
+			auto l = static_cast<const LayerTimeDistributedBias*>(&layer);
+			add_param(params, "FrameSize", (float)l->frame_size());
+		}
+
+		else if (sType == "TimeDistributedDot")
+		{
+			auto l = static_cast<const LayerTimeDistributedDot*>(&layer);
+			add_param(params, "InFrameSize", (float)l->in_frame_size());
+			add_param(params, "OutFrameSize", (float)l->out_frame_size());
+		}
+
+		else if (sType == "TimeDistributedDense")
+		{
+			auto l = static_cast<const LayerTimeDistributedDense*>(&layer);
+			add_param(params, "InFrameSize", (float)l->in_frame_size());
+			add_param(params, "OutFrameSize", (float)l->out_frame_size());
+		}
+
+		else if (sType == "SimplestRNN")
+		{
+			//LayerSimplestRNN* l = static_cast<LayerSimplestRNN*>(layer);
+			//TODO
+			return false;
+		}
+
+		// layers without parameters
+		else if ((sType != "Gain") && (sType != "Bias") && (sType != "Affine") && (sType != "GlobalGain") && (sType != "GlobalBias") && (sType != "GlobalAffine")
+			&& (sType != "PRelu") && (sType != "CRelu") && (sType != "Softmax") && (sType != "Softmin") && (dynamic_cast<const LayerActivation*>(&layer) == nullptr))
+			return false;
+
+		return true;
+	}
 	/////////////////////////////////////////////////////////////////////////////////////////////////
 	void save(const string& sFile,const Net& model, const NetTrain& trainParams)
 	{
@@ -107,130 +265,362 @@ namespace NetUtil {
 					jf.add_array("Bias_" + to_string(j), (int)pB[j]->size(), pB[j]->data());
 			}
 
-			if (layer->type() == "Dense")
-			{
-				auto l = static_cast<const LayerDense*>(layer);
-				jf.add("InputSize", (int)l->input_size());
-				jf.add("OutputSize", (int)l->output_size());
-			}
-
-			if (layer->type() == "Dot")
+			vector<LayerParam> params;
+			layer_params(*layer, params);
+			for (size_t j = 0; j < params.size(); j++)
 			{
-				auto l = static_cast<const LayerDense*>(layer);
-				jf.add("InputSize", (int)l->input_size());
-				jf.add("OutputSize", (int)l->output_size());
+				if (params[j].bInteger)
+					jf.add(params[j].sName, (int)params[j].fValue);
+				else
+					jf.add(params[j].sName, params[j].fValue);
 			}
 
-			else if (layer->type() == "ChannelBias")
-			{
-				auto l = static_cast<const LayerChannelBias*>(layer);
+			jf.leave_section();
+		}
 
-				Index iRows, iCols, iChannels;
-				l->get_params(iRows, iCols, iChannels);
+		jf.save(sFile);
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	// binary model: the header, the layers graph, then the weights and biases, each 64 bytes aligned
+	// the numbers are little endian, as on x86 and ARM
+	struct ModelHeader
+	{
+		char magic[8]; // "BEEDNNM"
+		uint32_t uiVersion; // 1
+		uint32_t uiNbLayers;
+		uint32_t uiClassification;
+		uint32_t uiReserved;
+		uint64_t uiGraphBytes; // the graph follows the header
+		uint64_t uiDataOffset; // first weight, from the start of the file
+		char reserved[24];
+	};
+	static_assert(sizeof(ModelHeader) == 64, "the model header is 64 bytes");
+
+	static const char g_modelMagic[8] = { 'B', 'E', 'E', 'D', 'N', 'N', 'M', 0 };
+	static const uint64_t g_uiAlignment = 64;
 
-				jf.add("Rows", (int)iRows);
-				jf.add("Cols", (int)iCols);
-				jf.add("Channels", (int)iChannels);
-			}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	static uint64_t aligned_size(uint64_t uiBytes)
+	{
+		return (uiBytes + g_uiAlignment - 1) / g_uiAlignment * g_uiAlignment;
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	template <class T>
+	static void append(vector<char>& graph, T value)
+	{
+		const char* p = (const char*)&value;
+		graph.insert(graph.end(), p, p + sizeof(T));
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	static void append(vector<char>& graph, const string& s)
+	{
+		append(graph, (uint32_t)s.size());
+		graph.insert(graph.end(), s.begin(), s.end());
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	// the graph read with bounds checks, bOk is false after a read out of the graph
+	struct GraphReader
+	{
+		const unsigned char* p;
+		const unsigned char* pEnd;
+		bool bOk;
 
-			else if (layer->type() == "Dropout")
+		template <class T>
+		T read()
+		{
+			T value = T();
+			if ((size_t)(pEnd - p) < sizeof(T))
+				bOk = false;
+			else
 			{
-				auto l = static_cast<const LayerDropout*>(layer);
-				jf.add("Rate", l->get_rate());
+				memcpy(&value, p, sizeof(T));
+				p += sizeof(T);
 			}
+			return value;
+		}
 
-			else if (layer->type() == "RRelu")
+		string read_string()
+		{
+			uint32_t uiSize = read<uint32_t>();
+			if ((size_t)(pEnd - p) < uiSize)
 			{
-				auto l = static_cast<const LayerRRelu*>(layer);
-				float alpha1, alpha2;
-				l->get_params(alpha1, alpha2);
-				jf.add("Alpha1", alpha1);
-				jf.add("Alpha2", alpha2);
+				bOk = false;
+				return string();
 			}
 
-			else if (layer->type() == "GaussianNoise")
-			{
-				auto l = static_cast<const LayerGaussianNoise*>(layer);
-				jf.add("Noise", l->get_noise());
-			}
-			else if (layer->type() == "UniformNoise")
-			{
-				auto l = static_cast<const LayerUniformNoise*>(layer);
-				jf.add("Noise", l->get_noise());
-			}
-			else if (layer->type() == "MaxPool2D")
-			{
-				auto l = static_cast<const LayerMaxPool2D*>(layer);
+			string s((const char*)p, uiSize);
+			p += uiSize;
+			return s;
+		}
+	};
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	static float find_param(const vector<LayerParam>& params, const string& sName)
+	{
+		for (size_t i = 0; i < params.size(); i++)
+			if (params[i].sName == sName)
+				return params[i].fValue;
 
-				Index inRows, inCols, iChannels, rowFactor, colFactor;
-				l->get_params(inRows, inCols, iChannels, rowFactor, colFactor);
+		return 0.f;
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	// the layer from its type and the parameters of layer_params()
+	static Layer* create_layer(const string& sType, const vector<LayerParam>& params)
+	{
+		auto param = [&](const string& sName) { return find_param(params, sName); };
+		auto iparam = [&](const string& sName) { return (Index)find_param(params, sName); };
 
-				jf.add("InRows", (int)inRows);
-				jf.add("InCols", (int)inCols);
-				jf.add("Channels", (int)iChannels);
-				jf.add("RowFactor", (int)rowFactor);
-				jf.add("ColFactor", (int)colFactor);
-			}
+		if (sType == "Dense")
+			return new LayerDense(iparam("InputSize"), iparam("OutputSize"));
 
-			else if (layer->type() == "GlobalMaxPool2D")
-			{
-				auto l = static_cast<const LayerGlobalMaxPool2D*>(layer);
+		if (sType == "Dot")
+			return new LayerDot(iparam("InputSize"), iparam("OutputSize"));
 
-				Index inRows, inCols, iChannels;
-				l->get_params(inRows, inCols, iChannels);
+		if (sType == "ChannelBias")
+			return new LayerChannelBias(iparam("Rows"), iparam("Cols"), iparam("Channels"));
 
-				jf.add("InRows", (int)inRows);
-				jf.add("InCols", (int)inCols);
-				jf.add("Channels", (int)iChannels);
-			}
+		if (sType == "Dropout")
+			return new LayerDropout(param("Rate"));
+
+		if (sType == "RRelu")
+			return new LayerRRelu(param("Alpha1"), param("Alpha2"));
+
+		if (sType == "GaussianNoise")
+			return new LayerGaussianNoise(param("Noise"));
+
+		if (sType == "UniformNoise")
+			return new LayerUniformNoise(param("Noise"));
+
+		if (sType == "MaxPool2D")
+			return new LayerMaxPool2D(iparam("InRows"), iparam("InCols"), iparam("Channels"), iparam("RowFactor"), iparam("ColFactor"));
+
+		if (sType == "GlobalMaxPool2D")
+			return new LayerGlobalMaxPool2D(iparam("InRows"), iparam("InCols"), iparam("Channels"));
+
+		if (sType == "Convolution2D") // the models saved before the padding and the dilation have no padding and a dilation of 1
+			return new LayerConvolution2D(iparam("InRows"), iparam("InCols"), iparam("InChannels"), iparam("KernelRows"), iparam("KernelCols"), iparam("OutChannels"), iparam("RowStride"), iparam("ColStride"),
+				iparam("RowPadding"), iparam("ColPadding"), max<Index>(iparam("RowDilation"), 1), max<Index>(iparam("ColDilation"), 1));
+
+		if (sType == "TimeDistributedBias")
+			return new LayerTimeDistributedBias((int)iparam("FrameSize"));
+
+		if (sType == "TimeDistributedDot")
+			return new LayerTimeDistributedDot((int)iparam("InFrameSize"), (int)iparam("OutFrameSize"));
+
+		if (sType == "TimeDistributedDense")
+			return new LayerTimeDistributedDense((int)iparam("InFrameSize"), (int)iparam("OutFrameSize"));
+
+		if (sType == "Gain")
+			return new LayerGain();
+
+		if (sType == "Bias")
+			return new LayerBias();
 
-			else if (layer->type() == "Convolution2D")
+		if (sType == "Affine")
+			return new LayerAffine();
+
+		if (sType == "GlobalGain")
+			return new LayerGlobalGain();
+
+		if (sType == "GlobalBias")
+			return new LayerGlobalBias();
+
+		if (sType == "GlobalAffine")
+			return new LayerGlobalAffine();
+
+		if (sType == "PRelu")
+			return new LayerPRelu();
+
+		if (sType == "CRelu")
+			return new LayerCRelu();
+
+		if (sType == "Softmax")
+			return new LayerSoftmax();
+
+		if (sType == "Softmin")
+			return new LayerSoftmin();
+
+		// else an activation, nullptr if the type is unknown
+		Activation* pActivation = get_activation(sType);
+		if (pActivation == nullptr)
+			return nullptr;
+		delete pActivation;
+
+		return new LayerActivation(sType);
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	bool save_binary(const string& sFile, const Net& model)
+	{
+		auto layers = model.layers();
+
+		// the graph, with the offsets of the weights from the first weight
+		vector<char> graph;
+		vector<const MatrixFloat*> blobs;
+		uint64_t uiBlobOffset = 0;
+
+		for (size_t i = 0; i < layers.size(); i++)
+		{
+			Layer* layer = layers[i];
+
+			vector<LayerParam> params;
+			if (!layer_params(*layer, params))
+				return false;
+
+			append(graph, layer->type());
+			append(graph, (uint32_t)params.size());
+			for (size_t j = 0; j < params.size(); j++)
 			{
-				auto l = static_cast<const LayerConvolution2D*>(layer);
-
-				Index inRows, inCols, inChannels, kernelRows, kernelCols, outChannels, rowStride, colStride;
-				l->get_params(inRows, inCols, inChannels, kernelRows, kernelCols, outChannels, rowStride, colStride);
-
-				jf.add("InRows", (int)inRows);
-				jf.add("InCols", (int)inCols);
-				jf.add("InChannels", (int)inChannels);
-				jf.add("KernelRows", (int)kernelRows);
-				jf.add("KernelCols", (int)kernelCols);
-				jf.add("RowStride", (int)rowStride);
-				jf.add("ColStride", (int)colStride);
-				jf.add("OutChannels", (int)outChannels);
+				append(graph, params[j].sName);
+				append(graph, params[j].fValue);
 			}
 
-			else if (layer->type() == "TimeDistributedBias")
+			// kind 0 for the weights, 1 for the biases, the empty matrices are not saved
+			vector<MatrixFloat*> pW = layer->weights();
+			vector<MatrixFloat*> pB = layer->biases();
+			vector<pair<uint32_t, uint32_t>> vBlobs;
+			for (size_t j = 0; j < pW.size(); j++)
+				if (pW[j]->size() != 0)
+					vBlobs.push_back({ 0, (uint32_t)j });
+			for (size_t j = 0; j < pB.size(); j++)
+				if (pB[j]->size() != 0)
+					vBlobs.push_back({ 1, (uint32_t)j });
+
+			append(graph, (uint32_t)vBlobs.size());
+			for (size_t j = 0; j < vBlobs.size(); j++)
 			{
-				auto l = static_cast<const LayerTimeDistributedBias*>(layer);
-				jf.add("FrameSize", l->frame_size());
+				const MatrixFloat* pBlob = vBlobs[j].first == 0 ? pW[vBlobs[j].second] : pB[vBlobs[j].second];
+				append(graph, vBlobs[j].first);
+				append(graph, vBlobs[j].second);
+				append(graph, (uint64_t)pBlob->rows());
+				append(graph, (uint64_t)pBlob->cols());
+				append(graph, uiBlobOffset);
+
+				blobs.push_back(pBlob);
+				uiBlobOffset += aligned_size(pBlob->size() * sizeof(float));
 			}
+		}
 
-			else if (layer->type() == "TimeDistributedDot")
+		ModelHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, g_modelMagic, sizeof(g_modelMagic));
+		header.uiVersion = 1;
+		header.uiNbLayers = (uint32_t)layers.size();
+		header.uiClassification = model.is_classification_mode() ? 1 : 0;
+		header.uiGraphBytes = graph.size();
+		header.uiDataOffset = aligned_size(sizeof(header) + graph.size());
+
+		ofstream f(sFile, ios::binary | ios::out | ios::trunc);
+		const char padding[g_uiAlignment] = { 0 };
+		f.write((const char*)&header, sizeof(header));
+		f.write(graph.data(), (streamsize)graph.size());
+		f.write(padding, (streamsize)(header.uiDataOffset - sizeof(header) - graph.size()));
+
+		for (size_t i = 0; i < blobs.size(); i++)
+		{
+			uint64_t uiBytes = blobs[i]->size() * sizeof(float);
+			f.write((const char*)blobs[i]->data(), (streamsize)uiBytes);
+			f.write(padding, (streamsize)(aligned_size(uiBytes) - uiBytes));
+		}
+
+		f.close();
+		return !f.fail();
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////
+	bool load(const string& sFile, Net& model, bool bMapWeights)
+	{
+		model.clear();
+
+		// copy on write: the weights can be trained, the written pages are copied, the file is not modified
+		shared_ptr<MappedFile> pFile = make_shared<MappedFile>();
+		if (!pFile->open(sFile, bMapWeights))
+			return false;
+
+		ModelHeader header;
+		if (pFile->size() < sizeof(header))
+			return false;
+		memcpy(&header, pFile->data(), sizeof(header));
+
+		if ((memcmp(header.magic, g_modelMagic, sizeof(g_modelMagic)) != 0) || (header.uiVersion != 1)
+			|| (header.uiGraphBytes > pFile->size() - sizeof(header)) || (header.uiDataOffset > pFile->size())
+			|| (header.uiDataOffset % g_uiAlignment != 0)) // the mapped weights keep the alignment of the matrix data
+			return false;
+
+		const unsigned char* pData = bMapWeights ? pFile->writable_data() : pFile->data();
+		GraphReader reader = { pData + sizeof(header), pData + sizeof(header) + header.uiGraphBytes, true };
+		uint64_t uiDataBytes = pFile->size() - header.uiDataOffset;
+
+		vector<Layer*> layers;
+		bool bOk = true;
+		for (uint32_t i = 0; bOk && (i < header.uiNbLayers); i++)
+		{
+			string sType = reader.read_string();
+			uint32_t uiNbParams = reader.read<uint32_t>();
+			vector<LayerParam> params;
+			for (uint32_t j = 0; reader.bOk && (j < uiNbParams); j++)
 			{
-				auto l = static_cast<const LayerTimeDistributedDot*>(layer);
-				jf.add("InFrameSize", l->in_frame_size());
-				jf.add("OutFrameSize", l->out_frame_size());
+				string sName = reader.read_string();
+				float fValue = reader.read<float>();
+				add_param(params, sName, fValue);
 			}
+			if (!reader.bOk)
+				break;
 
-			else if (layer->type() == "TimeDistributedDense")
+			Layer* layer = create_layer(sType, params);
+			if (layer == nullptr)
 			{
-				auto l = static_cast<const LayerTimeDistributedDense*>(layer);
-				jf.add("InFrameSize", l->in_frame_size());
-				jf.add("OutFrameSize", l->out_frame_size());
+				bOk = false;
+				break;
 			}
+			layers.push_back(layer);
 
-			else if (layer->type() == "SimplestRNN")
+			vector<MatrixFloat*> pW = layer->weights();
+			vector<MatrixFloat*> pB = layer->biases();
+			uint32_t uiNbBlobs = reader.read<uint32_t>();
+			for (uint32_t j = 0; bOk && reader.bOk && (j < uiNbBlobs); j++)
 			{
-				//LayerSimplestRNN* l = static_cast<LayerSimplestRNN*>(layer);
-				//TODO
+				uint32_t uiKind = reader.read<uint32_t>();
+				uint32_t uiIndex = reader.read<uint32_t>();
+				uint64_t uiRows = reader.read<uint64_t>();
+				uint64_t uiCols = reader.read<uint64_t>();
+				uint64_t uiOffset = reader.read<uint64_t>();
+
+				vector<MatrixFloat*>& pBlobs = uiKind == 0 ? pW : pB;
+				bOk = reader.bOk && (uiKind <= 1) && (uiIndex < pBlobs.size()) && (uiCols != 0) && (uiOffset % g_uiAlignment == 0)
+					&& (uiOffset <= uiDataBytes) && (uiRows <= (uiDataBytes - uiOffset) / sizeof(float) / uiCols);
+				if (!bOk)
+					break;
+
+				// the layer creates its weights, or not if they are initialized on the first forward
+				MatrixFloat& m = *pBlobs[uiIndex];
+				if ((m.size() != 0) && ((m.rows() != (Index)uiRows) || (m.cols() != (Index)uiCols)))
+				{
+					bOk = false;
+					break;
+				}
+
+				const float* pBlob = (const float*)(pData + header.uiDataOffset + uiOffset);
+				if (bMapWeights)
+					setView(m, pBlob, (Index)uiRows, (Index)uiCols);
+				else
+					m = fromRawBuffer(pBlob, (Index)uiRows, (Index)uiCols);
 			}
+			bOk = bOk && reader.bOk;
+		}
 
-			jf.leave_section();
+		if (!bOk || !reader.bOk || (layers.size() != header.uiNbLayers))
+		{
+			for (size_t i = 0; i < layers.size(); i++)
+				delete layers[i];
+			return false;
 		}
 
-		jf.save(sFile);
+		for (size_t i = 0; i < layers.size(); i++)
+			model.add(layers[i]);
+		model.set_classification_mode(header.uiClassification != 0);
+
+		if (bMapWeights)
+			model.set_weights_keepalive(pFile);
+
+		return true;
 	}
 	/////////////////////////////////////////////////////////////////////////////////////////////////
 }
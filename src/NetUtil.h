@@ -17,6 +17,15 @@ namespace NetUtil {
 
     void save(const std::string& sFile, const beednn::Net& model, const beednn::NetTrain& trainParams);
 
+    // compact binary model: a header with the layers graph, then the weights and biases 64 bytes aligned
+    // false if a layer can not be created again from its saved parameters
+    bool save_binary(const std::string& sFile, const beednn::Net& model);
+
+    // read a model written by save_binary(), false if the file is not valid
+    // bMapWeights: the weights are viewed in the mapped file without copy, copied on write, the net keeps the file mapped until clear()
+    // this is immediate whatever the model size (copied with Eigen), else the weights are copied
+    bool load(const std::string& sFile, beednn::Net& model, bool bMapWeights = true);
+
     //void read(const string& s,Net& net);
     //void write(const NetTrain& train,string& s);
     //void read(const string& s,NetTrain& train);
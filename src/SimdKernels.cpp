@@ -0,0 +1,454 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#include "SimdKernels.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define BEEDNN_SIMD_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+using namespace std;
+namespace beednn {
+
+// exp(): cephes expf range reduction and polynomial
+// the power of two is a float exponent: 127 at most, and 0 under -126, so the results under 1.2e-38 (x < -87.7) are flushed to 0, not denormal
+#define EXP_HI 88.3762626647949f
+#define EXP_LO -88.3762626647949f
+#define EXP_N_MAX 127.f // exp(EXP_HI) would round to 2^128, infinite
+#define EXP_LOG2E 1.44269504088896341f
+#define EXP_C1 0.693359375f
+#define EXP_C2 -2.12194440e-4f
+#define EXP_P0 1.9875691500e-4f
+#define EXP_P1 1.3981999507e-3f
+#define EXP_P2 8.3334519073e-3f
+#define EXP_P3 4.1665795894e-2f
+#define EXP_P4 1.6666665459e-1f
+#define EXP_P5 5.0000001201e-1f
+
+// tanh(): cephes tanhf polynomial under TANH_SMALL, exp() above
+#define TANH_SMALL 0.625f
+#define TANH_P0 -5.70498872745e-3f
+#define TANH_P1 2.06390887954e-2f
+#define TANH_P2 -5.37397155531e-2f
+#define TANH_P3 1.33314422036e-1f
+#define TANH_P4 -3.33332819422e-1f
+
+#define SUM_LANES 16 // number of partial sums, the biggest vector size, so all levels add in the same order
+
+///////////////////////////////////////////////////////////////////////////
+static inline float scalar_max(float a, float b)
+{
+	return (b > a) ? b : a;
+}
+///////////////////////////////////////////////////////////////////////////
+static inline float scalar_exp(float x)
+{
+	if (x != x)
+		return x; // NaN
+
+	x = (EXP_HI < x) ? EXP_HI : x;
+	x = (EXP_LO > x) ? EXP_LO : x;
+
+	float fn = floorf(x * EXP_LOG2E + 0.5f);
+	fn = (fn > EXP_N_MAX) ? EXP_N_MAX : fn;
+	x = x - fn * EXP_C1;
+	x = x - fn * EXP_C2;
+
+	float z = x * x;
+	float y = EXP_P0;
+	y = y * x + EXP_P1;
+	y = y * x + EXP_P2;
+	y = y * x + EXP_P3;
+	y = y * x + EXP_P4;
+	y = y * x + EXP_P5;
+	y = (y * z + x) + 1.f;
+
+	int32_t iPow2 = ((int32_t)fn + 127) << 23;
+	float fPow2;
+	memcpy(&fPow2, &iPow2, sizeof(float));
+	return y * fPow2;
+}
+///////////////////////////////////////////////////////////////////////////
+static inline float scalar_tanh(float x)
+{
+	float ax = fabsf(x);
+	if (ax > TANH_SMALL)
+	{
+		float e = scalar_exp(ax + ax);
+		return copysignf(1.f - 2.f / (e + 1.f), x);
+	}
+
+	float z = x * x;
+	float y = TANH_P0;
+	y = y * z + TANH_P1;
+	y = y * z + TANH_P2;
+	y = y * z + TANH_P3;
+	y = y * z + TANH_P4;
+	return y * z * x + x;
+}
+///////////////////////////////////////////////////////////////////////////
+// add the SUM_LANES partial sums pairwise, then the remaining elements
+static float reduce_lanes(float* pLanes, const float* pTail, ptrdiff_t iTailSize, bool bSquare)
+{
+	for (int iWidth = SUM_LANES / 2; iWidth > 0; iWidth /= 2)
+		for (int j = 0; j < iWidth; j++)
+			pLanes[j] += pLanes[j + iWidth];
+
+	float fSum = pLanes[0];
+	for (ptrdiff_t i = 0; i < iTailSize; i++)
+		fSum += bSquare ? pTail[i] * pTail[i] : pTail[i];
+
+	return fSum;
+}
+///////////////////////////////////////////////////////////////////////////
+// function table of one instruction set
+struct SimdKernels
+{
+	const char* sName;
+	void (*add)(const float*, const float*, float*, ptrdiff_t);
+	void (*add_scalar)(const float*, float, float*, ptrdiff_t);
+	void (*sub)(const float*, const float*, float*, ptrdiff_t);
+	void (*mul)(const float*, const float*, float*, ptrdiff_t);
+	void (*mul_scalar)(const float*, float, float*, ptrdiff_t);
+	void (*div)(const float*, const float*, float*, ptrdiff_t);
+	void (*max)(const float*, const float*, float*, ptrdiff_t);
+	void (*max_scalar)(const float*, float, float*, ptrdiff_t);
+	void (*sqrt)(const float*, float*, ptrdiff_t);
+	void (*exp)(const float*, float*, ptrdiff_t);
+	void (*tanh)(const float*, float*, ptrdiff_t);
+	float (*sum)(const float*, ptrdiff_t);
+	float (*squared_norm)(const float*, ptrdiff_t);
+};
+
+///////////////////////////////////////////////////////////////////////////
+namespace scalar {
+
+#define SIMD_TARGET
+typedef float vfloat;
+const int VSIZE = 1;
+
+static inline vfloat vload(const float* p) { return *p; }
+static inline void vstore(float* p, vfloat a) { *p = a; }
+static inline vfloat vset1(float f) { return f; }
+static inline vfloat vadd(vfloat a, vfloat b) { return a + b; }
+static inline vfloat vsub(vfloat a, vfloat b) { return a - b; }
+static inline vfloat vmul(vfloat a, vfloat b) { return a * b; }
+static inline vfloat vdiv(vfloat a, vfloat b) { return a / b; }
+static inline vfloat vmax(vfloat a, vfloat b) { return (a > b) ? a : b; }
+static inline vfloat vsqrt(vfloat a) { return std::sqrt(a); }
+
+// exp and tanh use the scalar reference, also used for the tails of the vectorized loops
+static void exp(const float* pA, float* pOut, ptrdiff_t iSize)
+{
+	for (ptrdiff_t i = 0; i < iSize; i++)
+		pOut[i] = scalar_exp(pA[i]);
+}
+static void tanh(const float* pA, float* pOut, ptrdiff_t iSize)
+{
+	for (ptrdiff_t i = 0; i < iSize; i++)
+		pOut[i] = scalar_tanh(pA[i]);
+}
+
+#define BEEDNN_SIMD_NO_TRANSCENDENTAL
+#include "SimdKernelsImpl.h"
+#undef BEEDNN_SIMD_NO_TRANSCENDENTAL
+#undef SIMD_TARGET
+
+}
+
+#ifdef BEEDNN_SIMD_X86
+
+#ifdef _MSC_VER
+	#define BEEDNN_TARGET(isa) // msvc allows all intrinsics everywhere
+#else
+	#define BEEDNN_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+///////////////////////////////////////////////////////////////////////////
+namespace sse41 {
+
+#define SIMD_TARGET BEEDNN_TARGET("sse4.1")
+typedef __m128 vfloat;
+const int VSIZE = 4;
+
+SIMD_TARGET static inline vfloat vload(const float* p) { return _mm_loadu_ps(p); }
+SIMD_TARGET static inline void vstore(float* p, vfloat a) { _mm_storeu_ps(p, a); }
+SIMD_TARGET static inline vfloat vset1(float f) { return _mm_set1_ps(f); }
+SIMD_TARGET static inline vfloat vadd(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+SIMD_TARGET static inline vfloat vsub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+SIMD_TARGET static inline vfloat vmul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+SIMD_TARGET static inline vfloat vdiv(vfloat a, vfloat b) { return _mm_div_ps(a, b); }
+SIMD_TARGET static inline vfloat vmin(vfloat a, vfloat b) { return _mm_min_ps(a, b); } // (a<b)?a:b
+SIMD_TARGET static inline vfloat vmax(vfloat a, vfloat b) { return _mm_max_ps(a, b); } // (a>b)?a:b
+SIMD_TARGET static inline vfloat vsqrt(vfloat a) { return _mm_sqrt_ps(a); }
+SIMD_TARGET static inline vfloat vfloor(vfloat a) { return _mm_floor_ps(a); }
+SIMD_TARGET static inline vfloat vpow2n(vfloat n) { return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23)); }
+SIMD_TARGET static inline vfloat vabs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+SIMD_TARGET static inline vfloat vsign(vfloat a) { return _mm_and_ps(_mm_set1_ps(-0.f), a); }
+SIMD_TARGET static inline vfloat vor(vfloat a, vfloat b) { return _mm_or_ps(a, b); }
+SIMD_TARGET static inline vfloat vselect_gt(vfloat a, vfloat b, vfloat vTrue, vfloat vFalse) { return _mm_blendv_ps(vFalse, vTrue, _mm_cmpgt_ps(a, b)); }
+
+#include "SimdKernelsImpl.h"
+#undef SIMD_TARGET
+
+}
+
+///////////////////////////////////////////////////////////////////////////
+namespace avx2 {
+
+#define SIMD_TARGET BEEDNN_TARGET("avx2")
+typedef __m256 vfloat;
+const int VSIZE = 8;
+
+SIMD_TARGET static inline vfloat vload(const float* p) { return _mm256_loadu_ps(p); }
+SIMD_TARGET static inline void vstore(float* p, vfloat a) { _mm256_storeu_ps(p, a); }
+SIMD_TARGET static inline vfloat vset1(float f) { return _mm256_set1_ps(f); }
+SIMD_TARGET static inline vfloat vadd(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+SIMD_TARGET static inline vfloat vsub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+SIMD_TARGET static inline vfloat vmul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+SIMD_TARGET static inline vfloat vdiv(vfloat a, vfloat b) { return _mm256_div_ps(a, b); }
+SIMD_TARGET static inline vfloat vmin(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+SIMD_TARGET static inline vfloat vmax(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+SIMD_TARGET static inline vfloat vsqrt(vfloat a) { return _mm256_sqrt_ps(a); }
+SIMD_TARGET static inline vfloat vfloor(vfloat a) { return _mm256_floor_ps(a); }
+SIMD_TARGET static inline vfloat vpow2n(vfloat n) { return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23)); }
+SIMD_TARGET static inline vfloat vabs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), a); }
+SIMD_TARGET static inline vfloat vsign(vfloat a) { return _mm256_and_ps(_mm256_set1_ps(-0.f), a); }
+SIMD_TARGET static inline vfloat vor(vfloat a, vfloat b) { return _mm256_or_ps(a, b); }
+SIMD_TARGET static inline vfloat vselect_gt(vfloat a, vfloat b, vfloat vTrue, vfloat vFalse) { return _mm256_blendv_ps(vFalse, vTrue, _mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+
+#include "SimdKernelsImpl.h"
+#undef SIMD_TARGET
+
+}
+
+///////////////////////////////////////////////////////////////////////////
+namespace avx512 {
+
+#define SIMD_TARGET BEEDNN_TARGET("avx512f")
+typedef __m512 vfloat;
+const int VSIZE = 16;
+const __mmask16 ALL_LANES = 0xffff; // the unmasked forms of GCC 12 pass an undefined vector: -Wmaybe-uninitialized warnings
+
+SIMD_TARGET static inline vfloat vload(const float* p) { return _mm512_loadu_ps(p); }
+SIMD_TARGET static inline void vstore(float* p, vfloat a) { _mm512_storeu_ps(p, a); }
+SIMD_TARGET static inline vfloat vset1(float f) { return _mm512_set1_ps(f); }
+SIMD_TARGET static inline vfloat vadd(vfloat a, vfloat b) { return _mm512_add_ps(a, b); }
+SIMD_TARGET static inline vfloat vsub(vfloat a, vfloat b) { return _mm512_sub_ps(a, b); }
+SIMD_TARGET static inline vfloat vmul(vfloat a, vfloat b) { return _mm512_mul_ps(a, b); }
+SIMD_TARGET static inline vfloat vdiv(vfloat a, vfloat b) { return _mm512_div_ps(a, b); }
+SIMD_TARGET static inline vfloat vmin(vfloat a, vfloat b) { return _mm512_mask_min_ps(a, ALL_LANES, a, b); }
+SIMD_TARGET static inline vfloat vmax(vfloat a, vfloat b) { return _mm512_mask_max_ps(a, ALL_LANES, a, b); }
+SIMD_TARGET static inline vfloat vsqrt(vfloat a) { return _mm512_mask_sqrt_ps(a, ALL_LANES, a); }
+SIMD_TARGET static inline vfloat vfloor(vfloat a) { return _mm512_mask_roundscale_ps(a, ALL_LANES, a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+SIMD_TARGET static inline vfloat vpow2n(vfloat n) { __m512i e = _mm512_add_epi32(_mm512_mask_cvttps_epi32(_mm512_setzero_si512(), ALL_LANES, n), _mm512_set1_epi32(127)); return _mm512_castsi512_ps(_mm512_mask_slli_epi32(e, ALL_LANES, e, 23)); }
+SIMD_TARGET static inline vfloat vabs(vfloat a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32(0x7fffffff))); }
+SIMD_TARGET static inline vfloat vsign(vfloat a) { return _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a), _mm512_set1_epi32((int)0x80000000))); }
+SIMD_TARGET static inline vfloat vor(vfloat a, vfloat b) { return _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(a), _mm512_castps_si512(b))); }
+SIMD_TARGET static inline vfloat vselect_gt(vfloat a, vfloat b, vfloat vTrue, vfloat vFalse) { return _mm512_mask_blend_ps(_mm512_cmp_ps_mask(a, b, _CMP_GT_OQ), vFalse, vTrue); }
+
+#include "SimdKernelsImpl.h"
+#undef SIMD_TARGET
+
+}
+
+#endif
+
+#define SIMD_KERNELS_TABLE(isa, sName) { sName, isa::add, isa::add_scalar, isa::sub, isa::mul, isa::mul_scalar, isa::div, isa::max, isa::max_scalar, isa::sqrt, isa::exp, isa::tanh, isa::sum, isa::squared_norm }
+
+static const SimdKernels s_kernelsScalar = SIMD_KERNELS_TABLE(scalar, "Scalar");
+#ifdef BEEDNN_SIMD_X86
+static const SimdKernels s_kernelsSSE41 = SIMD_KERNELS_TABLE(sse41, "SSE41");
+static const SimdKernels s_kernelsAVX2 = SIMD_KERNELS_TABLE(avx2, "AVX2");
+static const SimdKernels s_kernelsAVX512 = SIMD_KERNELS_TABLE(avx512, "AVX512");
+#endif
+
+static atomic<const SimdKernels*> s_pKernels(nullptr);
+
+///////////////////////////////////////////////////////////////////////////
+// true if the cpu and the OS (saved registers) support the instruction set
+static bool cpu_supports(const string& sLevel)
+{
+	if (sLevel == "Scalar")
+		return true;
+
+#ifdef BEEDNN_SIMD_X86
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 0);
+	int iMaxLeaf = regs[0];
+
+	__cpuid(regs, 1);
+	bool bSSE41 = (regs[2] & (1 << 19)) != 0;
+	bool bOSXSave = (regs[2] & (1 << 27)) != 0;
+	bool bAVX = (regs[2] & (1 << 28)) != 0;
+	unsigned long long ullXCR0 = bOSXSave ? _xgetbv(0) : 0;
+
+	bool bAVX2 = false, bAVX512 = false;
+	if (iMaxLeaf >= 7)
+	{
+		__cpuidex(regs, 7, 0);
+		bAVX2 = bAVX && ((regs[1] & (1 << 5)) != 0) && ((ullXCR0 & 0x06) == 0x06);
+		bAVX512 = ((regs[1] & (1 << 16)) != 0) && ((ullXCR0 & 0xe6) == 0xe6);
+	}
+#else
+	__builtin_cpu_init();
+	bool bSSE41 = __builtin_cpu_supports("sse4.1") != 0;
+	bool bAVX2 = __builtin_cpu_supports("avx2") != 0;
+	bool bAVX512 = __builtin_cpu_supports("avx512f") != 0;
+#endif
+
+	if (sLevel == "SSE41")
+		return bSSE41;
+
+	if (sLevel == "AVX2")
+		return bAVX2;
+
+	if (sLevel == "AVX512")
+		return bAVX512;
+#endif
+
+	return false;
+}
+///////////////////////////////////////////////////////////////////////////
+static const SimdKernels* find_kernels(const string& sLevel)
+{
+#ifdef BEEDNN_SIMD_X86
+	if (sLevel == "AVX512")
+		return &s_kernelsAVX512;
+
+	if (sLevel == "AVX2")
+		return &s_kernelsAVX2;
+
+	if (sLevel == "SSE41")
+		return &s_kernelsSSE41;
+#endif
+
+	if (sLevel == "Scalar")
+		return &s_kernelsScalar;
+
+	return nullptr;
+}
+///////////////////////////////////////////////////////////////////////////
+static const SimdKernels* best_kernels()
+{
+	for (const char* sLevel : { "AVX512", "AVX2", "SSE41" })
+		if (cpu_supports(sLevel))
+			return find_kernels(sLevel);
+
+	return &s_kernelsScalar;
+}
+///////////////////////////////////////////////////////////////////////////
+static inline const SimdKernels& kernels()
+{
+	const SimdKernels* pKernels = s_pKernels.load(memory_order_relaxed);
+	if (pKernels == nullptr)
+	{
+		pKernels = best_kernels();
+		s_pKernels.store(pKernels, memory_order_relaxed);
+	}
+
+	return *pKernels;
+}
+///////////////////////////////////////////////////////////////////////////
+string get_simd_level()
+{
+	return kernels().sName;
+}
+///////////////////////////////////////////////////////////////////////////
+bool set_simd_level(const string& sLevel)
+{
+	if (sLevel.empty())
+	{
+		s_pKernels.store(best_kernels());
+		return true;
+	}
+
+	const SimdKernels* pKernels = find_kernels(sLevel);
+	if ((pKernels == nullptr) || !cpu_supports(sLevel))
+		return false;
+
+	s_pKernels.store(pKernels);
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_add(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	kernels().add(pA, pB, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_add(const float* pA, float fB, float* pOut, ptrdiff_t iSize)
+{
+	kernels().add_scalar(pA, fB, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_sub(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	kernels().sub(pA, pB, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_mul(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	kernels().mul(pA, pB, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_mul(const float* pA, float fB, float* pOut, ptrdiff_t iSize)
+{
+	kernels().mul_scalar(pA, fB, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_div(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	kernels().div(pA, pB, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_max(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	kernels().max(pA, pB, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_max(const float* pA, float fB, float* pOut, ptrdiff_t iSize)
+{
+	kernels().max_scalar(pA, fB, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_sqrt(const float* pA, float* pOut, ptrdiff_t iSize)
+{
+	kernels().sqrt(pA, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_exp(const float* pA, float* pOut, ptrdiff_t iSize)
+{
+	kernels().exp(pA, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+void simd_tanh(const float* pA, float* pOut, ptrdiff_t iSize)
+{
+	kernels().tanh(pA, pOut, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+float simd_sum(const float* pA, ptrdiff_t iSize)
+{
+	return kernels().sum(pA, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+float simd_squared_norm(const float* pA, ptrdiff_t iSize)
+{
+	return kernels().squared_norm(pA, iSize);
+}
+///////////////////////////////////////////////////////////////////////////
+}
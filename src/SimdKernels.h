@@ -0,0 +1,37 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace beednn {
+
+// element-wise float kernels, the instruction set is selected at runtime with cpuid: "AVX512", "AVX2", "SSE41" or "Scalar"
+// so one binary, built for the generic target, runs everywhere and uses the best level of each cpu
+// no FMA is used: all levels round the same way and give the same results, sum() and squaredNorm() included
+// the output buffer can be one of the inputs
+void simd_add(const float* pA, const float* pB, float* pOut, std::ptrdiff_t iSize);
+void simd_add(const float* pA, float fB, float* pOut, std::ptrdiff_t iSize);
+void simd_sub(const float* pA, const float* pB, float* pOut, std::ptrdiff_t iSize);
+void simd_mul(const float* pA, const float* pB, float* pOut, std::ptrdiff_t iSize);
+void simd_mul(const float* pA, float fB, float* pOut, std::ptrdiff_t iSize);
+void simd_div(const float* pA, const float* pB, float* pOut, std::ptrdiff_t iSize);
+void simd_max(const float* pA, const float* pB, float* pOut, std::ptrdiff_t iSize); // same as std::max(a,b), a is kept if NaN
+void simd_max(const float* pA, float fB, float* pOut, std::ptrdiff_t iSize);
+void simd_sqrt(const float* pA, float* pOut, std::ptrdiff_t iSize);
+void simd_exp(const float* pA, float* pOut, std::ptrdiff_t iSize); // polynomial, relative error < 2e-7, saturates at 88.37 (3.4e38), 0 under -87.7 instead of the denormals
+void simd_tanh(const float* pA, float* pOut, std::ptrdiff_t iSize); // polynomial, absolute error < 3e-7
+float simd_sum(const float* pA, std::ptrdiff_t iSize);
+float simd_squared_norm(const float* pA, std::ptrdiff_t iSize);
+
+std::string get_simd_level(); // instruction set in use
+bool set_simd_level(const std::string& sLevel); // force a level (tests, benchmarks), false if unknown or not supported by the cpu, "" for the best one
+
+}
@@ -0,0 +1,215 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+// generic body of the vectorized kernels, included by SimdKernels.cpp once by instruction set
+// the including namespace defines SIMD_TARGET, vfloat, VSIZE and the v*() wrappers
+// no include guard: not a public header
+
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void add(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vadd(vload(pA + i), vload(pB + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = pA[i] + pB[i];
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void add_scalar(const float* pA, float fB, float* pOut, ptrdiff_t iSize)
+{
+	vfloat vB = vset1(fB);
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vadd(vload(pA + i), vB));
+
+	for (; i < iSize; i++)
+		pOut[i] = pA[i] + fB;
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void sub(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vsub(vload(pA + i), vload(pB + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = pA[i] - pB[i];
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void mul(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vmul(vload(pA + i), vload(pB + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = pA[i] * pB[i];
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void mul_scalar(const float* pA, float fB, float* pOut, ptrdiff_t iSize)
+{
+	vfloat vB = vset1(fB);
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vmul(vload(pA + i), vB));
+
+	for (; i < iSize; i++)
+		pOut[i] = pA[i] * fB;
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void div(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vdiv(vload(pA + i), vload(pB + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = pA[i] / pB[i];
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void max(const float* pA, const float* pB, float* pOut, ptrdiff_t iSize)
+{
+	// vmax(b,a) is (b>a)?b:a, as std::max(a,b)
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vmax(vload(pB + i), vload(pA + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = scalar_max(pA[i], pB[i]);
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void max_scalar(const float* pA, float fB, float* pOut, ptrdiff_t iSize)
+{
+	vfloat vB = vset1(fB);
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vmax(vB, vload(pA + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = scalar_max(pA[i], fB);
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void sqrt(const float* pA, float* pOut, ptrdiff_t iSize)
+{
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vsqrt(vload(pA + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = std::sqrt(pA[i]);
+}
+#ifndef BEEDNN_SIMD_NO_TRANSCENDENTAL // the scalar level uses scalar_exp() and scalar_tanh()
+///////////////////////////////////////////////////////////////////////////
+// same operations as scalar_exp()
+SIMD_TARGET static inline vfloat vexp(vfloat x)
+{
+	x = vmin(vset1(EXP_HI), x); // keep NaN
+	x = vmax(vset1(EXP_LO), x);
+
+	// exp(x) = 2^n * exp(r) with r = x - n*ln(2) in [-ln(2)/2, ln(2)/2]
+	vfloat fn = vfloor(vadd(vmul(x, vset1(EXP_LOG2E)), vset1(0.5f)));
+	fn = vmin(vset1(EXP_N_MAX), fn);
+	x = vsub(x, vmul(fn, vset1(EXP_C1)));
+	x = vsub(x, vmul(fn, vset1(EXP_C2)));
+
+	vfloat z = vmul(x, x);
+	vfloat y = vset1(EXP_P0);
+	y = vadd(vmul(y, x), vset1(EXP_P1));
+	y = vadd(vmul(y, x), vset1(EXP_P2));
+	y = vadd(vmul(y, x), vset1(EXP_P3));
+	y = vadd(vmul(y, x), vset1(EXP_P4));
+	y = vadd(vmul(y, x), vset1(EXP_P5));
+	y = vadd(vadd(vmul(y, z), x), vset1(1.f));
+
+	return vmul(y, vpow2n(fn));
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void exp(const float* pA, float* pOut, ptrdiff_t iSize)
+{
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vexp(vload(pA + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = scalar_exp(pA[i]);
+}
+///////////////////////////////////////////////////////////////////////////
+// same operations as scalar_tanh()
+SIMD_TARGET static inline vfloat vtanh(vfloat x)
+{
+	vfloat ax = vabs(x);
+
+	// small |x|: odd polynomial
+	vfloat z = vmul(x, x);
+	vfloat ySmall = vset1(TANH_P0);
+	ySmall = vadd(vmul(ySmall, z), vset1(TANH_P1));
+	ySmall = vadd(vmul(ySmall, z), vset1(TANH_P2));
+	ySmall = vadd(vmul(ySmall, z), vset1(TANH_P3));
+	ySmall = vadd(vmul(ySmall, z), vset1(TANH_P4));
+	ySmall = vadd(vmul(vmul(ySmall, z), x), x);
+
+	// big |x|: 1-2/(exp(2|x|)+1) with the sign of x
+	vfloat e = vexp(vadd(ax, ax));
+	vfloat yBig = vsub(vset1(1.f), vdiv(vset1(2.f), vadd(e, vset1(1.f))));
+	yBig = vor(yBig, vsign(x));
+
+	return vselect_gt(ax, vset1(TANH_SMALL), yBig, ySmall);
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static void tanh(const float* pA, float* pOut, ptrdiff_t iSize)
+{
+	ptrdiff_t i = 0;
+	for (; i + VSIZE <= iSize; i += VSIZE)
+		vstore(pOut + i, vtanh(vload(pA + i)));
+
+	for (; i < iSize; i++)
+		pOut[i] = scalar_tanh(pA[i]);
+}
+#endif
+///////////////////////////////////////////////////////////////////////////
+// SUM_LANES partial sums, lane j accumulates the elements j modulo SUM_LANES, whatever VSIZE
+SIMD_TARGET static float sum(const float* pA, ptrdiff_t iSize)
+{
+	vfloat acc[SUM_LANES / VSIZE];
+	for (int j = 0; j < SUM_LANES / VSIZE; j++)
+		acc[j] = vset1(0.f);
+
+	ptrdiff_t i = 0;
+	for (; i + SUM_LANES <= iSize; i += SUM_LANES)
+		for (int j = 0; j < SUM_LANES / VSIZE; j++)
+			acc[j] = vadd(acc[j], vload(pA + i + j * VSIZE));
+
+	float fLanes[SUM_LANES];
+	for (int j = 0; j < SUM_LANES / VSIZE; j++)
+		vstore(fLanes + j * VSIZE, acc[j]);
+
+	return reduce_lanes(fLanes, pA + i, iSize - i, false);
+}
+///////////////////////////////////////////////////////////////////////////
+SIMD_TARGET static float squared_norm(const float* pA, ptrdiff_t iSize)
+{
+	vfloat acc[SUM_LANES / VSIZE];
+	for (int j = 0; j < SUM_LANES / VSIZE; j++)
+		acc[j] = vset1(0.f);
+
+	ptrdiff_t i = 0;
+	for (; i + SUM_LANES <= iSize; i += SUM_LANES)
+		for (int j = 0; j < SUM_LANES / VSIZE; j++)
+		{
+			vfloat v = vload(pA + i + j * VSIZE);
+			acc[j] = vadd(acc[j], vmul(v, v));
+		}
+
+	float fLanes[SUM_LANES];
+	for (int j = 0; j < SUM_LANES / VSIZE; j++)
+		vstore(fLanes + j * VSIZE, acc[j]);
+
+	return reduce_lanes(fLanes, pA + i, iSize - i, true);
+}
+///////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,154 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#include "TensorFile.h"
+
+#include <cassert>
+#include <cstring>
+
+using namespace std;
+namespace beednn {
+
+static const char g_tensorMagic[8] = { 'B', 'E', 'E', 'D', 'N', 'N', 'T', 0 };
+
+///////////////////////////////////////////////////////////////////////////
+static size_t type_size(uint32_t uiType)
+{
+	return uiType == TensorFloat32 ? sizeof(float) : 1;
+}
+///////////////////////////////////////////////////////////////////////////
+static size_t padded_size(size_t iBytes)
+{
+	return (iBytes + sizeof(TensorHeader) - 1) / sizeof(TensorHeader) * sizeof(TensorHeader);
+}
+///////////////////////////////////////////////////////////////////////////
+bool TensorFile::open(const string& sFile)
+{
+	close();
+
+	if (!_file.open(sFile))
+		return false;
+
+	const unsigned char* pFile = _file.data();
+	size_t iFileSize = _file.size();
+	size_t iPos = 0;
+
+	while (iPos < iFileSize)
+	{
+		TensorHeader header;
+		if (iFileSize - iPos < sizeof(TensorHeader))
+			break;
+		memcpy(&header, pFile + iPos, sizeof(TensorHeader));
+		iPos += sizeof(TensorHeader);
+
+		if ((memcmp(header.magic, g_tensorMagic, sizeof(g_tensorMagic)) != 0) || (header.uiVersion != 1) || (header.uiType > TensorUInt8))
+			break;
+
+		// the sizes must fit in the file, without overflow
+		size_t iTypeSize = type_size(header.uiType);
+		if ((header.uiCols != 0) && (header.uiRows > (iFileSize - iPos) / iTypeSize / header.uiCols))
+			break;
+
+		size_t iDataBytes = (size_t)(header.uiRows * header.uiCols) * iTypeSize;
+		header.name[sizeof(header.name) - 1] = 0;
+
+		Tensor t;
+		t.sName = header.name;
+		t.type = (TensorType)header.uiType;
+		t.iRows = (Index)header.uiRows;
+		t.iCols = (Index)header.uiCols;
+		t.iChunkRows = (Index)header.uiChunkRows;
+		t.pData = pFile + iPos;
+		_tensors.push_back(t);
+
+		iPos += min(padded_size(iDataBytes), iFileSize - iPos); // the last padding can be missing
+	}
+
+	if ((iPos != iFileSize) || _tensors.empty())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+void TensorFile::close()
+{
+	_tensors.clear();
+	_file.close();
+}
+///////////////////////////////////////////////////////////////////////////
+size_t TensorFile::nb_tensors() const
+{
+	return _tensors.size();
+}
+///////////////////////////////////////////////////////////////////////////
+const TensorFile::Tensor& TensorFile::tensor(size_t iTensor) const
+{
+	assert(iTensor < _tensors.size());
+	return _tensors[iTensor];
+}
+///////////////////////////////////////////////////////////////////////////
+const TensorFile::Tensor* TensorFile::find(const string& sName) const
+{
+	for (size_t i = 0; i < _tensors.size(); i++)
+		if (_tensors[i].sName == sName)
+			return &_tensors[i];
+
+	return nullptr;
+}
+///////////////////////////////////////////////////////////////////////////
+bool TensorFileWriter::open(const string& sFile)
+{
+	_file.open(sFile, ios::binary | ios::out | ios::trunc);
+	return _file.good();
+}
+///////////////////////////////////////////////////////////////////////////
+bool TensorFileWriter::write(const string& sName, const MatrixFloat& m, Index iChunkRows)
+{
+	return write_tensor(sName, TensorFloat32, m.data(), m.rows(), m.cols(), iChunkRows);
+}
+///////////////////////////////////////////////////////////////////////////
+bool TensorFileWriter::write(const string& sName, const unsigned char* pData, Index iRows, Index iCols, Index iChunkRows)
+{
+	return write_tensor(sName, TensorUInt8, pData, iRows, iCols, iChunkRows);
+}
+///////////////////////////////////////////////////////////////////////////
+bool TensorFileWriter::write_tensor(const string& sName, TensorType type, const void* pData, Index iRows, Index iCols, Index iChunkRows)
+{
+	TensorHeader header;
+	memset(&header, 0, sizeof(header));
+	if (sName.size() >= sizeof(header.name))
+		return false;
+
+	memcpy(header.magic, g_tensorMagic, sizeof(g_tensorMagic));
+	header.uiVersion = 1;
+	header.uiType = (uint32_t)type;
+	header.uiRows = (uint64_t)iRows;
+	header.uiCols = (uint64_t)iCols;
+	header.uiChunkRows = (uint64_t)iChunkRows;
+	memcpy(header.name, sName.c_str(), sName.size());
+
+	size_t iDataBytes = (size_t)(iRows * iCols) * type_size(type);
+	const char padding[sizeof(TensorHeader)] = { 0 };
+
+	_file.write((const char*)&header, sizeof(header));
+	_file.write((const char*)pData, (streamsize)iDataBytes);
+	_file.write(padding, (streamsize)(padded_size(iDataBytes) - iDataBytes));
+	return _file.good();
+}
+///////////////////////////////////////////////////////////////////////////
+bool TensorFileWriter::close()
+{
+	bool bOk = _file.good();
+	_file.close();
+	return bOk && !_file.fail();
+}
+///////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,81 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include "Matrix.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace beednn {
+
+// binary file of named 2D tensors, read by mapping the file: no parsing and no copy
+// each tensor is a 64 bytes header then the row major data, padded to 64 bytes: the data of all tensors are 64 bytes aligned
+// the numbers are little endian, as on x86 and ARM
+enum TensorType
+{
+	TensorFloat32 = 0,
+	TensorUInt8 = 1
+};
+
+struct TensorHeader
+{
+	char magic[8]; // "BEEDNNT"
+	uint32_t uiVersion; // 1
+	uint32_t uiType; // TensorType
+	uint64_t uiRows;
+	uint64_t uiCols;
+	uint64_t uiChunkRows; // rows read at once by a stream, 0 if not chunked, the data stay contiguous
+	char name[24]; // zero terminated
+};
+static_assert(sizeof(TensorHeader) == 64, "the tensor header is 64 bytes");
+
+// read only mapped tensor file
+class TensorFile
+{
+public:
+	struct Tensor
+	{
+		std::string sName;
+		TensorType type;
+		Index iRows, iCols, iChunkRows;
+		const unsigned char* pData; // in the mapped file
+	};
+
+	bool open(const std::string& sFile); // false if the file is not a valid tensor file
+	void close();
+
+	size_t nb_tensors() const;
+	const Tensor& tensor(size_t iTensor) const;
+	const Tensor* find(const std::string& sName) const; // nullptr if not in the file
+
+private:
+	MappedFile _file;
+	std::vector<Tensor> _tensors;
+};
+
+// write the tensors one after the other
+class TensorFileWriter
+{
+public:
+	bool open(const std::string& sFile);
+	bool write(const std::string& sName, const MatrixFloat& m, Index iChunkRows = 0);
+	bool write(const std::string& sName, const unsigned char* pData, Index iRows, Index iCols, Index iChunkRows = 0); // byte tensor
+	bool close(); // false if a write failed
+
+private:
+	bool write_tensor(const std::string& sName, TensorType type, const void* pData, Index iRows, Index iCols, Index iChunkRows);
+
+	std::ofstream _file;
+};
+
+}
@@ -0,0 +1,154 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#include "TensorFileReader.h"
+#include "DataStream.h"
+
+using namespace std;
+namespace beednn {
+
+///////////////////////////////////////////////////////////////////////////
+// rows iStart to iEnd of a tensor, the float rows are copied, the byte rows converted
+static void read_tensor_rows(const TensorFile::Tensor& t, Index iStart, Index iEnd, MatrixFloat& m)
+{
+	if (t.type == TensorFloat32)
+	{
+		m = fromRawBuffer((const float*)t.pData + iStart * t.iCols, iEnd - iStart, t.iCols);
+		return;
+	}
+
+	m.resize(iEnd - iStart, t.iCols);
+	const unsigned char* pIn = t.pData + iStart * t.iCols;
+	float* pOut = m.data();
+	for (Index i = 0; i < m.size(); i++)
+		pOut[i] = (float)pIn[i];
+}
+///////////////////////////////////////////////////////////////////////////
+// samples and truth of a mapped tensor file
+class TensorDataStream : public DataStream
+{
+public:
+	TensorDataStream(const TensorFile::Tensor& samples, const TensorFile::Tensor& truth, Index iShardSize):
+		_samples(samples),
+		_truth(truth),
+		_iShardSize(iShardSize)
+	{ }
+
+	Index nb_shards() const override
+	{
+		return (_samples.iRows + _iShardSize - 1) / _iShardSize;
+	}
+
+	Index nb_samples() const override
+	{
+		return _samples.iRows;
+	}
+
+	bool read_shard(Index iShard, MatrixFloat& mSamples, MatrixFloat& mTruth) override
+	{
+		if ((iShard < 0) || (iShard >= nb_shards()))
+			return false;
+
+		Index iStart = iShard * _iShardSize;
+		Index iEnd = min(iStart + _iShardSize, _samples.iRows);
+		read_tensor_rows(_samples, iStart, iEnd, mSamples);
+		read_tensor_rows(_truth, iStart, iEnd, mTruth);
+		return true;
+	}
+
+private:
+	TensorFile::Tensor _samples, _truth;
+	Index _iShardSize;
+};
+///////////////////////////////////////////////////////////////////////////
+bool TensorFileReader::load(const string& sFile)
+{
+	clear();
+
+	if (!_file.open(sFile))
+		return false;
+
+	bool bFoundData, bFoundTruth;
+	if (!load_tensor("train_data", _mTrainData, bFoundData) || !load_tensor("train_truth", _mTrainTruth, bFoundTruth))
+		return false;
+	_bHasTrainData = bFoundData && bFoundTruth;
+
+	if (!load_tensor("validation_data", _mValData, bFoundData) || !load_tensor("validation_truth", _mValTruth, bFoundTruth))
+		return false;
+	_bHasValidationData = bFoundData && bFoundTruth;
+
+	return _bHasTrainData && (_mTrainData.rows() == _mTrainTruth.rows()) && (!_bHasValidationData || (_mValData.rows() == _mValTruth.rows()));
+}
+///////////////////////////////////////////////////////////////////////////
+void TensorFileReader::clear()
+{
+	// a resized view becomes a matrix
+	_mTrainData.resize(0, 0);
+	_mTrainTruth.resize(0, 0);
+	_mValData.resize(0, 0);
+	_mValTruth.resize(0, 0);
+	_bHasTrainData = false;
+	_bHasValidationData = false;
+
+	delete _pTrainStream;
+	delete _pValidationStream;
+	_pTrainStream = nullptr;
+	_pValidationStream = nullptr;
+
+	_file.close();
+}
+///////////////////////////////////////////////////////////////////////////
+bool TensorFileReader::load_tensor(const string& sName, MatrixFloat& m, bool& bFound)
+{
+	const TensorFile::Tensor* pTensor = _file.find(sName);
+	bFound = pTensor != nullptr;
+	if (!bFound)
+	{
+		m.resize(0, 0);
+		return true;
+	}
+
+	if (pTensor->type == TensorFloat32)
+		setView(m, (const float*)pTensor->pData, pTensor->iRows, pTensor->iCols);
+	else
+		read_tensor_rows(*pTensor, 0, pTensor->iRows, m);
+
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+bool TensorFileReader::load_mapped(const string& sFile, Index iShardSize)
+{
+	clear();
+
+	if (!_file.open(sFile))
+		return false;
+
+	const TensorFile::Tensor* pTrainData = _file.find("train_data");
+	const TensorFile::Tensor* pTrainTruth = _file.find("train_truth");
+	if ((pTrainData == nullptr) || (pTrainTruth == nullptr) || (pTrainData->iRows != pTrainTruth->iRows))
+		return false;
+
+	if (iShardSize <= 0)
+		iShardSize = pTrainData->iChunkRows > 0 ? pTrainData->iChunkRows : 1024;
+
+	_pTrainStream = new TensorDataStream(*pTrainData, *pTrainTruth, iShardSize);
+
+	const TensorFile::Tensor* pValidationData = _file.find("validation_data");
+	const TensorFile::Tensor* pValidationTruth = _file.find("validation_truth");
+	if (pValidationData && pValidationTruth && (pValidationData->iRows == pValidationTruth->iRows))
+		_pValidationStream = new TensorDataStream(*pValidationData, *pValidationTruth, iShardSize);
+
+	return true;
+}
+///////////////////////////////////////////////////////////////////////////
+const TensorFile& TensorFileReader::file() const
+{
+	return _file;
+}
+///////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,40 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include "DataSource.h"
+#include "TensorFile.h"
+
+#include <string>
+
+namespace beednn {
+
+// dataset in a tensor file, see TensorFile.h: the tensors "train_data" and "train_truth", and optionally "validation_data" and "validation_truth"
+// written with TensorFileWriter, by example from the matrices of a CsvFileReader
+class TensorFileReader : public DataSource
+{
+public:
+	// the float tensors are viewed in the mapped file without copy (copied with Eigen), the byte tensors are converted to float
+	// the matrices are valid until the next load or the destruction of the reader
+	virtual bool load(const std::string& sFile) override;
+
+	// the tensors stay in the mapped file, read shard by shard in train_stream() and validation_stream(), the matrices stay empty
+	// iShardSize is the chunk rows of the train_data tensor by default, or 1024 if not chunked
+	bool load_mapped(const std::string& sFile, Index iShardSize = 0);
+
+	const TensorFile& file() const;
+
+private:
+	void clear(); // the matrices and the streams use the mapped file
+	bool load_tensor(const std::string& sName, MatrixFloat& m, bool& bFound);
+
+	TensorFile _file;
+};
+
+}
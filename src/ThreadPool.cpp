@@ -0,0 +1,165 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#include "ThreadPool.h"
+
+using namespace std;
+namespace beednn {
+
+// true in a thread running tasks, nested jobs are then run serially
+static thread_local bool t_bInTask = false;
+
+///////////////////////////////////////////////////////////////////////////
+ThreadPool::ThreadPool()
+{
+	_pCaller = nullptr;
+	_pTask = nullptr;
+	_iNbTasks = 0;
+	_iNextTask = 0;
+	_iNbWorkersBusy = 0;
+	_uiJob = 0;
+	_bStop = false;
+}
+///////////////////////////////////////////////////////////////////////////
+ThreadPool::~ThreadPool()
+{
+	stop_workers();
+}
+///////////////////////////////////////////////////////////////////////////
+ThreadPool& ThreadPool::instance()
+{
+	static ThreadPool pool;
+	return pool;
+}
+///////////////////////////////////////////////////////////////////////////
+void ThreadPool::set_nb_threads(int iNbThreads)
+{
+	if (iNbThreads <= 0)
+		iNbThreads = (int)thread::hardware_concurrency();
+
+	if (iNbThreads < 1)
+		iNbThreads = 1;
+
+	lock_guard<mutex> lockJob(_mutexJob);
+
+	if ((int)_workers.size() == iNbThreads - 1)
+		return;
+
+	stop_workers();
+
+	// the calling thread is also working, so start one worker less
+	for (int i = 0; i < iNbThreads - 1; i++)
+		_workers.push_back(thread(&ThreadPool::worker_loop, this, _uiJob));
+}
+///////////////////////////////////////////////////////////////////////////
+int ThreadPool::nb_threads() const
+{
+	return (int)_workers.size() + 1;
+}
+///////////////////////////////////////////////////////////////////////////
+void ThreadPool::run(ptrdiff_t iNbTasks, TaskCaller pCaller, const void* pTask)
+{
+	if (iNbTasks <= 0)
+		return;
+
+	// serial case: no worker, only one task, nested job, or pool already used by another thread
+	if (_workers.empty() || (iNbTasks == 1) || t_bInTask || !_mutexJob.try_lock())
+	{
+		for (ptrdiff_t i = 0; i < iNbTasks; i++)
+			pCaller(pTask, i);
+		return;
+	}
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		_pCaller = pCaller;
+		_pTask = pTask;
+		_iNbTasks = iNbTasks;
+		_iNextTask = 0;
+		_iNbWorkersBusy = _workers.size();
+		_uiJob++;
+	}
+	_cvStart.notify_all();
+
+	run_tasks();
+
+	{
+		unique_lock<mutex> lock(_mutex);
+		_cvDone.wait(lock, [this] { return _iNbWorkersBusy == 0; });
+	}
+
+	_mutexJob.unlock();
+}
+///////////////////////////////////////////////////////////////////////////
+void ThreadPool::run_tasks()
+{
+	t_bInTask = true;
+
+	for (;;)
+	{
+		ptrdiff_t iTask = _iNextTask++;
+		if (iTask >= _iNbTasks)
+			break;
+
+		_pCaller(_pTask, iTask);
+	}
+
+	t_bInTask = false;
+}
+///////////////////////////////////////////////////////////////////////////
+void ThreadPool::worker_loop(unsigned int uiLastJob)
+{
+	for (;;)
+	{
+		{
+			unique_lock<mutex> lock(_mutex);
+			_cvStart.wait(lock, [&] { return _bStop || (_uiJob != uiLastJob); });
+
+			if (_bStop)
+				return;
+
+			uiLastJob = _uiJob;
+		}
+
+		run_tasks();
+
+		{
+			lock_guard<mutex> lock(_mutex);
+			_iNbWorkersBusy--;
+			if (_iNbWorkersBusy == 0)
+				_cvDone.notify_one();
+		}
+	}
+}
+///////////////////////////////////////////////////////////////////////////
+void ThreadPool::stop_workers()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_bStop = true;
+	}
+	_cvStart.notify_all();
+
+	for (size_t i = 0; i < _workers.size(); i++)
+		_workers[i].join();
+
+	_workers.clear();
+	_bStop = false;
+}
+///////////////////////////////////////////////////////////////////////////
+void set_nb_threads(int iNbThreads)
+{
+	ThreadPool::instance().set_nb_threads(iNbThreads);
+}
+///////////////////////////////////////////////////////////////////////////
+int get_nb_threads()
+{
+	return ThreadPool::instance().nb_threads();
+}
+///////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,77 @@
+/*
+    Copyright (c) 2019, Etienne de Foras and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a MIT-style license that can be found
+    in the LICENSE.txt file.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace beednn {
+
+// persistent worker pool owned by the library, used to split big computations (GEMM ...) over the cpu cores
+// only one job runs at a time: a job sent while the pool is busy, or from inside a task, runs in the calling thread
+class ThreadPool
+{
+public:
+	ThreadPool();
+	~ThreadPool();
+
+	static ThreadPool& instance();
+
+	void set_nb_threads(int iNbThreads); // 1 by default: no worker, 0 is one thread by cpu core
+	int nb_threads() const; // calling thread included
+
+	// call task(iTask) for every iTask in [0, iNbTasks), return when all tasks are done
+	template <class Task>
+	void parallel_for(std::ptrdiff_t iNbTasks, const Task& task)
+	{
+		run(iNbTasks, &call_task<Task>, &task);
+	}
+
+private:
+	template <class Task>
+	static void call_task(const void* pTask, std::ptrdiff_t iTask)
+	{
+		(*static_cast<const Task*>(pTask))(iTask);
+	}
+
+	typedef void (*TaskCaller)(const void* pTask, std::ptrdiff_t iTask);
+	void run(std::ptrdiff_t iNbTasks, TaskCaller pCaller, const void* pTask);
+	void run_tasks();
+	void worker_loop(unsigned int uiLastJob);
+	void stop_workers();
+
+	std::vector<std::thread> _workers;
+	std::mutex _mutexJob; // held by the running job
+	std::mutex _mutex;
+	std::condition_variable _cvStart;
+	std::condition_variable _cvDone;
+
+	TaskCaller _pCaller;
+	const void* _pTask;
+	std::ptrdiff_t _iNbTasks;
+	std::atomic<std::ptrdiff_t> _iNextTask;
+	size_t _iNbWorkersBusy;
+	unsigned int _uiJob;
+	bool _bStop;
+};
+
+void set_nb_threads(int iNbThreads); // 1 by default, keep the cpu cores for upper algorithms (MetaOptimizer), 0 is all cores
+int get_nb_threads();
+
+template <class Task>
+void parallel_for(std::ptrdiff_t iNbTasks, const Task& task)
+{
+	ThreadPool::instance().parallel_for(iNbTasks, task);
+}
+
+}
@@ -0,0 +1,298 @@
+// count the heap allocations of a training step
+// every Matrix temporary costs one allocation, move semantics and rvalue operators keep them low
+// the pool allocator of NetTrain then gives back the memory of the previous batch: no allocation at all
+
+#include <iostream>
+#include <cstdlib>
+#include <new>
+using namespace std;
+
+#include "Net.h"
+#include "NetTrain.h"
+
+#include "MatrixAllocator.h"
+
+#include "LayerDense.h"
+#include "LayerActivation.h"
+#include "LayerConvolution2D.h"
+#include "LayerSoftmax.h"
+#include "LayerGlobalGain.h"
+
+using namespace beednn;
+/////////////////////////////////////////////////////////////////////
+// the other forms forward to the four functions marked NOT_INLINED
+// not inlined: the compiler would pair their malloc() and free() with operator new and delete, -Wmismatched-new-delete warnings
+#ifdef __GNUC__
+	#define NOT_INLINED __attribute__((noinline))
+#else
+	#define NOT_INLINED
+#endif
+
+// global allocation counter, used by all operator new
+static size_t g_iNbAllocations = 0;
+static size_t g_iMaxAllocationSize = 0;
+
+NOT_INLINED void* operator new(size_t iSize)
+{
+	g_iNbAllocations++;
+	g_iMaxAllocationSize = max(g_iMaxAllocationSize, iSize);
+	void* p = malloc(iSize == 0 ? 1 : iSize);
+	if (p == nullptr)
+		throw bad_alloc();
+	return p;
+}
+void* operator new[](size_t iSize)
+{
+	return operator new(iSize);
+}
+NOT_INLINED void operator delete(void* p) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+// Matrix data are 64 bytes aligned
+NOT_INLINED void* operator new(size_t iSize, align_val_t iAlign)
+{
+	g_iNbAllocations++;
+	g_iMaxAllocationSize = max(g_iMaxAllocationSize, iSize);
+	size_t iAlignment = (size_t)iAlign;
+	void* p = aligned_alloc(iAlignment, (iSize + iAlignment - 1) / iAlignment * iAlignment + (iSize == 0 ? iAlignment : 0));
+	if (p == nullptr)
+		throw bad_alloc();
+	return p;
+}
+void* operator new[](size_t iSize, align_val_t iAlign)
+{
+	return operator new(iSize, iAlign);
+}
+NOT_INLINED void operator delete(void* p, align_val_t) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, align_val_t iAlign) noexcept
+{
+	operator delete(p, iAlign);
+}
+void operator delete(void* p, size_t, align_val_t iAlign) noexcept
+{
+	operator delete(p, iAlign);
+}
+void operator delete[](void* p, size_t, align_val_t iAlign) noexcept
+{
+	operator delete(p, iAlign);
+}
+/////////////////////////////////////////////////////////////////////
+// for testU only
+void test(bool bTest, const string& sMessage = "")
+{
+	if (bTest) return;
+
+	cout << "Test failed: " << sMessage << endl;
+	exit(-1);
+}
+/////////////////////////////////////////////////////////////////////
+size_t allocations_per_train_batch(const string& sOptimizer, bool bConvolution = false)
+{
+	const Index iBatchSize = 32;
+
+	Net model;
+	if (bConvolution)
+	{
+		// 4x4 image with one channel, as 16 inputs
+		model.add(new LayerConvolution2D(4, 4, 1, 3, 3, 2));
+		model.add(new LayerActivation("Relu"));
+		model.add(new LayerDense(8, 4));
+		model.add(new LayerSoftmax());
+	}
+	else
+	{
+		model.add(new LayerDense(16, 64));
+		model.add(new LayerActivation("Relu"));
+		model.add(new LayerDense(64, 64));
+		model.add(new LayerActivation("Tanh"));
+		model.add(new LayerDense(64, 4));
+	}
+
+	MatrixFloat mSamples, mTruth;
+	mSamples.setRandom(iBatchSize, 16);
+	mTruth.setRandom(iBatchSize, 4);
+
+	NetTrain netTrain;
+	netTrain.set_epochs(1);
+	netTrain.set_keepbest(false); // keepbest clones the layers at the end of fit(), train_batch() would then use the old weights pointers
+	netTrain.set_batchsize(iBatchSize);
+	netTrain.set_optimizer(sOptimizer);
+	netTrain.set_train_data(mSamples, mTruth);
+	netTrain.fit(model); // init the net, the optimizers and the buffers
+
+	// warm up: first train_batch allocates the optimizers state
+	netTrain.train_batch(mSamples, mTruth);
+
+	const int iNbBatches = 10;
+	size_t iNbAllocationsStart = g_iNbAllocations;
+	for (int i = 0; i < iNbBatches; i++)
+		netTrain.train_batch(mSamples, mTruth);
+
+	return (g_iNbAllocations - iNbAllocationsStart) / iNbBatches;
+}
+/////////////////////////////////////////////////////////////////////
+// deep net of dense and element-wise layers, the result is checked against a layer by layer forward
+size_t allocations_per_predict(int iNbBlocks)
+{
+	Net model;
+	for (int i = 0; i < iNbBlocks; i++)
+	{
+		model.add(new LayerDense(16, 16));
+		model.add(new LayerActivation("Tanh"));
+		model.add(new LayerGlobalGain());
+	}
+
+	MatrixFloat mSamples, mOut;
+	mSamples.setRandom(64, 16);
+
+	model.predict(mSamples, mOut);
+
+	MatrixFloat mRef = mSamples, mTemp;
+	for (size_t i = 0; i < model.size(); i++)
+	{
+		model.layer(i).forward(mRef, mTemp);
+		mRef = mTemp;
+	}
+	test((mOut - mRef).cwiseAbs().maxCoeff() == 0.f, "predict must give the same result as the layers");
+
+	size_t iNbAllocationsStart = g_iNbAllocations;
+	model.predict(mSamples, mOut);
+	return g_iNbAllocations - iNbAllocationsStart;
+}
+/////////////////////////////////////////////////////////////////////
+// a reused InferenceContext keeps the buffers of the layers
+size_t allocations_per_predict_with_context()
+{
+	Net model;
+	model.add(new LayerConvolution2D(8, 8, 1, 3, 3, 4));
+	model.add(new LayerActivation("Relu"));
+	model.add(new LayerDense(144, 2));
+	model.add(new LayerSoftmax());
+
+	MatrixFloat mSamples, mOut;
+	mSamples.setRandom(64, 64);
+
+	InferenceContext context;
+	model.predict(mSamples, mOut, context);
+
+	size_t iNbAllocationsStart = g_iNbAllocations;
+	model.predict(mSamples, mOut, context);
+	return g_iNbAllocations - iNbAllocationsStart;
+}
+/////////////////////////////////////////////////////////////////////
+// biggest allocation of a convolution net predict, the convolution output grows with the batch size
+size_t max_allocation_predict(Net& model, const MatrixFloat& mSamples, Index iInferenceBatchSize, MatrixFloat& mOut)
+{
+	model.set_inference_batchsize(iInferenceBatchSize);
+
+	g_iMaxAllocationSize = 0;
+	model.predict(mSamples, mOut);
+	return g_iMaxAllocationSize;
+}
+/////////////////////////////////////////////////////////////////////
+// biggest allocation of a shuffled training, the batches are gathered without a shuffled copy of the samples
+size_t max_allocation_fit(const MatrixFloat& mSamples)
+{
+	Net model;
+	model.add(new LayerDense(mSamples.cols(), 8));
+	model.add(new LayerActivation("Relu"));
+	model.add(new LayerDense(8, 2));
+
+	MatrixFloat mTruth;
+	mTruth.setRandom(mSamples.rows(), 2);
+
+	NetTrain netTrain;
+	netTrain.set_epochs(2);
+	netTrain.set_keepbest(false);
+	netTrain.set_batchsize(32);
+	netTrain.set_train_data(mSamples, mTruth);
+
+	g_iMaxAllocationSize = 0;
+	netTrain.fit(model);
+#ifndef USE_EIGEN
+	test(MatrixPoolAllocator::instance().cached_bytes() == 0, "fit must give back the memory of the pool");
+#endif
+	return g_iMaxAllocationSize;
+}
+/////////////////////////////////////////////////////////////////////
+int main()
+{
+	cout << "Heap allocations per train_batch:" << endl;
+
+	// without move semantics, every operator returning a Matrix was also deep copied
+	// Adam was at 140 allocations per train_batch, SGD at 32, for this net
+	// then 51 and 21 with move semantics, before the lazy element-wise expressions
+	size_t iAdam = allocations_per_train_batch("Adam");
+	cout << "Adam: " << iAdam << endl;
+
+	size_t iSGD = allocations_per_train_batch("SGD");
+	cout << "SGD: " << iSGD << endl;
+
+	size_t iConvolution = allocations_per_train_batch("Adam", true);
+	cout << "Convolution and Softmax: " << iConvolution << endl;
+
+	cout << "Heap allocations per predict:" << endl;
+	size_t iPredict1 = allocations_per_predict(1);
+	size_t iPredict10 = allocations_per_predict(10);
+	cout << "3 layers: " << iPredict1 << endl;
+	cout << "30 layers: " << iPredict10 << endl;
+	size_t iPredictContext = allocations_per_predict_with_context();
+	cout << "with a context: " << iPredictContext << endl;
+
+	cout << "Biggest allocation in predict (bytes):" << endl;
+	Net modelConvolution;
+	modelConvolution.add(new LayerConvolution2D(8, 8, 1, 3, 3, 4));
+	modelConvolution.add(new LayerActivation("Relu"));
+	modelConvolution.add(new LayerDense(144, 2));
+	MatrixFloat mSamplesConvolution, mOutAll, mOutBatched;
+	mSamplesConvolution.setRandom(2000, 64);
+
+	// the layers keep their buffers: smaller batches first
+	size_t iMaxBatched = max_allocation_predict(modelConvolution, mSamplesConvolution, 64, mOutBatched);
+	size_t iMaxAll = max_allocation_predict(modelConvolution, mSamplesConvolution, 0, mOutAll);
+	cout << "all samples at once: " << iMaxAll << endl;
+	cout << "batches of 64 samples: " << iMaxBatched << endl;
+	test((mOutAll.rows() == 2000) && (mOutBatched.rows() == 2000) && (mOutBatched.cols() == 2), "predict by batches output size");
+	test((mOutAll - mOutBatched).cwiseAbs().maxCoeff() < 1.e-5f, "predict by batches must give the same result");
+
+	size_t iMaxFit = max_allocation_fit(mSamplesConvolution);
+	cout << "Biggest allocation in fit (bytes): " << iMaxFit << endl;
+
+#ifndef USE_EIGEN
+	// 11 allocations with Adam and SGD before the pool allocator
+	test(iAdam == 0, "no allocation expected with Adam");
+	test(iSGD == 0, "no allocation expected with SGD");
+	test(iConvolution == 0, "no allocation expected with a convolution");
+	test(MatrixPoolAllocator::instance().nb_system_allocations_last_batch() == 0, "the pool must be warm");
+
+	// two ping-pong buffers and the layers scratch list of the temporary context, whatever the depth
+	test(iPredict1 <= 3, "too many allocations in predict");
+	test(iPredict10 <= 3, "predict allocations must not depend on the number of layers");
+	test(iPredictContext == 0, "no allocation expected in predict with a warm context");
+
+	// convolution output: 1.1 MB for the 2000 samples, 37 kB for 64 samples (the direct convolution has no im2col buffer)
+	test(iMaxBatched * 4 < iMaxAll, "predict by batches must bound the memory");
+
+	// 512 kB samples, copied in a shuffled order at every epoch before, now the shuffle index: 16 kB
+	test(iMaxFit * 4 < (size_t)mSamplesConvolution.size() * sizeof(float), "fit must not copy the samples");
+#endif
+
+	cout << "Test succeded." << endl;
+	return 0;
+}
@@ -0,0 +1,332 @@
+// the mapped MNIST and CIFAR10 files give the same samples as the files loaded in matrices
+// the bytes are converted shard by shard, the training and the validation can use the streams
+// small files in the MNIST and CIFAR10 formats are written for the test
+// the tensor files are read back without copy, as matrices or as streams
+// the csv files are parsed in parallel by chunks of lines, the number of columns is checked
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+using namespace std;
+
+#include "Net.h"
+#include "NetTrain.h"
+#include "DataStream.h"
+#include "MappedFile.h"
+#include "MNISTReader.h"
+#include "CIFAR10Reader.h"
+#include "TensorFileReader.h"
+#include "CsvFileReader.h"
+#include "ThreadPool.h"
+
+#include "LayerActivation.h"
+#include "LayerDense.h"
+#include "LayerSoftmax.h"
+
+using namespace beednn;
+/////////////////////////////////////////////////////////////////////
+// for testU only
+void test(bool bTest, const string& sMessage = "")
+{
+	if (bTest) return;
+
+	cout << "Test failed: " << sMessage << endl;
+	exit(-1);
+}
+/////////////////////////////////////////////////////////////////////
+void write_big_endian(ofstream& f, unsigned int i)
+{
+	unsigned char c[4] = { (unsigned char)(i >> 24), (unsigned char)(i >> 16), (unsigned char)(i >> 8), (unsigned char)i };
+	f.write((const char*)c, 4);
+}
+/////////////////////////////////////////////////////////////////////
+// images of 4x5 pixels, the label is the brightest quarter
+void write_mnist(const string& sImages, const string& sLabels, unsigned int uiNbImages)
+{
+	ofstream fImages(sImages, ios::binary), fLabels(sLabels, ios::binary);
+	const unsigned char header3[4] = { 0, 0, 0x08, 0x03 }, header1[4] = { 0, 0, 0x08, 0x01 };
+	fImages.write((const char*)header3, 4);
+	write_big_endian(fImages, uiNbImages);
+	write_big_endian(fImages, 4);
+	write_big_endian(fImages, 5);
+	fLabels.write((const char*)header1, 4);
+	write_big_endian(fLabels, uiNbImages);
+
+	for (unsigned int i = 0; i < uiNbImages; i++)
+	{
+		unsigned char ucLabel = (unsigned char)(i % 4);
+		for (int j = 0; j < 20; j++)
+		{
+			unsigned char ucPixel = (unsigned char)((i * 7 + j * 13) % 128);
+			if (j / 5 == ucLabel)
+				ucPixel += 127;
+			fImages.write((const char*)&ucPixel, 1);
+		}
+		fLabels.write((const char*)&ucLabel, 1);
+	}
+}
+/////////////////////////////////////////////////////////////////////
+void read_stream(DataStream& stream, MatrixFloat& mSamples, MatrixFloat& mTruth)
+{
+	MatrixFloat mShardSamples, mShardTruth;
+	Index iStart = 0;
+	for (Index iShard = 0; iShard < stream.nb_shards(); iShard++)
+	{
+		test(stream.read_shard(iShard, mShardSamples, mShardTruth), "the shards must be read");
+		if (iShard == 0)
+		{
+			mSamples.resize(stream.nb_samples(), mShardSamples.cols());
+			mTruth.resize(stream.nb_samples(), mShardTruth.cols());
+		}
+		copyInto(mShardSamples, mSamples, iStart);
+		copyInto(mShardTruth, mTruth, iStart);
+		iStart += mShardSamples.rows();
+	}
+	test(iStart == stream.nb_samples(), "the shards must hold all the samples");
+}
+/////////////////////////////////////////////////////////////////////
+void test_mnist()
+{
+	cout << "MNIST:" << endl;
+
+	write_mnist("train-images.idx3-ubyte", "train-labels.idx1-ubyte", 1000);
+	write_mnist("t10k-images.idx3-ubyte", "t10k-labels.idx1-ubyte", 300);
+
+	MNISTReader mr, mrMapped;
+	test(mr.load("."), "MNIST load");
+	test(mrMapped.load_mapped(".", 256), "MNIST load_mapped");
+	test(mr.train_stream() == nullptr, "no stream with load()");
+	test(mrMapped.train_data().size() == 0, "no matrix with load_mapped()");
+	test(mrMapped.train_stream()->nb_samples() == 1000, "train stream size");
+	test(mrMapped.train_stream()->nb_shards() == 4, "train stream shards");
+
+	MatrixFloat mSamples, mTruth;
+	read_stream(*mrMapped.train_stream(), mSamples, mTruth);
+	test((mSamples.rows() == 1000) && (mSamples.cols() == 20), "train samples size");
+	test((mSamples - mr.train_data()).cwiseAbs().maxCoeff() == 0.f, "the mapped samples must be the loaded samples");
+	test((mTruth - mr.train_truth()).cwiseAbs().maxCoeff() == 0.f, "the mapped labels must be the loaded labels");
+
+	read_stream(*mrMapped.validation_stream(), mSamples, mTruth);
+	test((mSamples - mr.validation_data()).cwiseAbs().maxCoeff() == 0.f, "the mapped samples must be the loaded samples");
+	test((mTruth - mr.validation_truth()).cwiseAbs().maxCoeff() == 0.f, "the mapped labels must be the loaded labels");
+
+	// train on the streams, the validation is computed shard by shard
+	Net model;
+	model.add(new LayerDense(20, 16));
+	model.add(new LayerActivation("Relu"));
+	model.add(new LayerDense(16, 4));
+	model.add(new LayerSoftmax());
+
+	NetTrain netTrain;
+	netTrain.set_epochs(30);
+	netTrain.set_batchsize(16);
+	netTrain.set_loss("SparseCategoricalCrossEntropy");
+	netTrain.set_train_stream(mrMapped.train_stream());
+	netTrain.set_validation_stream(mrMapped.validation_stream());
+	netTrain.fit(model);
+
+	float fAccuracy, fAccuracyStream;
+	float fLoss = netTrain.compute_loss_accuracy(mr.validation_data(), mr.validation_truth(), &fAccuracy);
+	float fLossStream = netTrain.compute_loss_accuracy(*mrMapped.validation_stream(), &fAccuracyStream);
+	cout << "validation accuracy: " << fAccuracy << " %, on the stream: " << fAccuracyStream << " %" << endl;
+	test(abs(fLoss - fLossStream) < 1.e-4f, "same validation loss on the stream");
+	test(abs(fAccuracy - fAccuracyStream) < 1.e-3f, "same validation accuracy on the stream");
+	test(fAccuracy > 90.f, "the training on the mapped files must converge");
+
+	// a second load remaps the files, a failed load keeps no stream in the unmapped files
+	test(mrMapped.load_mapped(".", 256), "MNIST second load_mapped");
+	read_stream(*mrMapped.train_stream(), mSamples, mTruth);
+	test((mSamples - mr.train_data()).cwiseAbs().maxCoeff() == 0.f, "the samples mapped again must be the loaded samples");
+	test(!mrMapped.load_mapped("no_such_folder", 256), "MNIST load_mapped of a missing folder");
+	test((mrMapped.train_stream() == nullptr) && (mrMapped.validation_stream() == nullptr), "no stream after a failed load_mapped");
+
+	for (const char* sFile : { "train-images.idx3-ubyte", "train-labels.idx1-ubyte", "t10k-images.idx3-ubyte", "t10k-labels.idx1-ubyte" })
+		remove(sFile);
+}
+/////////////////////////////////////////////////////////////////////
+void test_cifar10()
+{
+	cout << "CIFAR10:" << endl;
+
+	// 20 records per file, the class byte then the 3072 pixels
+	const int iRecordSize = 32 * 32 * 3 + 1;
+	for (int iFile = 0; iFile < 6; iFile++)
+	{
+		ofstream f(iFile < 5 ? "data_batch_" + to_string(iFile + 1) + ".bin" : string("test_batch.bin"), ios::binary);
+		for (int i = 0; i < 20 * iRecordSize; i++)
+		{
+			unsigned char c = (unsigned char)(i % iRecordSize ? (i * 31 + iFile) % 256 : (i / iRecordSize + iFile) % 10);
+			f.write((const char*)&c, 1);
+		}
+	}
+
+	CIFAR10Reader cr;
+	test(cr.load_mapped(".", 30), "CIFAR10 load_mapped");
+	test(cr.train_stream()->nb_samples() == 100, "train stream size");
+
+	// the shards overlap the files
+	MatrixFloat mSamples, mTruth;
+	read_stream(*cr.train_stream(), mSamples, mTruth);
+	test((mSamples.rows() == 100) && (mSamples.cols() == 3072), "train samples size");
+	for (int iFile = 0; iFile < 5; iFile++)
+		for (int i = 0; i < 20; i++)
+		{
+			Index iSample = iFile * 20 + i;
+			test(mTruth(iSample) == (float)((i + iFile) % 10), "CIFAR10 label");
+			for (int j = 0; j < 3072; j++)
+				test(mSamples(iSample, j) == (float)(((i * iRecordSize + j + 1) * 31 + iFile) % 256) / 255.f, "CIFAR10 pixel");
+		}
+
+	test(!cr.load_mapped("no_such_folder", 30), "CIFAR10 load_mapped of a missing folder");
+	test((cr.train_stream() == nullptr) && (cr.validation_stream() == nullptr), "no stream after a failed load_mapped");
+
+	for (int iFile = 0; iFile < 5; iFile++)
+		remove(("data_batch_" + to_string(iFile + 1) + ".bin").c_str());
+	remove("test_batch.bin");
+}
+/////////////////////////////////////////////////////////////////////
+void test_tensor_file()
+{
+	cout << "Tensor file:" << endl;
+
+	MatrixFloat mTrainData, mTrainTruth, mValData;
+	mTrainData.setRandom(1000, 37);
+	mTrainTruth.setRandom(1000, 3);
+	mValData.setRandom(200, 37);
+	vector<unsigned char> vValTruth(200);
+	for (size_t i = 0; i < vValTruth.size(); i++)
+		vValTruth[i] = (unsigned char)(i % 10);
+
+	TensorFileWriter writer;
+	test(writer.open("dataset.bdt"), "tensor file open");
+	test(writer.write("train_data", mTrainData, 300), "tensor file write");
+	test(writer.write("train_truth", mTrainTruth, 300), "tensor file write");
+	test(writer.write("validation_data", mValData), "tensor file write");
+	test(writer.write("validation_truth", vValTruth.data(), 200, 1), "tensor file write");
+	test(!writer.write("a_name_longer_than_the_header", mValData), "the name must fit in the header");
+	test(writer.close(), "tensor file close");
+
+	TensorFileReader reader;
+	test(reader.load("dataset.bdt"), "tensor file load");
+	test(reader.has_train_data() && reader.has_validation_data(), "tensor file data");
+	test(reader.file().nb_tensors() == 4, "tensor file tensors");
+	test(reader.file().find("train_data")->iChunkRows == 300, "tensor file chunks");
+	test((reader.train_data() - mTrainData).cwiseAbs().maxCoeff() == 0.f, "same train data");
+	test((reader.train_truth() - mTrainTruth).cwiseAbs().maxCoeff() == 0.f, "same train truth");
+	test((reader.validation_data() - mValData).cwiseAbs().maxCoeff() == 0.f, "same validation data");
+	for (Index i = 0; i < 200; i++)
+		test(reader.validation_truth()(i) == (float)(i % 10), "same validation truth");
+	test(((size_t)reader.train_data().data() % 64) == 0, "the tensors are 64 bytes aligned");
+#ifndef USE_EIGEN
+	test(reader.train_data().data() == (const float*)reader.file().find("train_data")->pData, "the float tensors must not be copied");
+#endif
+
+	// streams, shards of the file chunks
+	test(reader.load_mapped("dataset.bdt"), "tensor file load_mapped");
+	test(reader.train_data().size() == 0, "no matrix with load_mapped()");
+	test(reader.train_stream()->nb_shards() == 4, "the shards are the chunks");
+	MatrixFloat mSamples, mTruth;
+	read_stream(*reader.train_stream(), mSamples, mTruth);
+	test((mSamples - mTrainData).cwiseAbs().maxCoeff() == 0.f, "same train data in the stream");
+	test((mTruth - mTrainTruth).cwiseAbs().maxCoeff() == 0.f, "same train truth in the stream");
+	read_stream(*reader.validation_stream(), mSamples, mTruth);
+	test((mSamples - mValData).cwiseAbs().maxCoeff() == 0.f, "same validation data in the stream");
+
+	// a truncated file is not a tensor file
+	{
+		ifstream fIn("dataset.bdt", ios::binary);
+		ofstream fOut("truncated.bdt", ios::binary);
+		vector<char> vData(1000 * 37 * 4);
+		fIn.read(vData.data(), vData.size());
+		fOut.write(vData.data(), vData.size());
+	}
+	TensorFileReader truncated;
+	test(!truncated.load("truncated.bdt"), "a truncated file must not be loaded");
+	test(!truncated.load("not_a_file.bdt"), "a missing file must not be loaded");
+
+	remove("dataset.bdt");
+	remove("truncated.bdt");
+}
+/////////////////////////////////////////////////////////////////////
+void write_text(const string& sFile, const string& sText)
+{
+	ofstream f(sFile, ios::binary);
+	f << sText;
+}
+/////////////////////////////////////////////////////////////////////
+void test_csv()
+{
+	cout << "CSV:" << endl;
+
+	// separators, signs, exponents, empty lines, CRLF and no end of line at the end
+	write_text("values.csv", "1,2.5,-3\r\n\n +4.0e2 , 5 ;\t-6e-2 \r\n,,\n1e-40,3.4e38,-0\n7,8,9");
+	MatrixFloat m;
+	test(fromFile("values.csv", m), "csv parse");
+	test((m.rows() == 4) && (m.cols() == 3), "csv size");
+	const float fExpected[] = { 1.f, 2.5f, -3.f, 400.f, 5.f, -0.06f, 1e-40f, 3.4e38f, -0.f, 7.f, 8.f, 9.f };
+	for (Index i = 0; i < m.size(); i++)
+		test(m(i) == fExpected[i], "csv values");
+
+	// errors
+	write_text("columns.csv", "1 2 3\n4 5\n");
+	test(!fromFile("columns.csv", m), "the lines must have the same number of columns");
+	test(fromFile("columns.csv").size() == 0, "a csv file not valid is empty");
+	write_text("garbage.csv", "1 2 3\n4 5x 6\n");
+	test(!fromFile("garbage.csv", m), "the values must be numbers");
+	test(!fromFile("not_a_file.csv", m), "a missing file must not be read");
+
+	// many lines, the chunks are parsed in parallel, same result whatever the number of threads
+	MatrixFloat mData, mTruth;
+	mData.setRandom(50000, 16);
+	mTruth.setRandom(50000, 1);
+	{
+		ofstream fData("big_train_data.csv"), fTruth("big_train_truth.csv");
+		fData.precision(9);
+		fTruth.precision(9);
+		for (Index i = 0; i < mData.rows(); i++)
+		{
+			for (Index j = 0; j < mData.cols(); j++)
+				fData << mData(i, j) << (j + 1 < mData.cols() ? "," : "\n");
+			fTruth << mTruth(i) << "\n";
+		}
+	}
+
+	for (int iNbThreads : { 1, 4 })
+	{
+		set_nb_threads(iNbThreads);
+		auto start = chrono::steady_clock::now();
+		CsvFileReader csv;
+		test(csv.load("big_train_data.csv"), "csv load");
+		auto delta = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+		cout << iNbThreads << " thread(s): " << csv.train_data().rows() << " lines in " << delta << " ms" << endl;
+		test((csv.train_data() - mData).cwiseAbs().maxCoeff() == 0.f, "the floats must be parsed exactly");
+		test((csv.train_truth() - mTruth).cwiseAbs().maxCoeff() == 0.f, "the floats must be parsed exactly");
+	}
+	set_nb_threads(1);
+
+	// the truth must have the same number of rows
+	write_text("small_train_data.csv", "1 2\n3 4\n");
+	write_text("small_train_truth.csv", "1\n");
+	CsvFileReader csv;
+	test(!csv.load("small_train_data.csv"), "the data and the truth must have the same number of rows");
+
+	for (const char* sFile : { "values.csv", "columns.csv", "garbage.csv", "big_train_data.csv", "big_train_truth.csv", "small_train_data.csv", "small_train_truth.csv" })
+		remove(sFile);
+}
+/////////////////////////////////////////////////////////////////////
+int main()
+{
+	MappedFile file;
+	test(!file.open("not_a_file.bin"), "a missing file must not be mapped");
+	test(!file.is_open(), "a missing file must not be mapped");
+
+	test_mnist();
+	test_cifar10();
+	test_tensor_file();
+	test_csv();
+
+	cout << "Test succeded." << endl;
+	return 0;
+}
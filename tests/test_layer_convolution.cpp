@@ -1,7 +1,11 @@
 #include <iostream>
 #include <chrono>
+#include <string>
+#include <vector>
 
 #include "LayerConvolution2D.h"
+#include "LayerZeroPadding2D.h"
+#include "ThreadPool.h"
 
 using namespace std;
 using namespace beednn;
@@ -424,6 +428,349 @@ void backward_time()
 
 }
 /////////////////////////////////////////////////////////////////
+void im2col_col2im_time()
+{
+	cout << "im2col and col2im time estimation:" << endl;
+
+	// CIFAR10 like first layer
+	int iNbSamples = 64;
+	int iInRows = 32;
+	int iInCols = 32;
+	int iInChannels = 3;
+	int iOutChannels = 32;
+	int iNbConv = 20;
+
+	MatrixFloat mIn, mOut, mCol, mIm, mColRef, mImRef;
+	mIn.setRandom(iNbSamples, iInRows*iInCols*iInChannels);
+
+	LayerConvolution2D conv2d(iInRows, iInCols, iInChannels, 3, 3, iOutChannels);
+	conv2d.forward(mIn, mOut); // init backward internal state
+
+	for (int iNbThreads : { 1, 0 })
+	{
+		set_nb_threads(iNbThreads);
+
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < iNbConv; i++)
+			conv2d.im2col_LUT(mIn, mCol);
+		auto end = chrono::steady_clock::now();
+		auto delta = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+		cout << get_nb_threads() << " thread(s), im2col_LUT: " << delta / iNbConv << " us";
+
+		start = chrono::steady_clock::now();
+		for (int i = 0; i < iNbConv; i++)
+			conv2d.col2im_LUT(mCol, mIm);
+		end = chrono::steady_clock::now();
+		delta = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+		cout << ", col2im_LUT: " << delta / iNbConv << " us" << endl;
+
+		if (iNbThreads == 1)
+		{
+			mColRef = mCol;
+			mImRef = mIm;
+		}
+	}
+	set_nb_threads(1);
+
+	//testu function, the tiles are independent: same result whatever the number of threads
+	float fMaxDiff = max((mCol - mColRef).cwiseAbs().maxCoeff(), (mIm - mImRef).cwiseAbs().maxCoeff());
+	if (fMaxDiff != 0.f)
+	{
+		cout << "Test failed! MaxDifference = " << fMaxDiff << endl;
+		exit(-1);
+	}
+	else
+		cout << "Test Succeded. MaxDifference = " << fMaxDiff << endl << endl;
+}
+/////////////////////////////////////////////////////////////////
+void compare_direct_im2col()
+{
+	cout << "Comparing direct and im2col convolutions:" << endl;
+
+	// shapes with tile borders, strides and non square kernels
+	Index vShapes[][8] = { { 28, 28, 1, 3, 3, 8, 1, 1 }, { 26, 26, 8, 3, 3, 8, 2, 2 }, { 31, 23, 13, 5, 3, 17, 1, 1 }, { 15, 17, 3, 3, 5, 5, 2, 1 } };
+
+	for (auto& v : vShapes)
+	{
+		MatrixFloat mIn, mOut, mOutDirect, mGradientOut, mGradientIn, mGradientInDirect, mGradientWeight;
+		mIn.setRandom(5, v[0] * v[1] * v[2]);
+
+		LayerConvolution2D conv2d(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+		conv2d.set_algorithm("Im2Col");
+		conv2d.forward(mIn, mOut);
+		mGradientOut.setRandom(mOut.rows(), mOut.cols());
+		conv2d.backpropagation(mIn, mGradientOut, mGradientIn);
+		mGradientWeight = get_gradient(conv2d);
+
+		conv2d.set_algorithm("Direct");
+		conv2d.forward(mIn, mOutDirect);
+		conv2d.backpropagation(mIn, mGradientOut, mGradientInDirect);
+
+		float fMaxDiff = (mOut - mOutDirect).cwiseAbs().maxCoeff();
+		float fMaxDiffGradient = max((mGradientIn - mGradientInDirect).cwiseAbs().maxCoeff(), (mGradientWeight - get_gradient(conv2d)).cwiseAbs().maxCoeff());
+
+		//testu function
+		if ((fMaxDiff > 1.e-5f) || (fMaxDiffGradient != 0.f))
+		{
+			cout << "Test failed! MaxDifference = " << fMaxDiff << " MaxDifferenceGradient = " << fMaxDiffGradient << endl;
+			exit(-1);
+		}
+		else
+			cout << "Test Succeded. MaxDifference = " << fMaxDiff << endl;
+	}
+}
+/////////////////////////////////////////////////////////////////
+void compare_winograd_im2col()
+{
+	cout << "Comparing Winograd and im2col convolutions:" << endl;
+
+	// sizes not multiple of the tiles
+	Index vShapes[][4] = { { 28, 28, 1, 8 }, { 13, 17, 16, 8 }, { 12, 12, 32, 64 } };
+
+	for (auto& v : vShapes)
+	{
+		for (string sAlgorithm : { "Winograd2x2", "Winograd4x4" })
+		{
+			MatrixFloat mIn, mOut, mOutWinograd, mGradientOut, mGradientIn, mGradientInWinograd, mGradientWeight;
+			mIn.setRandom(5, v[0] * v[1] * v[2]);
+
+			LayerConvolution2D conv2d(v[0], v[1], v[2], 3, 3, v[3]);
+			conv2d.set_algorithm("Im2Col");
+			conv2d.forward(mIn, mOut);
+			mGradientOut.setRandom(mOut.rows(), mOut.cols());
+			conv2d.backpropagation(mIn, mGradientOut, mGradientIn);
+			mGradientWeight = get_gradient(conv2d);
+
+			conv2d.set_algorithm(sAlgorithm);
+			conv2d.forward(mIn, mOutWinograd);
+			conv2d.backpropagation(mIn, mGradientOut, mGradientInWinograd);
+
+			vector<MatrixFloat> vScratch;
+			MatrixFloat mOutPredict;
+			conv2d.predict(mIn, mOutPredict, vScratch);
+
+			// relative to the biggest values
+			float fDiffOut = (mOut - mOutWinograd).cwiseAbs().maxCoeff() / mOut.cwiseAbs().maxCoeff();
+			float fDiffGradientIn = (mGradientIn - mGradientInWinograd).cwiseAbs().maxCoeff() / mGradientIn.cwiseAbs().maxCoeff();
+			float fDiffGradientWeight = (mGradientWeight - get_gradient(conv2d)).cwiseAbs().maxCoeff() / mGradientWeight.cwiseAbs().maxCoeff();
+			float fDiffPredict = (mOutWinograd - mOutPredict).cwiseAbs().maxCoeff();
+
+			// the weights changed: the transformed weights in the context are computed again, doubled weights give a doubled output
+			*conv2d.weights()[0] *= 2.f;
+			MatrixFloat mOutPredictDoubled;
+			conv2d.predict(mIn, mOutPredictDoubled, vScratch);
+			fDiffPredict = max(fDiffPredict, (mOutPredictDoubled - mOutPredict * 2.f).cwiseAbs().maxCoeff());
+			float fMaxDiff = max(max(fDiffOut, fDiffGradientIn), fDiffGradientWeight);
+
+			//testu function
+			if ((conv2d.algorithm() != sAlgorithm) || (fMaxDiff > 1.e-5f) || (fDiffPredict != 0.f))
+			{
+				cout << "Test failed! " << sAlgorithm << " RelativeDifferenceOut = " << fDiffOut << " RelativeDifferenceGradientIn = " << fDiffGradientIn
+					<< " RelativeDifferenceGradientWeight = " << fDiffGradientWeight << " DifferencePredict = " << fDiffPredict << endl;
+				exit(-1);
+			}
+			else
+				cout << "Test Succeded. " << sAlgorithm << " RelativeDifference = " << fMaxDiff << endl;
+		}
+	}
+
+	// only the 3x3 kernels with stride 1
+	LayerConvolution2D conv2dStride(13, 13, 4, 3, 3, 4, 2, 2);
+	conv2dStride.set_algorithm("Winograd4x4");
+	if (conv2dStride.algorithm() != "Im2Col")
+	{
+		cout << "Test failed! Winograd with stride 2" << endl;
+		exit(-1);
+	}
+}
+/////////////////////////////////////////////////////////////////
+void compare_padding_dilation()
+{
+	cout << "Comparing padded and dilated convolutions with ZeroPadding2D and a kernel dilated with zeros:" << endl;
+
+	// rows, cols, in channels, kernel rows, kernel cols, out channels, stride, padding, dilation
+	Index vShapes[][9] = { { 28, 28, 1, 3, 3, 8, 1, 1, 1 }, { 13, 17, 16, 3, 3, 8, 1, 1, 1 }, { 15, 17, 3, 3, 5, 5, 2, 2, 1 }, { 16, 16, 4, 3, 3, 6, 1, 2, 2 }, { 31, 23, 13, 5, 3, 17, 1, 2, 3 } };
+
+	for (auto& v : vShapes)
+	{
+		Index iKernelRowsDilated = v[8] * (v[3] - 1) + 1, iKernelColsDilated = v[8] * (v[4] - 1) + 1;
+		MatrixFloat mIn, mPadded, mOutRef, mGradientOut, mGradientPadded, mGradientInRef, mWeightRef;
+		mIn.setRandom(5, v[0] * v[1] * v[2]);
+
+		LayerConvolution2D conv2d(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[6], v[7], v[7], v[8], v[8]);
+
+		// reference: ZeroPadding2D copy and a kernel with zeros between the taps
+		LayerZeroPadding2D zeroPadding(v[0], v[1], v[2], v[7]);
+		LayerConvolution2D conv2dRef(v[0] + 2 * v[7], v[1] + 2 * v[7], v[2], iKernelRowsDilated, iKernelColsDilated, v[5], v[6], v[6]);
+		conv2dRef.set_algorithm("Im2Col");
+		mWeightRef.setZero(v[5], iKernelRowsDilated * iKernelColsDilated * v[2]);
+		for (Index iOut = 0; iOut < v[5]; iOut++)
+			for (Index iIn = 0; iIn < v[2]; iIn++)
+				for (Index r = 0; r < v[3]; r++)
+					for (Index c = 0; c < v[4]; c++)
+						mWeightRef(iOut, (iIn * iKernelRowsDilated + r * v[8]) * iKernelColsDilated + c * v[8]) = conv2d.weights()[0]->operator()(iOut, (iIn * v[3] + r) * v[4] + c);
+		set_weight(conv2dRef, mWeightRef);
+
+		zeroPadding.forward(mIn, mPadded);
+		conv2dRef.forward(mPadded, mOutRef);
+		mGradientOut.setRandom(mOutRef.rows(), mOutRef.cols());
+		conv2dRef.backpropagation(mPadded, mGradientOut, mGradientPadded);
+		zeroPadding.backpropagation(mIn, mGradientPadded, mGradientInRef);
+		mGradientInRef *= (float)(iKernelRowsDilated * iKernelColsDilated) / (v[3] * v[4]); // mean on the real taps
+
+		for (string sAlgorithm : { "Reference", "Im2Col", "Direct", "Winograd2x2", "Winograd4x4" })
+		{
+			MatrixFloat mOut, mGradientIn;
+			conv2d.fastLUT = (sAlgorithm != "Reference");
+			conv2d.set_algorithm(conv2d.fastLUT ? sAlgorithm : "Auto");
+			conv2d.forward(mIn, mOut);
+			conv2d.backpropagation(mIn, mGradientOut, mGradientIn);
+
+			// the gradient of the real taps
+			float fDiffGradientWeight = 0.f;
+			for (Index iOut = 0; iOut < v[5]; iOut++)
+				for (Index iIn = 0; iIn < v[2]; iIn++)
+					for (Index r = 0; r < v[3]; r++)
+						for (Index c = 0; c < v[4]; c++)
+							fDiffGradientWeight = max(fDiffGradientWeight, fabs(get_gradient(conv2d)(iOut, (iIn * v[3] + r) * v[4] + c) - get_gradient(conv2dRef)(iOut, (iIn * iKernelRowsDilated + r * v[8]) * iKernelColsDilated + c * v[8])));
+			fDiffGradientWeight /= get_gradient(conv2dRef).cwiseAbs().maxCoeff();
+
+			if ((mOut.rows() != mOutRef.rows()) || (mOut.cols() != mOutRef.cols()))
+			{
+				cout << "Test failed! " << sAlgorithm << " output size" << endl;
+				exit(-1);
+			}
+
+			// relative to the biggest values
+			float fDiffOut = (mOut - mOutRef).cwiseAbs().maxCoeff() / mOutRef.cwiseAbs().maxCoeff();
+			float fDiffGradientIn = (mGradientIn - mGradientInRef).cwiseAbs().maxCoeff() / mGradientInRef.cwiseAbs().maxCoeff();
+			float fMaxDiff = max(max(fDiffOut, fDiffGradientIn), fDiffGradientWeight);
+
+			//testu function
+			if (fMaxDiff > 1.e-5f)
+			{
+				cout << "Test failed! " << sAlgorithm << " (" << conv2d.algorithm() << ") RelativeDifferenceOut = " << fDiffOut << " RelativeDifferenceGradientIn = " << fDiffGradientIn
+					<< " RelativeDifferenceGradientWeight = " << fDiffGradientWeight << endl;
+				exit(-1);
+			}
+			else
+				cout << "Test Succeded. " << sAlgorithm << " (" << conv2d.algorithm() << ") RelativeDifference = " << fMaxDiff << endl;
+		}
+	}
+
+	// 'same' output size
+	LayerConvolution2D conv2dSame(28, 28, 8, 3, 3, 8, 1, 1, 2, 2, 2, 2);
+	Index iOutRows, iOutCols;
+	conv2dSame.get_output_size(iOutRows, iOutCols);
+	if ((iOutRows != 28) || (iOutCols != 28))
+	{
+		cout << "Test failed! 'same' output size = " << iOutRows << "x" << iOutCols << endl;
+		exit(-1);
+	}
+}
+/////////////////////////////////////////////////////////////////
+void padding_time()
+{
+	cout << "'same' convolution time estimation, forward and backpropagation:" << endl;
+
+	Index iNbSamples = 64, iRows = 32, iCols = 32, iChannels = 16;
+	int iNbConv = 10;
+	MatrixFloat mIn, mPadded, mOut, mGradientOut, mGradientPadded, mGradientIn;
+	mIn.setRandom(iNbSamples, iRows * iCols * iChannels);
+	mGradientOut.setRandom(iNbSamples, iRows * iCols * iChannels);
+
+	LayerZeroPadding2D zeroPadding(iRows, iCols, iChannels, 1);
+	LayerConvolution2D conv2dValid(iRows + 2, iCols + 2, iChannels, 3, 3, iChannels);
+	LayerConvolution2D conv2dSame(iRows, iCols, iChannels, 3, 3, iChannels, 1, 1, 1, 1);
+	conv2dValid.set_algorithm("Im2Col");
+	conv2dSame.set_algorithm("Im2Col");
+
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < iNbConv; i++)
+	{
+		zeroPadding.forward(mIn, mPadded);
+		conv2dValid.forward(mPadded, mOut);
+		conv2dValid.backpropagation(mPadded, mGradientOut, mGradientPadded);
+		zeroPadding.backpropagation(mIn, mGradientPadded, mGradientIn);
+	}
+	auto end = chrono::steady_clock::now();
+	auto delta = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	cout << "ZeroPadding2D and Convolution2D: " << delta / iNbConv << " us";
+
+	start = chrono::steady_clock::now();
+	for (int i = 0; i < iNbConv; i++)
+	{
+		conv2dSame.forward(mIn, mOut);
+		conv2dSame.backpropagation(mIn, mGradientOut, mGradientIn);
+	}
+	end = chrono::steady_clock::now();
+	delta = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	cout << ", padded Convolution2D: " << delta / iNbConv << " us" << endl;
+}
+/////////////////////////////////////////////////////////////////
+void direct_time()
+{
+	cout << "Direct, im2col and Winograd convolutions time estimation:" << endl;
+
+	// MNIST all convolutional and CIFAR10 samples layers, then bigger layers
+	Index vShapes[][7] = { { 28, 28, 1, 3, 8, 1 }, { 26, 26, 8, 3, 8, 2 }, { 12, 12, 8, 3, 16, 1 }, { 32, 32, 3, 3, 8, 1 }, { 15, 15, 8, 3, 16, 1 }, { 32, 32, 16, 3, 32, 1 }, { 16, 16, 64, 3, 64, 1 }, { 8, 8, 128, 3, 128, 1 } };
+	int iNbSamples = 64;
+	int iNbConv = 10;
+
+	for (auto& v : vShapes)
+	{
+		MatrixFloat mIn, mOut;
+		mIn.setRandom(iNbSamples, v[0] * v[1] * v[2]);
+
+		LayerConvolution2D conv2d(v[0], v[1], v[2], v[3], v[3], v[4], v[5], v[5]);
+		cout << v[0] << "x" << v[1] << "x" << v[2] << " -> " << v[4] << " channels, stride " << v[5] << ", auto: " << conv2d.algorithm();
+
+		// fastest of iNbConv predicts, less sensitive to the load of the machine than the mean
+		long long iTimeIm2Col = 0, iTimeDirect = 0, iTimeAuto = 0;
+		for (string sAlgorithm : { "Im2Col", "Direct", "Winograd2x2", "Winograd4x4", "Auto" })
+		{
+			conv2d.set_algorithm(sAlgorithm);
+			vector<MatrixFloat> vScratch;
+			conv2d.predict(mIn, mOut, vScratch);
+
+			long long iTime = 0;
+			for (int i = 0; i < iNbConv; i++)
+			{
+				auto start = chrono::steady_clock::now();
+				conv2d.predict(mIn, mOut, vScratch);
+				auto end = chrono::steady_clock::now();
+				long long iDelta = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+				iTime = (i == 0) ? iDelta : min(iTime, iDelta);
+			}
+
+			if (sAlgorithm == "Im2Col")
+				iTimeIm2Col = iTime;
+			else if (sAlgorithm == "Direct")
+				iTimeDirect = iTime;
+			else if (sAlgorithm == "Auto")
+				iTimeAuto = iTime;
+			else if (conv2d.algorithm() == sAlgorithm)
+				cout << ", " << sAlgorithm << ": " << iTime << " us";
+		}
+		cout << ", Direct: " << iTimeDirect << " us, Im2Col: " << iTimeIm2Col << " us, Auto: " << iTimeAuto << " us" << endl;
+
+		// the Auto choice must not be slower than im2col, with a margin for the timing noise
+		if (iTimeAuto > iTimeIm2Col * 1.2)
+		{
+			cout << "Test failed! Auto is slower than Im2Col" << endl;
+			exit(-1);
+		}
+
+		// the shapes above the Direct kernel size limit must be faster with im2col: the limit is not too low
+		if ((conv2d.algorithm() == "Im2Col") && (iTimeDirect * 1.2 < iTimeIm2Col))
+		{
+			cout << "Test failed! Direct is faster than Im2Col above the kernel size limit" << endl;
+			exit(-1);
+		}
+	}
+	cout << endl;
+}
+/////////////////////////////////////////////////////////////////
 int main()
 {	
 	compare_im2col(); 
@@ -440,5 +787,11 @@ int main()
 	forward_stride2_backward();
 	forward_time();	
 	backward_time();
+	im2col_col2im_time();
+	compare_direct_im2col();
+	compare_winograd_im2col();
+	compare_padding_dilation();
+	padding_time();
+	direct_time();
 }
 /////////////////////////////////////////////////////////////////
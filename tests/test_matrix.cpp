@@ -141,9 +141,101 @@ void test_hyperbolic()
 	}
 }
 ////////////////////////////////////////////////////////
+void test_expressions()
+{
+	std::cout << "test_expressions:" << std::endl;
+
+	// odd size, bigger than an expression block
+	MatrixFloat mA, mB, mC;
+	mA.setRandom(37, 29);
+	mB.setRandom(37, 29);
+	mB = mB.cwiseAbs().array() + 0.5f;
+
+	// Adam like chain, fused
+	mC = mA.cwiseQuotient((mB * 2.f).cwiseSqrt().cwiseMax(1.e-8f)) * 0.1f + mA * 0.5f;
+	float fMaxError = 0.f;
+	for (Index i = 0; i < mC.size(); i++)
+	{
+		float fRef = mA(i) / std::max(sqrtf(mB(i) * 2.f), 1.e-8f) * 0.1f + mA(i) * 0.5f;
+		fMaxError = std::max(fMaxError, fabsf(mC(i) - fRef));
+	}
+	test(is_near(fMaxError, 0., 1.e-6), "fused chain");
+
+	// the destination is read by the expression
+	MatrixFloat mRef = mA;
+	mA = mB + mA * 3.f;
+	for (Index i = 0; i < mA.size(); i++)
+		fMaxError = std::max(fMaxError, fabsf(mA(i) - (mB(i) + mRef(i) * 3.f)));
+	test(is_near(fMaxError, 0., 1.e-6), "aliased expression");
+
+	mRef = mA;
+	mA -= mA.cwiseProduct(mB);
+	for (Index i = 0; i < mA.size(); i++)
+		fMaxError = std::max(fMaxError, fabsf(mA(i) - (mRef(i) - mRef(i) * mB(i))));
+	test(is_near(fMaxError, 0., 1.e-6), "aliased compound assignment");
+
+	// assignment in a view writes in the viewed matrix
+	MatrixFloatView mView = createView(mC);
+	mView = mB.array() * 0.f + 1.f;
+	test(is_near(mC(5, 7), 1.), "expression assigned in a view");
+
+	// reductions on expressions
+	test(is_near((mA - mA).cwiseAbs().maxCoeff(), 0.), "maxCoeff of expression");
+	test(is_near((mB.array() * 0.f + 2.f).sum(), 2. * mB.size(), 1.e-3), "sum of expression");
+	test(is_near((mB.array() * 0.f + 2.f).exp().mean(), exp(2.), 1.e-5), "mean of exp expression");
+
+	std::cout << "test_expressions finished" << std::endl;
+}
+////////////////////////////////////////////////////////
+void test_capacity()
+{
+#ifndef USE_EIGEN
+	std::cout << "test_capacity:" << std::endl;
+
+	MatrixFloat m(32, 10);
+	float* pData = m.data();
+	test((size_t)pData % MATRIX_ALIGNMENT == 0, "data must be aligned");
+	test(m.capacity() == 320, "capacity after construction");
+
+	// a smaller batch, then the full batch again: no reallocation
+	m.resize(7, 10);
+	test(m.data() == pData, "shrinking resize must keep the memory");
+	test(m.size() == 70 && m.capacity() == 320, "size and capacity after shrink");
+	m.resize(32, 10);
+	test(m.data() == pData, "regrow up to the capacity must keep the memory");
+
+	// reserve keeps the data
+	m.setConstant(3.f);
+	m.reserve(1000);
+	test(m.capacity() == 1000 && m.size() == 320, "reserve");
+	test((size_t)m.data() % MATRIX_ALIGNMENT == 0, "reserved data must be aligned");
+	test(m(31, 9) == 3.f, "reserve must keep the data");
+	pData = m.data();
+	m.resize(100, 10);
+	test(m.data() == pData, "resize in the reserved capacity");
+
+	m.resize(2, 3);
+	m.setConstant(5.f);
+	m.shrink_to_fit();
+	test(m.capacity() == 6 && m(1, 2) == 5.f, "shrink_to_fit");
+
+	// a view of the same size stays a view, else it becomes a matrix
+	MatrixFloatView mView = createView(m);
+	mView.resize(3, 2);
+	test(mView.data() == m.data(), "same size view resize");
+	mView.resize(4, 4);
+	test(mView.data() != m.data(), "bigger view resize");
+	test((size_t)mView.data() % MATRIX_ALIGNMENT == 0, "view resize must be aligned");
+
+	std::cout << "test_capacity finished" << std::endl;
+#endif
+}
+////////////////////////////////////////////////////////
 int main()
 {
 	test_elementary();
+	test_expressions();
+	test_capacity();
 	test_matrixView();
 	test_bernoulli();
 	test_hyperbolic();
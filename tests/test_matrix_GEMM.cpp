@@ -3,6 +3,7 @@
 #include <chrono>
 
 #include "Matrix.h"
+#include "ThreadPool.h"
 
 using namespace std;
 using namespace beednn;
@@ -374,9 +375,136 @@ void test_GEMM_order()
 	}
 }
 ////////////////////////////////////////////////////////
+void test_GEMM_packed()
+{
+	using namespace std;
+	std::cout << endl << "Packed GEMM test:" << endl;
+
+	chrono::steady_clock::time_point start, end;
+
+	// odd sizes, to test the partial micro tiles and panels
+	const Index sizes[][3] = { {1,1,1}, {7,5,3}, {33,65,17}, {97,131,203}, {255,257,259}, {521,300,1030} };
+
+	for (const auto& sz : sizes)
+	{
+		MatrixFloat m1;
+		m1.setRandom(sz[0], sz[1]);
+
+		MatrixFloat m2;
+		m2.setRandom(sz[1], sz[2]);
+
+		start = chrono::steady_clock::now();
+		MatrixFloat m3Packed = m1 * m2;
+		end = chrono::steady_clock::now();
+		long long deltaPacked = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+		start = chrono::steady_clock::now();
+		MatrixFloat m3RKC;
+		GEMM_row_k_col(m1, m2, m3RKC);
+		end = chrono::steady_clock::now();
+		long long deltaRKC = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+		start = chrono::steady_clock::now();
+		MatrixFloat m3CRKptr;
+		GEMM_col_row_k_ptr(m1, m2, m3CRKptr);
+		end = chrono::steady_clock::now();
+		long long deltaCRKptr = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+		float fError = (m3Packed - m3RKC).cwiseAbs().maxCoeff();
+		test(is_near(fError / (float)sz[1], 0.), "packed GEMM differs from RKC");
+		test(is_near((m3Packed - m3CRKptr).cwiseAbs().maxCoeff() / (float)sz[1], 0.), "packed GEMM differs from CRKptr");
+
+		// in place product
+		MatrixFloat m3InPlace = m1;
+		m3InPlace *= m2;
+		test(is_near((m3Packed - m3InPlace).cwiseAbs().maxCoeff(), 0.), "operator*= differs from operator*");
+
+		double dGFlops = 2.*sz[0] * sz[1] * sz[2] / (deltaPacked + 1.) * 1.e-3;
+		cout << "size:" << sz[0] << "x" << sz[1] << "x" << sz[2] << "  Packed/RKC/CRKptr time (us): "
+			<< deltaPacked << "/" << deltaRKC << "/" << deltaCRKptr
+			<< "  Packed GFlops: " << dGFlops << endl;
+	}
+}
+////////////////////////////////////////////////////////
+void test_GEMM_transposed()
+{
+	std::cout << endl << "Transposed GEMM test:" << endl;
 
+	MatrixFloat mA, mB, mAT, mBT, mC, mRef;
+	mA.setRandom(67, 131);
+	mB.setRandom(131, 45);
+	mAT = mA.transpose();
+	mBT = mB.transpose();
+
+	MatrixFloat mAB = mA * mB;
+
+	gemm(mA, false, mB, false, mC);
+	test(is_near((mC - mAB).cwiseAbs().maxCoeff(), 0.), "gemm A*B");
+
+	gemm(mAT, true, mB, false, mC);
+	test(is_near((mC - mAB).cwiseAbs().maxCoeff(), 0.), "gemm AT^T*B");
+
+	gemm(mA, false, mBT, true, mC);
+	test(is_near((mC - mAB).cwiseAbs().maxCoeff(), 0.), "gemm A*BT^T");
+
+	gemm(mAT, true, mBT, true, mC);
+	test(is_near((mC - mAB).cwiseAbs().maxCoeff(), 0.), "gemm AT^T*BT^T");
+
+	// alpha and beta
+	mRef = mC;
+	gemm(mA, false, mB, false, mC, 0.5f, 2.f);
+	test(is_near((mC - (mRef * 2.f + mAB * 0.5f)).cwiseAbs().maxCoeff(), 0.), "gemm alpha beta");
+
+	std::cout << "Transposed GEMM test finished" << endl;
+}
+////////////////////////////////////////////////////////
+void test_GEMM_multithread()
+{
+	std::cout << endl << "Multithreaded GEMM test:" << endl;
+
+	chrono::steady_clock::time_point start, end;
+
+	MatrixFloat m1, m2, m3Single, m3Multi;
+	m1.setRandom(517, 601);
+	m2.setRandom(601, 389);
+
+	set_nb_threads(1);
+	start = chrono::steady_clock::now();
+	gemm(m1, false, m2, false, m3Single);
+	end = chrono::steady_clock::now();
+	long long deltaSingle = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+	// more threads than cpu cores is legal, and the result must not depend on the number of threads
+	for (int iNbThreads : { 2, 3, 4, 0 })
+	{
+		set_nb_threads(iNbThreads);
+		start = chrono::steady_clock::now();
+		gemm(m1, false, m2, false, m3Multi);
+		end = chrono::steady_clock::now();
+		long long deltaMulti = chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+		test((m3Multi - m3Single).cwiseAbs().maxCoeff() == 0.f, "multithreaded GEMM differs from single thread");
+
+		// thin matrix: less rows panels than threads
+		MatrixFloat mThin, mThinSingle, mThinMulti;
+		mThin.setRandom(37, 601);
+		gemm(mThin, false, m2, false, mThinMulti);
+		set_nb_threads(1);
+		gemm(mThin, false, m2, false, mThinSingle);
+		test((mThinMulti - mThinSingle).cwiseAbs().maxCoeff() == 0.f, "multithreaded thin GEMM differs from single thread");
+
+		cout << "nb_threads:" << iNbThreads << "  Single/Multi time (us): " << deltaSingle << "/" << deltaMulti << endl;
+	}
+
+	set_nb_threads(1);
+	std::cout << "Multithreaded GEMM test finished" << endl;
+}
+////////////////////////////////////////////////////////
 int main()
 {
+	test_GEMM_transposed();
+	test_GEMM_packed();
+	test_GEMM_multithread();
 	test_GEMM_order();
 
     std::cout << "Tests finished." << std::endl;
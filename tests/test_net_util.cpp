@@ -0,0 +1,165 @@
+// the binary model gives the same predictions as the saved model, with the weights mapped or copied
+// the mapped weights are viewed in the file without copy, the training copies the written pages and does not modify the file
+// the layers that can not be created again are refused, as the invalid files
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <iterator>
+#include <cstddef>
+using namespace std;
+
+#include "Net.h"
+#include "NetTrain.h"
+#include "NetUtil.h"
+#include "Layer.h"
+
+#include "LayerActivation.h"
+#include "LayerConvolution2D.h"
+#include "LayerDense.h"
+#include "LayerDropout.h"
+#include "LayerGlobalGain.h"
+#include "LayerSimplestRNN.h"
+#include "LayerSoftmax.h"
+
+using namespace beednn;
+/////////////////////////////////////////////////////////////////////
+// for testU only
+void test(bool bTest, const string& sMessage = "")
+{
+	if (bTest) return;
+
+	cout << "Test failed: " << sMessage << endl;
+	exit(-1);
+}
+/////////////////////////////////////////////////////////////////////
+string read_file(const string& sFile)
+{
+	ifstream f(sFile, ios::binary);
+	return string(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+}
+/////////////////////////////////////////////////////////////////////
+void write_file(const string& sFile, const string& sContent)
+{
+	ofstream f(sFile, ios::binary | ios::trunc);
+	f.write(sContent.data(), (streamsize)sContent.size());
+}
+/////////////////////////////////////////////////////////////////////
+// offset of the weights in the file, 64 bytes aligned
+ptrdiff_t file_offset(const string& sContent, const MatrixFloat& m)
+{
+	size_t iOffset = sContent.find(string((const char*)m.data(), m.size() * sizeof(float)));
+	test((iOffset != string::npos) && ((iOffset % 64) == 0), "the weights must be saved 64 bytes aligned");
+	return (ptrdiff_t)iOffset;
+}
+/////////////////////////////////////////////////////////////////////
+void train(Net& model, const MatrixFloat& mSamples, const MatrixFloat& mTruth, int iNbEpochs)
+{
+	NetTrain netTrain;
+	netTrain.set_epochs(iNbEpochs);
+	netTrain.set_keepbest(false);
+	netTrain.set_batchsize(16);
+	netTrain.set_train_data(mSamples, mTruth);
+	netTrain.fit(model);
+}
+/////////////////////////////////////////////////////////////////////
+void test_binary_model()
+{
+	const string sFile = "test_net_util_model.bin";
+
+	// 6x6 image with one channel
+	MatrixFloat mSamples, mTruth;
+	mSamples.setRandom(200, 36);
+	mTruth.setZero(200, 3);
+	for (Index i = 0; i < 200; i++)
+		mTruth(i, argmax(colExtract(mSamples.row(i), 0, 3))) = 1.f;
+
+	Net model;
+	model.add(new LayerConvolution2D(6, 6, 1, 3, 3, 2, 1, 1, 1, 1, 1, 1)); // 'same' padding, saved with the layer
+	model.add(new LayerActivation("Relu"));
+	model.add(new LayerDense(72, 16));
+	model.add(new LayerGlobalGain());
+	model.add(new LayerDropout(0.1f));
+	model.add(new LayerDense(16, 3));
+	model.add(new LayerSoftmax());
+	train(model, mSamples, mTruth, 3);
+
+	test(NetUtil::save_binary(sFile, model), "the model must be saved");
+	string sContent = read_file(sFile);
+
+	MatrixFloat mRef, mOut;
+	model.predict(mSamples, mRef);
+
+	for (bool bMap : { true, false })
+	{
+		Net modelLoaded;
+		test(NetUtil::load(sFile, modelLoaded, bMap), "the model must be loaded");
+		test(modelLoaded.size() == model.size(), "same number of layers");
+		test(modelLoaded.is_classification_mode() == model.is_classification_mode(), "same classification mode");
+
+		modelLoaded.predict(mSamples, mOut);
+		test((mOut.rows() == mRef.rows()) && (mOut.cols() == mRef.cols()), "same output size");
+		test((mOut - mRef).cwiseAbs().maxCoeff() == 0.f, "the loaded model must give the same predictions");
+
+#ifndef USE_EIGEN
+		// the mapped weights are in the file: same distance between two weights in memory and in the file
+		ptrdiff_t iFileDistance = file_offset(sContent, *model.layer(2).weights()[0]) - file_offset(sContent, *model.layer(0).weights()[0]);
+		ptrdiff_t iMemoryDistance = (const char*)modelLoaded.layer(2).weights()[0]->data() - (const char*)modelLoaded.layer(0).weights()[0]->data();
+		test(bMap == (iMemoryDistance == iFileDistance), "the mapped weights must be viewed in the file");
+#endif
+
+		// the loaded model can be trained, the file is not modified
+		train(modelLoaded, mSamples, mTruth, 1);
+		modelLoaded.predict(mSamples, mOut);
+		test((mOut - mRef).cwiseAbs().maxCoeff() > 0.f, "the loaded model must be trained");
+		test(read_file(sFile) == sContent, "the training must not modify the file");
+	}
+
+	// the invalid files
+	Net modelLoaded;
+	test(!NetUtil::load("not_a_model.bin", modelLoaded), "a missing file must not be loaded");
+
+	write_file(sFile, sContent.substr(0, sContent.size() / 2));
+	test(!NetUtil::load(sFile, modelLoaded), "a truncated file must not be loaded");
+	test(modelLoaded.size() == 0, "a failed load gives an empty model");
+
+	string sCorrupted = sContent;
+	sCorrupted[0] = 'X';
+	write_file(sFile, sCorrupted);
+	test(!NetUtil::load(sFile, modelLoaded), "a file without the magic must not be loaded");
+
+	sCorrupted = sContent;
+	sCorrupted.replace(sCorrupted.find("Convolution2D"), 4, "Cxxx");
+	write_file(sFile, sCorrupted);
+	test(!NetUtil::load(sFile, modelLoaded), "an unknown layer must not be loaded");
+
+	// the weights must stay 64 bytes aligned in the file
+	sCorrupted = sContent;
+	sCorrupted[32] += 4; // uiDataOffset, little endian
+	write_file(sFile, sCorrupted);
+	test(!NetUtil::load(sFile, modelLoaded), "an unaligned data offset must not be loaded");
+
+	sCorrupted = sContent;
+	const string sBiasOffset("\x80\0\0\0\0\0\0\0", 8); // the convolution bias follows the 72 bytes of its weights
+	size_t iBiasOffset = sCorrupted.find(sBiasOffset, 64);
+	test(iBiasOffset != string::npos, "the bias offset must be in the graph");
+	sCorrupted[iBiasOffset] += 4;
+	write_file(sFile, sCorrupted);
+	test(!NetUtil::load(sFile, modelLoaded), "an unaligned weight offset must not be loaded");
+
+	remove(sFile.c_str());
+
+	// a layer without its parameters
+	Net modelRNN;
+	modelRNN.add(new LayerSimplestRNN(4));
+	test(!NetUtil::save_binary(sFile, modelRNN), "the SimplestRNN layer must be refused");
+	remove(sFile.c_str());
+}
+/////////////////////////////////////////////////////////////////////
+int main()
+{
+	test_binary_model();
+
+	cout << "Test succeded." << endl;
+	return 0;
+}
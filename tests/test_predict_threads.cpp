@@ -0,0 +1,149 @@
+// one const Net shared by many threads, each thread with its own InferenceContext
+
+#include <iostream>
+#include <thread>
+#include <vector>
+using namespace std;
+
+#include "Net.h"
+#include "Layer.h"
+
+#include "LayerConvolution2D.h"
+#include "LayerMaxPool2D.h"
+#include "LayerActivation.h"
+#include "LayerDense.h"
+#include "LayerSoftmax.h"
+#include "LayerPRelu.h"
+#include "LayerAffine.h"
+#include "LayerPELU.h"
+#include "LayerTERELU.h"
+
+using namespace beednn;
+/////////////////////////////////////////////////////////////////////
+// for testU only
+void test(bool bTest, const string& sMessage = "")
+{
+	if (bTest) return;
+
+	cout << "Test failed: " << sMessage << endl;
+	exit(-1);
+}
+/////////////////////////////////////////////////////////////////////
+void test_shared_net()
+{
+	cout << "test_shared_net:" << endl;
+
+	Net model;
+	model.add(new LayerConvolution2D(8, 8, 1, 3, 3, 4));
+	model.add(new LayerActivation("Relu"));
+	model.add(new LayerMaxPool2D(6, 6, 4));
+	model.add(new LayerDense(36, 3));
+	model.add(new LayerSoftmax());
+	model.set_inference_batchsize(16);
+
+	// the reference by slices of 10 samples, as in the threads: the GEMM rounding can depend on the number of rows (Eigen)
+	MatrixFloat mSamples, mRef, mSlice;
+	mSamples.setRandom(100, 64);
+	mRef.resize(100, 3);
+	for (Index iStart = 0; iStart < 100; iStart += 10)
+	{
+		model.predict(viewRow(mSamples, iStart, iStart + 10), mSlice);
+		for (Index r = 0; r < 10; r++)
+			for (Index c = 0; c < 3; c++)
+				mRef(iStart + r, c) = mSlice(r, c);
+	}
+
+	const Net& constModel = model;
+	const int iNbThreads = 4;
+	const int iNbLoops = 20;
+	vector<int> vErrors(iNbThreads, 0);
+	vector<thread> vThreads;
+
+	for (int t = 0; t < iNbThreads; t++)
+	{
+		vThreads.push_back(thread([&, t]()
+		{
+			InferenceContext context;
+			MatrixFloat mOut;
+			for (int i = 0; i < iNbLoops; i++)
+			{
+				// each thread predicts a different part of the samples
+				Index iStart = (i + t) % 10 * 10;
+				auto mBatch = viewRow(mSamples, iStart, iStart + 10);
+				constModel.predict(mBatch, mOut, context);
+
+				for (Index r = 0; r < 10; r++)
+					for (Index c = 0; c < mOut.cols(); c++)
+						vErrors[t] += (mOut(r, c) != mRef(iStart + r, c));
+			}
+		}));
+	}
+
+	for (auto& th : vThreads)
+		th.join();
+
+	for (int t = 0; t < iNbThreads; t++)
+		test(vErrors[t] == 0, "concurrent predict must give the same result");
+}
+/////////////////////////////////////////////////////////////////////
+// the weights of these layers are created by their first forward(): predict() must not create them
+void test_lazy_weights()
+{
+	cout << "test_lazy_weights:" << endl;
+
+	Net model;
+	model.add(new LayerDense(16, 8));
+	model.add(new LayerPRelu());
+	model.add(new LayerAffine());
+	model.add(new LayerPELU());
+	model.add(new LayerTERELU());
+
+	MatrixFloat mSamples, mRef, mTemp;
+	mSamples.setRandom(10, 16);
+
+	Net modelForward;
+	modelForward = model;
+	mRef = mSamples;
+	for (size_t i = 0; i < modelForward.size(); i++)
+	{
+		modelForward.layer(i).forward(mRef, mTemp);
+		mRef = mTemp;
+	}
+
+	const Net& constModel = model;
+	const int iNbThreads = 4;
+	vector<int> vErrors(iNbThreads, 0);
+	vector<thread> vThreads;
+
+	for (int t = 0; t < iNbThreads; t++)
+	{
+		vThreads.push_back(thread([&, t]()
+		{
+			InferenceContext context;
+			MatrixFloat mOut;
+			for (int i = 0; i < 20; i++)
+			{
+				constModel.predict(mSamples, mOut, context);
+				vErrors[t] += (mOut.rows() != mRef.rows()) || (mOut.cols() != mRef.cols()) || ((mOut - mRef).cwiseAbs().maxCoeff() != 0.f);
+			}
+		}));
+	}
+
+	for (auto& th : vThreads)
+		th.join();
+
+	for (int t = 0; t < iNbThreads; t++)
+		test(vErrors[t] == 0, "predict with the default weights must give the forward result");
+
+	for (size_t i = 1; i < model.size(); i++)
+		test(model.layer(i).weights()[0]->size() == 0, "predict must not create the weights");
+}
+/////////////////////////////////////////////////////////////////////
+int main()
+{
+	test_shared_net();
+	test_lazy_weights();
+
+	cout << "Test succeded." << endl;
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "SimdKernels.h"
+
+using namespace std;
+using namespace beednn;
+/////////////////////////////////////////////////////////////////////
+// for testU only
+void test(bool bTest, const string& sMessage = "")
+{
+	if (bTest) return;
+
+	cout << "Test failed: " << sMessage << endl;
+	exit(-1);
+}
+////////////////////////////////////////////////////////
+bool is_bitwise_same(const vector<float>& v1, const vector<float>& v2)
+{
+	return (v1.size() == v2.size()) && (memcmp(v1.data(), v2.data(), v1.size() * sizeof(float)) == 0);
+}
+////////////////////////////////////////////////////////
+vector<float> random_vector(size_t iSize, float fMin, float fMax)
+{
+	vector<float> v(iSize);
+	for (size_t i = 0; i < iSize; i++)
+		v[i] = fMin + (fMax - fMin) * (float)rand() / (float)RAND_MAX;
+	return v;
+}
+////////////////////////////////////////////////////////
+// results of all kernels of the current level, concatenated
+vector<float> run_kernels(const vector<float>& vA, const vector<float>& vB)
+{
+	ptrdiff_t iSize = (ptrdiff_t)vA.size();
+	vector<float> vOut(iSize), vAll;
+
+	simd_add(vA.data(), vB.data(), vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_add(vA.data(), 0.5f, vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_sub(vA.data(), vB.data(), vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_mul(vA.data(), vB.data(), vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_mul(vA.data(), 3.f, vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_div(vA.data(), vB.data(), vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_max(vA.data(), vB.data(), vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_max(vA.data(), 0.f, vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_sqrt(vB.data(), vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_exp(vA.data(), vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	simd_tanh(vA.data(), vOut.data(), iSize); vAll.insert(vAll.end(), vOut.begin(), vOut.end());
+	vAll.push_back(simd_sum(vA.data(), iSize));
+	vAll.push_back(simd_squared_norm(vA.data(), iSize));
+
+	return vAll;
+}
+////////////////////////////////////////////////////////
+void test_accuracy()
+{
+	cout << "test accuracy:" << endl;
+
+	vector<float> vA = random_vector(10007, -20.f, 20.f);
+	vector<float> vOut(vA.size());
+	ptrdiff_t iSize = (ptrdiff_t)vA.size();
+
+	simd_exp(vA.data(), vOut.data(), iSize);
+	double dMaxRelError = 0.;
+	for (size_t i = 0; i < vA.size(); i++)
+		dMaxRelError = max(dMaxRelError, fabs(vOut[i] - exp((double)vA[i])) / exp((double)vA[i]));
+	cout << "exp max relative error: " << dMaxRelError << endl;
+	test(dMaxRelError < 2.e-7, "exp accuracy");
+
+	simd_tanh(vA.data(), vOut.data(), iSize);
+	double dMaxError = 0.;
+	for (size_t i = 0; i < vA.size(); i++)
+		dMaxError = max(dMaxError, fabs(vOut[i] - tanh((double)vA[i])));
+	cout << "tanh max absolute error: " << dMaxError << endl;
+	test(dMaxError < 3.e-7, "tanh accuracy");
+
+	// special values, vectorized and in the scalar tail
+	const float fNaN = numeric_limits<float>::quiet_NaN();
+	const float fInf = numeric_limits<float>::infinity();
+	vector<float> vSpecial = { 0.f, -0.f, fNaN, fInf, -fInf, 100.f, -100.f, 0.625f, -0.625f, 1.e-30f, fNaN, 1.f, -1.f, 87.f, -87.f, 50.f, fNaN, fInf, -fInf };
+	vector<float> vSpecialOut(vSpecial.size());
+	simd_exp(vSpecial.data(), vSpecialOut.data(), (ptrdiff_t)vSpecial.size());
+	test(vSpecialOut[0] == 1.f, "exp(0)");
+	test(std::isnan(vSpecialOut[2]) && std::isnan(vSpecialOut[10]) && std::isnan(vSpecialOut[16]), "exp(NaN)");
+	test(vSpecialOut[4] == 0.f && vSpecialOut[6] == 0.f && vSpecialOut[18] == 0.f, "exp(-inf)");
+	test(vSpecialOut[3] > 1.e38f && vSpecialOut[5] > 1.e38f && vSpecialOut[17] > 1.e38f, "exp(inf)");
+	test(std::isfinite(vSpecialOut[3]) && std::isfinite(vSpecialOut[5]) && std::isfinite(vSpecialOut[17]), "exp saturates at 88.37");
+
+	// near the limits, the power of two stays a finite float: up to 2^127 and down to 2^-126
+	vector<float> vLimits = random_vector(1003, 80.f, 88.3762f);
+	vector<float> vLow = random_vector(1003, -87.3f, -80.f);
+	vLimits.insert(vLimits.end(), vLow.begin(), vLow.end());
+	vLimits.push_back(88.3762f);
+	vector<float> vLimitsOut(vLimits.size());
+	simd_exp(vLimits.data(), vLimitsOut.data(), (ptrdiff_t)vLimits.size());
+	dMaxRelError = 0.;
+	for (size_t i = 0; i < vLimits.size(); i++)
+		dMaxRelError = max(dMaxRelError, fabs(vLimitsOut[i] - exp((double)vLimits[i])) / exp((double)vLimits[i]));
+	cout << "exp max relative error near the limits: " << dMaxRelError << endl;
+	test(dMaxRelError < 2.e-7, "exp accuracy near the limits");
+
+	simd_tanh(vSpecial.data(), vSpecialOut.data(), (ptrdiff_t)vSpecial.size());
+	test(vSpecialOut[0] == 0.f, "tanh(0)");
+	test(std::isnan(vSpecialOut[2]) && std::isnan(vSpecialOut[10]) && std::isnan(vSpecialOut[16]), "tanh(NaN)");
+	test(vSpecialOut[3] == 1.f && vSpecialOut[4] == -1.f && vSpecialOut[17] == 1.f && vSpecialOut[18] == -1.f, "tanh(inf)");
+	test(vSpecialOut[9] == 1.e-30f, "tanh(small)");
+
+	// std::max semantic: first argument is kept if NaN
+	vector<float> vMax(vSpecial.size());
+	simd_max(vSpecial.data(), 0.f, vMax.data(), (ptrdiff_t)vSpecial.size());
+	test(std::isnan(vMax[2]) && std::isnan(vMax[10]) && std::isnan(vMax[16]), "max(NaN,0)");
+	test(vMax[5] == 100.f && vMax[6] == 0.f, "max(x,0)");
+}
+////////////////////////////////////////////////////////
+void test_levels()
+{
+	cout << "test levels:" << endl;
+
+	string sBestLevel = get_simd_level();
+	cout << "best level: " << sBestLevel << endl;
+
+	test(!set_simd_level("Unknown"), "unknown level must be refused");
+	test(get_simd_level() == sBestLevel, "level must not change on error");
+
+	// all sizes around the vector sizes, to test the tails
+	for (size_t iSize : { 0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 1000, 1021 })
+	{
+		vector<float> vA = random_vector(iSize, -10.f, 10.f);
+		vector<float> vB = random_vector(iSize, 0.1f, 10.f);
+
+		test(set_simd_level("Scalar"), "Scalar level is always supported");
+		vector<float> vScalar = run_kernels(vA, vB);
+
+		for (const char* sLevel : { "SSE41", "AVX2", "AVX512" })
+		{
+			if (!set_simd_level(sLevel))
+				continue;
+
+			test(is_bitwise_same(run_kernels(vA, vB), vScalar), string("level ") + sLevel + " differs from Scalar");
+		}
+	}
+
+	test(set_simd_level(""), "back to the best level");
+	test(get_simd_level() == sBestLevel, "back to the best level");
+}
+////////////////////////////////////////////////////////
+void test_speed()
+{
+	cout << "test speed:" << endl;
+
+	vector<float> vA = random_vector(100000, -10.f, 10.f);
+	vector<float> vB = random_vector(100000, 0.1f, 10.f);
+	vector<float> vOut(vA.size());
+	ptrdiff_t iSize = (ptrdiff_t)vA.size();
+
+	for (const char* sLevel : { "Scalar", "SSE41", "AVX2", "AVX512" })
+	{
+		if (!set_simd_level(sLevel))
+			continue;
+
+		auto start = chrono::steady_clock::now();
+		for (int i = 0; i < 20; i++)
+		{
+			simd_mul(vA.data(), vB.data(), vOut.data(), iSize);
+			simd_exp(vA.data(), vOut.data(), iSize);
+			simd_tanh(vA.data(), vOut.data(), iSize);
+			vOut[0] += simd_sum(vOut.data(), iSize);
+		}
+		auto end = chrono::steady_clock::now();
+
+		cout << sLevel << " time (us): " << chrono::duration_cast<std::chrono::microseconds>(end - start).count() << endl;
+	}
+
+	set_simd_level("");
+}
+////////////////////////////////////////////////////////
+int main()
+{
+	test_accuracy();
+	test_levels();
+	test_speed();
+
+	cout << "Tests finished." << endl;
+	return 0;
+}
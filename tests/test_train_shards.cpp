@@ -0,0 +1,304 @@
+// data parallel training: the result depends on the number of shards, not on the number of threads
+// and the merged gradients are the gradients of the whole batch
+// the asynchronous hogwild training also converges
+// the batches prefetched in a thread give the same training
+// a stream read shard by shard gives the same training as the samples in memory, and reads each shard once per epoch
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+#include "Net.h"
+#include "NetTrain.h"
+#include "Layer.h"
+#include "ThreadPool.h"
+#include "DataStream.h"
+
+#include "LayerConvolution2D.h"
+#include "LayerActivation.h"
+#include "LayerDense.h"
+#include "LayerDropout.h"
+#include "LayerSoftmax.h"
+#include "LayerPRelu.h"
+
+using namespace beednn;
+/////////////////////////////////////////////////////////////////////
+// for testU only
+void test(bool bTest, const string& sMessage = "")
+{
+	if (bTest) return;
+
+	cout << "Test failed: " << sMessage << endl;
+	exit(-1);
+}
+/////////////////////////////////////////////////////////////////////
+void create_model(Net& model, bool bConvolution, bool bDropout)
+{
+	if (bConvolution)
+	{
+		// 6x6 image with one channel
+		model.add(new LayerConvolution2D(6, 6, 1, 3, 3, 2));
+		model.add(new LayerActivation("Relu"));
+		model.add(new LayerDense(32, 3));
+	}
+	else
+	{
+		model.add(new LayerDense(36, 16));
+		model.add(new LayerActivation("Tanh"));
+		if (bDropout)
+			model.add(new LayerDropout(0.2f));
+		model.add(new LayerDense(16, 3));
+	}
+	model.add(new LayerSoftmax());
+}
+/////////////////////////////////////////////////////////////////////
+void train(Net& model, int iNbShards, int iNbThreads, const MatrixFloat& mSamples, const MatrixFloat& mTruth)
+{
+	set_nb_threads(iNbThreads);
+	randomEngine().seed(42); // same shuffle and dropout for all trainings
+
+	NetTrain netTrain;
+	netTrain.set_epochs(3);
+	netTrain.set_keepbest(false);
+	netTrain.set_batchsize(30);
+	netTrain.set_optimizer("SGD");
+	netTrain.set_nb_shards(iNbShards);
+	netTrain.set_train_data(mSamples, mTruth);
+	netTrain.fit(model);
+
+	set_nb_threads(1);
+}
+/////////////////////////////////////////////////////////////////////
+float max_weight_difference(Net& model1, Net& model2)
+{
+	float fMax = 0.f;
+	for (size_t i = 0; i < model1.size(); i++)
+	{
+		Layer& l1 = model1.layer(i);
+		Layer& l2 = model2.layer(i);
+		vector<MatrixFloat*> v1 = l1.weights(), v2 = l2.weights();
+		vector<MatrixFloat*> vb1 = l1.biases(), vb2 = l2.biases();
+		v1.insert(v1.end(), vb1.begin(), vb1.end());
+		v2.insert(v2.end(), vb2.begin(), vb2.end());
+
+		for (size_t j = 0; j < v1.size(); j++)
+			if (v1[j]->size() != 0)
+				fMax = max(fMax, (*v1[j] - *v2[j]).cwiseAbs().maxCoeff());
+	}
+	return fMax;
+}
+/////////////////////////////////////////////////////////////////////
+void test_shards(bool bConvolution)
+{
+	cout << (bConvolution ? "convolution net:" : "dense net:") << endl;
+
+	MatrixFloat mSamples, mTruth;
+	mSamples.setRandom(100, 36);
+	mTruth.setZero(100, 3);
+	for (Index i = 0; i < 100; i++)
+		mTruth(i, i % 3) = 1.f;
+
+	Net modelInit;
+	create_model(modelInit, bConvolution, !bConvolution);
+
+	// independent of the number of threads, dropout included
+	Net model1Thread, model4Threads;
+	model1Thread = modelInit;
+	model4Threads = modelInit;
+	train(model1Thread, 4, 1, mSamples, mTruth);
+	train(model4Threads, 4, 4, mSamples, mTruth);
+	float fThreadsDifference = max_weight_difference(model1Thread, model4Threads);
+	cout << "1 thread vs 4 threads: " << fThreadsDifference << endl;
+	test(fThreadsDifference == 0.f, "the result must not depend on the number of threads");
+
+	// same gradients as without shards, up to the rounding, without dropout
+	Net modelRef, modelSharded;
+	create_model(modelRef, bConvolution, false);
+	modelSharded = modelRef;
+	train(modelRef, 1, 1, mSamples, mTruth);
+	train(modelSharded, 3, 4, mSamples, mTruth);
+	float fShardsDifference = max_weight_difference(modelRef, modelSharded);
+	cout << "no shard vs 3 shards: " << fShardsDifference << endl;
+	test(fShardsDifference < 1.e-5f, "the merged gradient must be the gradient of the batch");
+}
+/////////////////////////////////////////////////////////////////////
+void test_hogwild()
+{
+	cout << "hogwild:" << endl;
+
+	// the class is the biggest of the 3 first features
+	MatrixFloat mSamples, mTruth;
+	mSamples.setRandom(600, 36);
+	mTruth.setZero(600, 3);
+	for (Index i = 0; i < 600; i++)
+		mTruth(i, argmax(colExtract(mSamples.row(i), 0, 3))) = 1.f;
+
+	// PRelu creates its weights in its first forward, before the threads read them
+	for (bool bPRelu : { false, true })
+	{
+		Net model;
+		if (bPRelu)
+		{
+			model.add(new LayerDense(36, 16));
+			model.add(new LayerPRelu());
+			model.add(new LayerDense(16, 3));
+			model.add(new LayerSoftmax());
+		}
+		else
+			create_model(model, false, false);
+
+		set_nb_threads(4);
+		NetTrain netTrain;
+		netTrain.set_epochs(30);
+		netTrain.set_keepbest(false);
+		netTrain.set_batchsize(16);
+		netTrain.set_hogwild(true);
+		netTrain.set_train_data(mSamples, mTruth);
+		netTrain.fit(model);
+		set_nb_threads(1);
+
+		float fFirstLoss = netTrain.get_train_loss()[0];
+		float fAccuracy = netTrain.get_current_train_accuracy();
+		cout << (bPRelu ? "with PRelu, " : "") << "first epoch loss: " << fFirstLoss << " last epoch loss: " << netTrain.get_current_train_loss() << " accuracy: " << fAccuracy << " %" << endl;
+		test(netTrain.get_current_train_loss() < fFirstLoss * 0.5f, "hogwild training must converge");
+		test(fAccuracy > 80.f, "hogwild training must converge");
+
+		if (bPRelu)
+		{
+			const MatrixFloat& mSlopes = *model.layer(1).weights()[0];
+			test((mSlopes.rows() == 1) && (mSlopes.cols() == 16), "hogwild must train the weights created in the first forward");
+			float fMaxChange = 0.f;
+			for (Index i = 0; i < mSlopes.size(); i++)
+				fMaxChange = max(fMaxChange, fabs(mSlopes(i) - 0.25f));
+			test(fMaxChange > 0.f, "hogwild must train the weights created in the first forward");
+		}
+	}
+}
+/////////////////////////////////////////////////////////////////////
+void test_prefetch()
+{
+	cout << "prefetch:" << endl;
+
+	MatrixFloat mSamples, mTruth;
+	mSamples.setRandom(1000, 36);
+	mTruth.setZero(1000, 3);
+	for (Index i = 0; i < 1000; i++)
+		mTruth(i, i % 3) = 1.f;
+
+	Net modelRef, modelPrefetch;
+	create_model(modelRef, false, true);
+	modelPrefetch = modelRef;
+
+	for (int iPrefetch : { 0, 3 })
+	{
+		randomEngine().seed(42);
+		NetTrain netTrain;
+		netTrain.set_epochs(3);
+		netTrain.set_keepbest(false);
+		netTrain.set_batchsize(16);
+		netTrain.set_prefetch_batches(iPrefetch);
+		netTrain.set_train_data(mSamples, mTruth);
+		netTrain.fit(iPrefetch ? modelPrefetch : modelRef);
+
+		cout << "prefetch batches: " << iPrefetch << " stall time: " << netTrain.get_prefetch_stall_time() << " s, mean queue depth: " << netTrain.get_prefetch_queue_depth() << endl;
+		test(netTrain.get_prefetch_queue_depth() <= iPrefetch, "the queue is bounded");
+	}
+
+	test(max_weight_difference(modelRef, modelPrefetch) == 0.f, "the prefetched batches must give the same training");
+}
+/////////////////////////////////////////////////////////////////////
+// count the reads of each shard and keep the order of the first epoch
+class CountingDataStream : public MatrixDataStream
+{
+public:
+	CountingDataStream(const MatrixFloat& mSamples, const MatrixFloat& mTruth, Index iShardSize) :
+		MatrixDataStream(mSamples, mTruth, iShardSize)
+	{ }
+
+	bool read_shard(Index iShard, MatrixFloat& mSamples, MatrixFloat& mTruth) override
+	{
+		vReads.push_back(iShard);
+		return MatrixDataStream::read_shard(iShard, mSamples, mTruth);
+	}
+
+	vector<Index> vReads;
+};
+/////////////////////////////////////////////////////////////////////
+void test_stream()
+{
+	cout << "stream:" << endl;
+
+	MatrixFloat mSamples, mTruth;
+	mSamples.setRandom(1000, 36);
+	mTruth.setZero(1000, 3);
+	for (Index i = 0; i < 1000; i++)
+		mTruth(i, argmax(colExtract(mSamples.row(i), 0, 3))) = 1.f;
+
+	// one shard: same shuffle as the samples in memory
+	Net modelRef, modelStream;
+	create_model(modelRef, false, true);
+	modelStream = modelRef;
+	MatrixDataStream stream(mSamples, mTruth, 0);
+
+	for (bool bStream : { false, true })
+	{
+		randomEngine().seed(42);
+		NetTrain netTrain;
+		netTrain.set_epochs(3);
+		netTrain.set_keepbest(false);
+		netTrain.set_batchsize(16);
+		if (bStream)
+			netTrain.set_train_stream(&stream);
+		else
+			netTrain.set_train_data(mSamples, mTruth);
+		netTrain.fit(bStream ? modelStream : modelRef);
+	}
+	test(max_weight_difference(modelRef, modelStream) == 0.f, "a stream of one shard must give the same training");
+
+	// 8 shards, read ahead in a thread
+	Net model;
+	create_model(model, false, false);
+	CountingDataStream countingStream(mSamples, mTruth, 128);
+	const int iNbEpochs = 20;
+
+	randomEngine().seed(42);
+	NetTrain netTrain;
+	netTrain.set_epochs(iNbEpochs);
+	netTrain.set_keepbest(false);
+	netTrain.set_batchsize(16);
+	netTrain.set_prefetch_batches(2);
+	netTrain.set_train_stream(&countingStream);
+	netTrain.fit(model);
+
+	vector<Index>& vReads = countingStream.vReads;
+	test(vReads.size() == (size_t)(8 * iNbEpochs), "each shard must be read once per epoch");
+	bool bShuffled = false;
+	for (int iEpoch = 0; iEpoch < iNbEpochs; iEpoch++)
+	{
+		vector<Index> vEpoch(vReads.begin() + iEpoch * 8, vReads.begin() + (iEpoch + 1) * 8);
+		bShuffled |= (vEpoch != vector<Index>(vReads.begin(), vReads.begin() + 8));
+		sort(vEpoch.begin(), vEpoch.end());
+		for (Index i = 0; i < 8; i++)
+			test(vEpoch[i] == i, "each shard must be read once per epoch");
+	}
+	test(bShuffled, "the shards must be read in a random order");
+
+	float fFirstLoss = netTrain.get_train_loss()[0];
+	float fAccuracy = netTrain.get_current_train_accuracy();
+	cout << "first epoch loss: " << fFirstLoss << " last epoch loss: " << netTrain.get_current_train_loss() << " accuracy: " << fAccuracy << " %" << endl;
+	test(netTrain.get_current_train_loss() < fFirstLoss * 0.5f, "the training on a stream must converge");
+	test(fAccuracy > 80.f, "the training on a stream must converge");
+}
+/////////////////////////////////////////////////////////////////////
+int main()
+{
+	test_shards(false);
+	test_shards(true);
+	test_hogwild();
+	test_prefetch();
+	test_stream();
+
+	cout << "Test succeded." << endl;
+	return 0;
+}